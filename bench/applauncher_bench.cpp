@@ -0,0 +1,473 @@
+/**  Brief: Benchmark suite of the core library
+ *
+ *   Qt Test benchmarks over synthetic datasets of 1k to 1M bookmarks and
+ *   commands, see dataset.hpp:
+ *
+ *    + data() over all cells of FileBookmarkItemModel
+ *    + insertion, removal and sorting of the model
+ *    + loading and painting the command registry, CommandItemModel
+ *    + serialization round trips: settings schema and bookmark store
+ *    + spawn latency of QProcess::startDetached()
+ *
+ *   Checks of corner cases, which are not measured, run with the suite.
+ *
+ *   Usage: $ applauncher_bench [--json <file>] [--max-rows <n>] [Qt Test options]
+ *
+ *   --json writes the results as JSON, so that runs can be compared:
+ *
+ *     {"context": {...}, "benchmarks": [{"name": "sort/100000",
+ *      "metric": "WalltimeMilliseconds", "value": 12.5, "iterations": 1}]}
+ *
+ *   Values are per iteration, as reported by Qt Test.
+ ************************************************************************/
+#include <iostream>
+
+#include <QtCore>
+#include <QtTest>
+
+#include <qxstl/serialization.hpp>
+
+#include "src/bookmarkstore.hpp"
+#include "src/commanditemmodel.hpp"
+#include "src/filebookmarkitemmodel.hpp"
+#include "dataset.hpp"
+
+namespace
+{
+    struct Row
+    {
+        QString uri_path;
+        QString brief;
+        QString description;
+
+        static constexpr auto schema = std::make_tuple(
+            qxstl::serialization::field(1, &Row::uri_path),
+            qxstl::serialization::field(2, &Row::brief),
+            qxstl::serialization::field(3, &Row::description));
+    };
+
+    struct Settings
+    {
+        std::vector<Row> rows;
+        QStringList      commands;
+
+        static constexpr auto schema = std::make_tuple(
+            qxstl::serialization::field(1, &Settings::rows),
+            qxstl::serialization::field(2, &Settings::commands));
+    };
+
+    /// Settings as written by a newer version, with a field inserted
+    struct SettingsV2
+    {
+        std::vector<Row> rows;
+        qint64           flags = 0;
+        QStringList      commands;
+
+        static constexpr auto schema = std::make_tuple(
+            qxstl::serialization::field(1, &SettingsV2::rows),
+            qxstl::serialization::field(3, &SettingsV2::flags),
+            qxstl::serialization::field(2, &SettingsV2::commands));
+    };
+
+    /// Convert the XML report of Qt Test to JSON, return false on failure.
+    bool write_json_report(QString const& xml_file, QString const& json_file)
+    {
+        QFile input{xml_file};
+        if(!input.open(QIODevice::ReadOnly)) { return false; }
+
+        QJsonArray benchmarks;
+        QString function;
+        QXmlStreamReader xml{&input};
+        while(!xml.atEnd())
+        {
+            if(xml.readNext() != QXmlStreamReader::StartElement) { continue; }
+            auto attrs = xml.attributes();
+            if(xml.name() == QLatin1String("TestFunction"))
+            {
+                function = attrs.value("name").toString();
+            }
+            else if(xml.name() == QLatin1String("BenchmarkResult"))
+            {
+                QString tag = attrs.value("tag").toString();
+                benchmarks.append(QJsonObject{
+                    {"name",       tag.isEmpty() ? function : function + "/" + tag},
+                    {"metric",     attrs.value("metric").toString()},
+                    {"value",      attrs.value("value").toDouble()},
+                    {"iterations", attrs.value("iterations").toInt()}
+                });
+            }
+        }
+        if(xml.hasError()) { return false; }
+
+        QJsonObject context{
+            {"date",       QDateTime::currentDateTime().toString(Qt::ISODate)},
+            {"host",       QSysInfo::machineHostName()},
+            {"cpu",        QSysInfo::currentCpuArchitecture()},
+            {"os",         QSysInfo::prettyProductName()},
+            {"qt_version", QString(qVersion())}
+        };
+        QFile output{json_file};
+        if(!output.open(QIODevice::WriteOnly | QIODevice::Truncate)) { return false; }
+        QJsonObject root{{"context", context}, {"benchmarks", benchmarks}};
+        return output.write(QJsonDocument(root).toJson()) > 0;
+    }
+}
+
+class ApplauncherBench: public QObject
+{
+    Q_OBJECT
+
+    int m_max_rows;
+
+    void add_sizes()
+    {
+        QTest::addColumn<int>("rows");
+        for(int rows: {1000, 10000, 100000, 1000000})
+        {
+            if(rows <= m_max_rows) { QTest::newRow(qPrintable(QString::number(rows))) << rows; }
+        }
+    }
+
+    static void fill(FileBookmarkItemModel& model, int rows)
+    {
+        auto items = bench::make_bookmarks(rows);
+        model.add_items(items.begin(), items.end());
+    }
+
+public:
+    explicit ApplauncherBench(int max_rows): m_max_rows{max_rows} { }
+
+private slots:
+
+    //-------- Model -------------------------------//
+
+    void data_all_cells_data() { this->add_sizes(); }
+    void data_all_cells()
+    {
+        QFETCH(int, rows);
+        FileBookmarkItemModel model;
+        fill(model, rows);
+        int columns = model.columnCount();
+        QBENCHMARK
+        {
+            for(int r = 0; r < rows; r++)
+                for(int c = 0; c < columns; c++)
+                    model.data(model.index(r, c));
+        }
+    }
+
+    void insert_data() { this->add_sizes(); }
+    void insert()
+    {
+        QFETCH(int, rows);
+        auto items = bench::make_bookmarks(rows);
+        FileBookmarkItemModel model;
+        QBENCHMARK_ONCE
+        {
+            model.add_items(items.begin(), items.end());
+        }
+        QCOMPARE(model.count(), rows);
+    }
+
+    void remove_data() { this->add_sizes(); }
+    void remove()
+    {
+        QFETCH(int, rows);
+        FileBookmarkItemModel model;
+        fill(model, rows);
+        // The middle half, so that the tail is compacted.
+        QBENCHMARK_ONCE
+        {
+            model.remove_rows(rows / 4, rows / 4 + rows / 2 - 1);
+        }
+        QCOMPARE(model.count(), rows - rows / 2);
+    }
+
+    void sort_data() { this->add_sizes(); }
+    void sort()
+    {
+        QFETCH(int, rows);
+        FileBookmarkItemModel model;
+        fill(model, rows);
+        QBENCHMARK_ONCE
+        {
+            model.sort(3);
+        }
+    }
+
+    void command_load_data() { this->add_sizes(); }
+    void command_load()
+    {
+        QFETCH(int, rows);
+        auto texts = bench::make_commands(rows);
+        CommandItemModel model;
+        QBENCHMARK_ONCE
+        {
+            model.assign_texts(texts);
+        }
+        QCOMPARE(model.count(), rows);
+    }
+
+    // A page of rows as painted by the view while scrolling: text, color
+    // and tooltip.
+    void command_paint_data() { this->add_sizes(); }
+    void command_paint()
+    {
+        QFETCH(int, rows);
+        CommandItemModel model;
+        model.assign_texts(bench::make_commands(rows));
+        int page = std::min(rows, 40);
+        QBENCHMARK
+        {
+            for(int first = 0; first + page <= rows; first += rows / 16 + 1)
+                for(int r = first; r < first + page; r++)
+                    for(int role: {Qt::DisplayRole, Qt::ForegroundRole, Qt::ToolTipRole})
+                        model.data(model.index(r, 0), role);
+        }
+    }
+
+    //-------- Serialization -----------------------//
+
+    void schema_round_trip_data() { this->add_sizes(); }
+    void schema_round_trip()
+    {
+        QFETCH(int, rows);
+        Settings in;
+        for(auto const& item: bench::make_bookmarks(rows))
+            in.rows.push_back(Row{item.uri_path(), item.brief, item.description});
+        in.commands = bench::make_commands(std::min(rows, 10000));
+        Settings out;
+        QBENCHMARK
+        {
+            QByteArray arr;
+            QDataStream ws{&arr, QIODevice::WriteOnly};
+            qxstl::serialization::SchemaWriter{&ws, 1}(in);
+            QDataStream rs{&arr, QIODevice::ReadOnly};
+            QVERIFY(qxstl::serialization::SchemaReader{&rs}(out));
+        }
+        QCOMPARE(out.rows.size(), in.rows.size());
+    }
+
+    void store_round_trip_data() { this->add_sizes(); }
+    void store_round_trip()
+    {
+        QFETCH(int, rows);
+        auto items = bench::make_bookmarks(rows);
+        QTemporaryDir dir;
+        QString file = dir.filePath("bench.qbk");
+        QBENCHMARK
+        {
+            BookmarkStore::write(file, 0, items);
+            auto store = BookmarkStore::open(file);
+            QVERIFY(store != nullptr);
+            for(int i = 0; i < store->size(); i++){ store->item(i); }
+        }
+    }
+
+    //-------- Checks ------------------------------//
+
+    // Two changed rows swapping their relative order are both moved to
+    // their sorted place.
+    void check_refresh_sorted_rows()
+    {
+        FileBookmarkItemModel model;
+        std::vector<FileBookmarkItem> items;
+        for(QString brief: {"a", "b", "c", "d"})
+            items.push_back(FileBookmarkItem{"/tmp/" + brief, brief, ""});
+        model.add_items(items.begin(), items.end());
+        model.sort(3);
+        model.modify(1, [](FileBookmarkItem& item){ item.brief = "y"; });
+        model.modify(2, [](FileBookmarkItem& item){ item.brief = "x"; });
+        model.refresh_rows({1, 2});
+        QStringList briefs;
+        for(int r = 0; r < model.count(); r++){ briefs << model.at(r).brief; }
+        QCOMPARE(briefs, (QStringList{"a", "d", "x", "y"}));
+    }
+
+    // Positions of hidden items are beyond the number of rows, sorting
+    // must not index the rows by them.
+    void check_sort_filtered()
+    {
+        FileBookmarkItemModel model;
+        std::vector<FileBookmarkItem> items;
+        for(QString brief: {"d", "c", "b", "a"})
+            items.push_back(FileBookmarkItem{"/tmp/" + brief, brief, ""});
+        model.add_items(items.begin(), items.end());
+        model.set_row_filter({2, 3});
+        QPersistentModelIndex current = model.index(0, 0);
+        model.sort(3);
+        QStringList briefs;
+        for(int r = 0; r < model.count(); r++){ briefs << model.at(r).brief; }
+        QCOMPARE(briefs, (QStringList{"a", "b"}));
+        QCOMPARE(current.row(), 1);
+    }
+
+    // Rows of a selection with gaps are moved together, in their order.
+    void check_move_rows_selection()
+    {
+        FileBookmarkItemModel model;
+        std::vector<FileBookmarkItem> items;
+        for(QString brief: {"a", "b", "c", "d", "e"})
+            items.push_back(FileBookmarkItem{"/tmp/" + brief, brief, ""});
+        model.add_items(items.begin(), items.end());
+        QPersistentModelIndex current = model.index(2, 0);
+        QVERIFY(model.move_rows({0, 2}, 4));
+        QStringList briefs;
+        for(int r = 0; r < model.count(); r++){ briefs << model.at(r).brief; }
+        QCOMPARE(briefs, (QStringList{"b", "d", "a", "c", "e"}));
+        QCOMPARE(current.row(), 3);
+    }
+
+    // Items of a source are changed and removed without decoding the
+    // others.
+    void check_lazy_changes()
+    {
+        FileBookmarkItemModel model;
+        model.attach(std::make_shared<qxstl::model::FunctionSource<FileBookmarkItem>>(
+                         100, [](int n){ return FileBookmarkItem{"/tmp/" + QString::number(n),
+                                                                 QString::number(n), ""}; }));
+        quint64 id = model.id(5);
+        QVERIFY(model.set_item_data(5, 3, "x"));
+        model.remove_item_at(2);
+        QVERIFY(model.has_source());
+        QCOMPARE(model.item_count(), 99);
+        QCOMPARE(model.position_of_id(id), 4);
+        QCOMPARE(model.item(4).brief, QString{"x"});
+        QCOMPARE(model.item(2).brief, QString{"3"});
+        QCOMPARE(model.source()->item(4).brief, QString{"x"});
+        model.materialize();
+        QCOMPARE(model.item_count(), 99);
+        QCOMPARE(model.item(4).brief, QString{"x"});
+        QCOMPARE(model.id(4), id);
+    }
+
+    // Looking up a path never interns it.
+    void check_path_trie_find()
+    {
+        qxstl::storage::PathTrie trie;
+        auto id = trie.intern("/tmp/a/b");
+        auto size = trie.size();
+        QCOMPARE(trie.find("/tmp/a/b"), id);
+        QCOMPARE(trie.find("/tmp/a/c"), qxstl::storage::PathTrie::Id{0});
+        QCOMPARE(trie.find("/tmp/a/b/c"), qxstl::storage::PathTrie::Id{0});
+        QCOMPARE(trie.size(), size);
+    }
+
+    void check_schema_unknown_field()
+    {
+        SettingsV2 in;
+        in.rows.push_back(Row{"/tmp/a", "a", ""});
+        in.flags    = 42;
+        in.commands = QStringList{"true", "false"};
+        Row trailer{"/tmp/b", "b", ""};
+        QByteArray arr;
+        QDataStream ws{&arr, QIODevice::WriteOnly};
+        qxstl::serialization::SchemaWriter writer{&ws, 2};
+        writer(in);
+        writer(trailer);
+
+        // The extra field is skipped, the next record is still aligned.
+        QDataStream rs{&arr, QIODevice::ReadOnly};
+        qxstl::serialization::SchemaReader reader{&rs};
+        Settings out;
+        Row      next;
+        QCOMPARE(reader.version(), quint32{2});
+        QVERIFY(reader(out));
+        QVERIFY(reader(next));
+        QCOMPARE(out.rows.size(), size_t{1});
+        QCOMPARE(out.commands, in.commands);
+        QCOMPARE(next.brief, QString{"b"});
+
+        // And conversely, the missing field keeps its default.
+        QByteArray old;
+        QDataStream os{&old, QIODevice::WriteOnly};
+        qxstl::serialization::SchemaWriter{&os, 1}(out);
+        QDataStream ns{&old, QIODevice::ReadOnly};
+        SettingsV2 newer;
+        newer.flags = 7;
+        QVERIFY(qxstl::serialization::SchemaReader{&ns}(newer));
+        QCOMPARE(newer.flags, qint64{7});
+        QCOMPARE(newer.commands, in.commands);
+    }
+
+    void check_manual_order_kept()
+    {
+        FileBookmarkItemModel model;
+        std::vector<FileBookmarkItem> items;
+        for(QString brief: {"a", "b", "c", "d"})
+            items.push_back(FileBookmarkItem{"/tmp/" + brief, brief, ""});
+        model.add_items(items.begin(), items.end());
+        auto briefs = [&]
+        {
+            QStringList list;
+            for(int r = 0; r < model.count(); r++){ list << model.at(r).brief; }
+            return list;
+        };
+        QVERIFY(model.move_rows({3}, 0));
+        QCOMPARE(briefs(), (QStringList{"d", "a", "b", "c"}));
+        // Hidden by a column, shown again instead of the insertion order
+        model.sort(3);
+        QCOMPARE(briefs(), (QStringList{"a", "b", "c", "d"}));
+        model.sort(-1);
+        QCOMPARE(briefs(), (QStringList{"d", "a", "b", "c"}));
+        // Restored from the saved keys
+        FileBookmarkItemModel restored;
+        restored.add_items(items.begin(), items.end());
+        QVERIFY(restored.set_manual_order(model.manual_order()));
+        QCOMPARE(restored.at(0).brief, QString{"d"});
+    }
+
+    //-------- Launching ---------------------------//
+
+    void start_detached()
+    {
+#ifdef Q_OS_WIN
+        QString command = "cmd /c exit";
+#else
+        QString command = "true";
+#endif
+        QBENCHMARK
+        {
+            QVERIFY(QProcess::startDetached(command));
+        }
+    }
+};
+
+int main(int argc, char** argv)
+{
+    QCoreApplication app(argc, argv);
+
+    // Options of the suite are removed before passing the rest to Qt Test.
+    QStringList args = app.arguments();
+    QString json_file;
+    int max_rows = 1000000;
+    for(int i = 1; i + 1 < args.size(); )
+    {
+        if(args[i] == "--json")          { json_file = args[i + 1]; args.erase(args.begin() + i, args.begin() + i + 2); }
+        else if(args[i] == "--max-rows") { max_rows = args[i + 1].toInt(); args.erase(args.begin() + i, args.begin() + i + 2); }
+        else                             { i++; }
+    }
+
+    QTemporaryDir tmp;
+    QString xml_file = tmp.filePath("results.xml");
+    if(!json_file.isEmpty())
+    {
+        args << "-o" << xml_file + ",xml" << "-o" << "-,txt";
+    }
+
+    ApplauncherBench bench{max_rows};
+    int status = QTest::qExec(&bench, args);
+
+    if(!json_file.isEmpty())
+    {
+        if(!write_json_report(xml_file, json_file))
+        {
+            std::cerr << " [ERROR] Unable to write " << json_file.toStdString() << std::endl;
+            return 1;
+        }
+        std::cout << " [INFO] Results written to " << json_file.toStdString() << std::endl;
+    }
+    return status;
+}
+
+#include "applauncher_bench.moc"
@@ -0,0 +1,130 @@
+/**  Brief: Memory per entry of the command registry
+ *
+ *   Loads synthetic commands, see dataset.hpp, into the registry as it
+ *   was held before and after CommandItemModel:
+ *
+ *    + before: a QListWidget with one QListWidgetItem per entry, its
+ *      tooltip set to the program or the error, and a parallel vector of
+ *      commands holding the arguments, the error message and a copy of
+ *      $PATH each
+ *    + after:  a CommandItemModel, see ParsedCommand
+ *
+ *   Bytes per entry are reported from the heap of the process on glibc,
+ *   which includes the malloc overhead, and from sizeof the entries.
+ *
+ *   Usage: $ bench_command_store [entries]
+ ************************************************************************/
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <QApplication>
+#include <QtWidgets>
+
+#include "src/commanditemmodel.hpp"
+#include "src/launchengine.hpp"
+#include "dataset.hpp"
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#  include <malloc.h>
+#  define BENCH_HAS_MALLINFO2
+#endif
+
+namespace
+{
+    /// Bytes allocated on the heap, -1 if unknown
+    long long heap_bytes()
+    {
+#ifdef BENCH_HAS_MALLINFO2
+        return static_cast<long long>(mallinfo2().uordblks);
+#else
+        return -1;
+#endif
+    }
+
+    /// Deep copy, as a string read from the settings file
+    QString copy(QString const& s)
+    {
+        return QString{s.unicode(), s.size()};
+    }
+
+    /// Command as the registry held it before CommandItemModel
+    struct CommandBefore
+    {
+        QString     text;
+        QStringList argv;
+        QString     cwd;
+        QStringList env;
+        QString     program;
+        qint64      program_mtime = 0;
+        QByteArray  path_env;
+        QString     error;
+    };
+
+    void report(char const* name, int count, std::size_t entry_size, long long heap)
+    {
+        std::cout << " " << std::left << std::setw(8) << name << std::right
+                  << std::setw(10) << entry_size << " B sizeof";
+        if(heap >= 0)
+        {
+            std::cout << std::setw(10) << std::fixed << std::setprecision(1)
+                      << static_cast<double>(heap) / count << " B/entry heap";
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    int count  = argc > 1 ? std::atoi(argv[1]) : 100000;
+    auto texts = bench::make_commands(count);
+    std::cout << " [INFO] Commands = " << count << std::endl;
+
+    // Programs are looked up once for both, only the copies are measured.
+    QHash<QString, QString> programs;
+    for(auto const& text: texts)
+    {
+        QString name = LaunchEngine::split_command(text).value(0);
+        if(!programs.contains(name)) { programs.insert(name, QStandardPaths::findExecutable(name)); }
+    }
+
+    {
+        long long heap0 = heap_bytes();
+        QListWidget widget;
+        std::vector<CommandBefore> commands;
+        commands.reserve(static_cast<size_t>(count));
+        for(auto const& text: texts)
+        {
+            CommandBefore cmd;
+            cmd.text     = copy(text);
+            cmd.argv     = LaunchEngine::split_command(cmd.text);
+            cmd.program  = copy(programs.value(cmd.argv.value(0)));
+            cmd.path_env = qgetenv("PATH");
+            if(cmd.program.isEmpty()) { cmd.error = "not found: " + cmd.argv.value(0); }
+
+            auto item = new QListWidgetItem(cmd.text);
+            item->setToolTip(cmd.program.isEmpty() ? cmd.error : cmd.program);
+            widget.addItem(item);
+            commands.push_back(std::move(cmd));
+        }
+        long long heap = heap0 < 0 ? -1 : heap_bytes() - heap0;
+        report("before", count, sizeof(CommandBefore), heap);
+    }
+    {
+        long long heap0 = heap_bytes();
+        CommandItemModel model;
+        {
+            QStringList copies;
+            copies.reserve(count);
+            for(auto const& text: texts){ copies << copy(text); }
+            model.assign_texts(copies);
+        }
+        long long heap = heap0 < 0 ? -1 : heap_bytes() - heap0;
+        report("after", count, sizeof(ParsedCommand), heap);
+    }
+    return 0;
+}
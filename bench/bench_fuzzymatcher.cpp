@@ -0,0 +1,78 @@
+/**  Brief: Micro-benchmark of the FuzzyMatcher prefilter
+ *
+ *   Runs the same queries over a synthetic command registry with every
+ *   instruction set supported by the CPU: scalar, SSE4.2 and AVX2.
+ *
+ *   Usage: $ bench_fuzzymatcher [candidates]
+ ************************************************************************/
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <random>
+
+#include "src/fuzzymatcher.hpp"
+
+std::vector<std::string> make_candidates(int n)
+{
+    const char* programs[] = { "emacs", "firefox", "code", "gnome-terminal",
+                               "libreoffice", "thunderbird", "gimp", "inkscape" };
+    const char* words[] = { "--profile", "/home/user/projects", "--new-window",
+                            "MakeTarget", "src/main.cpp", "--geometry=1200x800",
+                            "/opt/tools/bin", "SomeLongCamelCaseArgument" };
+    std::mt19937 rng{42};
+    std::vector<std::string> out;
+    out.reserve(n);
+    for(int i = 0; i < n; i++)
+    {
+        std::string cmd = std::string("/usr/bin/") + programs[rng() % 8];
+        int nargs = 2 + rng() % 6;
+        for(int k = 0; k < nargs; k++){ cmd += std::string(" ") + words[rng() % 8]; }
+        cmd += " " + std::to_string(i);
+        out.push_back(cmd);
+    }
+    return out;
+}
+
+int main(int argc, char** argv)
+{
+    int n = argc > 1 ? std::atoi(argv[1]) : 100000;
+    auto candidates = make_candidates(n);
+    const char* queries[] = { "ffx", "emcsmain", "gtermgeo", "lbrfprof", "zzz", "mktgt" };
+
+    FuzzyMatcher matcher;
+    matcher.set_candidates(candidates);
+
+    const char* names[] = { "scalar", "sse4.2", "avx2" };
+    auto best = FuzzyMatcher::detected_isa();
+
+    std::cout << "candidates = " << n << std::endl;
+    std::cout << std::setw(8) << "isa" << std::setw(14) << "prefilter us"
+              << std::setw(14) << "match us" << std::setw(10) << "hits" << std::endl;
+
+    for(auto isa: { FuzzyMatcher::Isa::Scalar, FuzzyMatcher::Isa::SSE42, FuzzyMatcher::Isa::AVX2 })
+    {
+        if(isa > best) { continue; }
+        matcher.set_isa(isa);
+        const int reps = 10;
+        size_t hits = 0;
+
+        auto t0 = std::chrono::steady_clock::now();
+        for(int r = 0; r < reps; r++)
+            for(auto q: queries){ hits += matcher.prefilter(q).size(); }
+        auto t1 = std::chrono::steady_clock::now();
+        for(int r = 0; r < reps; r++)
+            for(auto q: queries){ matcher.match(q, 50); }
+        auto t2 = std::chrono::steady_clock::now();
+
+        auto per_query = [&](auto d)
+        {
+            return std::chrono::duration<double, std::micro>(d).count() / (reps * 6);
+        };
+        std::cout << std::setw(8) << names[static_cast<int>(isa)]
+                  << std::setw(14) << std::fixed << std::setprecision(1) << per_query(t1 - t0)
+                  << std::setw(14) << per_query(t2 - t1)
+                  << std::setw(10) << hits / reps << std::endl;
+    }
+    return 0;
+}
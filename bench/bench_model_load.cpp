@@ -0,0 +1,122 @@
+/**  Brief: Benchmark of FileBookmarkItemModel loading
+ *
+ *   Compares loading bookmarks item by item, firing one model signal per
+ *   row, against the batched deserialization path, which fires a single
+ *   signal. A QTableView is attached to the model, as in the application,
+ *   so that the cost of the notifications is accounted for.
+ *
+ *   The mapped path opens a BookmarkStore file and attaches it to the
+ *   model, then decodes the rows of a first screen, as a view would.
+ *
+ *   Usage: $ bench_model_load [rows ...]
+ ************************************************************************/
+#include <iostream>
+#include <iomanip>
+
+#include <QApplication>
+#include <QtWidgets>
+
+#include "src/tab_desktopbookmarks.hpp"
+
+// Same layout as value_writer<FileBookmarkItemModel>
+QByteArray make_dataset(int rows)
+{
+    QByteArray arr;
+    QDataStream ss{&arr, QIODevice::WriteOnly};
+    ss << rows;
+    for(int i = 0; i < rows; i++)
+    {
+        ss << QString("/home/user/projects/project%1/src/file%2.cpp").arg(i % 97).arg(i)
+           << QString("Brief %1").arg(i)
+           << QString{};
+    }
+    return arr;
+}
+
+double load_item_by_item(QByteArray const& arr)
+{
+    FileBookmarkItemModel model;
+    QTableView view;
+    view.setModel(&model);
+
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray copy = arr;
+    QDataStream ss{&copy, QIODevice::ReadOnly};
+    int count;
+    ss >> count;
+    for(int i = 0; i < count; i++)
+    {
+        QString uri_path, brief, description;
+        ss >> uri_path >> brief >> description;
+        model.add_item(FileBookmarkItem{uri_path, brief, description});
+    }
+    return timer.nsecsElapsed() / 1.0e6;
+}
+
+double load_batched(QByteArray const& arr)
+{
+    FileBookmarkItemModel model;
+    QTableView view;
+    view.setModel(&model);
+
+    QElapsedTimer timer;
+    timer.start();
+    qxstl::serialization::value_reader(model, QVariant(arr));
+    return timer.nsecsElapsed() / 1.0e6;
+}
+
+double load_mapped(QString const& store_file)
+{
+    FileBookmarkItemModel model;
+    QTableView view;
+    view.setModel(&model);
+
+    QElapsedTimer timer;
+    timer.start();
+    auto store = BookmarkStore::open(store_file);
+    model.attach(store);
+    // Rows of the first screen
+    for(int row = 0; row < std::min(50, model.rowCount()); row++)
+        for(int col = 0; col < model.columnCount(); col++)
+            model.data(model.index(row, col));
+    return timer.nsecsElapsed() / 1.0e6;
+}
+
+int main(int argc, char** argv)
+{
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+    QApplication app(argc, argv);
+
+    QList<int> sizes;
+    for(int i = 1; i < argc; i++){ sizes << QString(argv[i]).toInt(); }
+    if(sizes.isEmpty()){ sizes << 10000 << 100000 << 1000000; }
+
+    std::cout << std::setw(10) << "rows"
+              << std::setw(18) << "item-by-item ms"
+              << std::setw(14) << "batched ms"
+              << std::setw(14) << "mapped ms"   << std::endl;
+
+    QTemporaryDir tmp;
+    QString store_file = tmp.filePath("bench.qbk");
+
+    for(int rows: sizes)
+    {
+        QByteArray arr = make_dataset(rows);
+        double t_items = load_item_by_item(arr);
+        double t_batch = load_batched(arr);
+
+        FileBookmarkItemModel source;
+        qxstl::serialization::value_reader(source, QVariant(arr));
+        BookmarkStore::write(store_file, 0,
+                             std::vector<FileBookmarkItem>(source.begin(), source.end()));
+        double t_mapped = load_mapped(store_file);
+
+        std::cout << std::setw(10) << rows
+                  << std::setw(18) << std::fixed << std::setprecision(1) << t_items
+                  << std::setw(14) << t_batch
+                  << std::setw(14) << t_mapped << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,124 @@
+/**  Brief: Memory per bookmark of the path storage
+ *
+ *   Stores the paths of synthetic bookmarks, see dataset.hpp, as
+ *   FileBookmarkItem held them before and after the path trie:
+ *
+ *    + before: UTF-16 copies of the path, the file name, the directory
+ *      and the canonical path, one QString each
+ *    + after:  a node of a PathTrie, plus the node of the canonical path
+ *
+ *   Bytes per bookmark are reported from the allocated sizes, and from the
+ *   heap of the process on glibc, which includes the malloc overhead.
+ *
+ *   Usage: $ bench_path_store [bookmarks]
+ ************************************************************************/
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+
+#include <qxstl/PathTrie.hpp>
+
+#include "dataset.hpp"
+
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 33)
+#  include <malloc.h>
+#  define BENCH_HAS_MALLINFO2
+#endif
+
+namespace
+{
+    /// Bytes allocated on the heap, -1 if unknown
+    long long heap_bytes()
+    {
+#ifdef BENCH_HAS_MALLINFO2
+        return static_cast<long long>(mallinfo2().uordblks);
+#else
+        return -1;
+#endif
+    }
+
+    /// Size of a QString with its own buffer
+    std::size_t string_bytes(QString const& s)
+    {
+        if(s.isNull()) { return sizeof(QString); }
+        return sizeof(QString) + sizeof(QArrayData)
+               + static_cast<std::size_t>(s.capacity() + 1) * sizeof(QChar);
+    }
+
+    /// Deep copy, as a string read from a file or returned by QFileInfo
+    QString copy(QString const& s)
+    {
+        return QString{s.unicode(), s.size()};
+    }
+
+    struct PathsBefore
+    {
+        QString uri_path;
+        QString file_name;
+        QString file_path;
+        QString canonical_path;
+    };
+
+    struct PathsAfter
+    {
+        qxstl::storage::PathTrie::Id uri_path;
+        qxstl::storage::PathTrie::Id canonical_path;
+    };
+
+    void report(char const* name, int count, std::size_t allocated, long long heap)
+    {
+        std::cout << " " << std::left << std::setw(8) << name << std::right
+                  << std::setw(10) << std::fixed << std::setprecision(1)
+                  << static_cast<double>(allocated) / count << " B/entry allocated";
+        if(heap >= 0)
+        {
+            std::cout << std::setw(10) << static_cast<double>(heap) / count << " B/entry heap";
+        }
+        std::cout << std::endl;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int count  = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    auto paths = bench::make_bookmark_paths(count);
+    std::cout << " [INFO] Bookmarks = " << count << std::endl;
+
+    {
+        long long heap0 = heap_bytes();
+        std::vector<PathsBefore> before;
+        before.reserve(static_cast<size_t>(count));
+        std::size_t allocated = before.capacity() * sizeof(PathsBefore);
+        for(auto const& path: paths)
+        {
+            QFileInfo info{path};
+            bool is_url = path.startsWith("https://");
+            PathsBefore p{copy(path), is_url ? copy(path) : info.fileName(),
+                          is_url ? QString{} : info.absolutePath(),
+                          is_url ? QString{} : copy(path)};
+            allocated += string_bytes(p.uri_path) + string_bytes(p.file_name)
+                         + string_bytes(p.file_path) + string_bytes(p.canonical_path)
+                         - 4 * sizeof(QString);
+            before.push_back(std::move(p));
+        }
+        long long heap = heap0 < 0 ? -1 : heap_bytes() - heap0;
+        report("before", count, allocated, heap);
+    }
+    {
+        long long heap0 = heap_bytes();
+        qxstl::storage::PathTrie trie;
+        std::vector<PathsAfter> after;
+        after.reserve(static_cast<size_t>(count));
+        for(auto const& path: paths)
+        {
+            auto id = trie.intern(path);
+            // The canonical path of an existing target is the path itself.
+            after.push_back(PathsAfter{id, path.startsWith("https://") ? 0 : id});
+        }
+        std::size_t allocated = after.capacity() * sizeof(PathsAfter) + trie.memory_usage();
+        long long heap = heap0 < 0 ? -1 : heap_bytes() - heap0;
+        report("after", count, allocated, heap);
+        std::cout << " [INFO] Trie nodes = " << trie.size() << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,172 @@
+/**  Brief: Round-trip throughput of the settings serializers
+ *
+ *   Compares the legacy envelope, a QMap<QString, QVariant> per record
+ *   with lists boxed into nested QByteArray buffers, against the
+ *   compile-time schema serializer, which writes fields straight to a
+ *   single stream. Both write the same rows to memory and read them back.
+ *
+ *   Usage: $ bench_serialization [rows ...]
+ ************************************************************************/
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+#include <QtCore>
+
+#include <qxstl/serialization.hpp>
+
+namespace sz = qxstl::serialization;
+
+struct Row
+{
+    QString uri_path;
+    QString brief;
+    QString description;
+
+    bool operator==(Row const& rhs) const
+    {
+        return uri_path == rhs.uri_path && brief == rhs.brief
+               && description == rhs.description;
+    }
+
+    static constexpr auto schema = std::make_tuple(
+        sz::field(1, &Row::uri_path),
+        sz::field(2, &Row::brief),
+        sz::field(3, &Row::description));
+};
+
+/// Rows and the registry, as in the settings file of former versions
+struct LegacyRecord
+{
+    std::vector<Row> rows;
+    QStringList      registry;
+
+    template<typename Visitor>
+    void accept(Visitor& visitor)
+    {
+        visitor.visit("rows",     rows);
+        visitor.visit("registry", registry);
+    }
+};
+
+struct SchemaRecord
+{
+    std::vector<Row> rows;
+    QStringList      registry;
+
+    static constexpr auto schema = std::make_tuple(
+        sz::field(1, &SchemaRecord::rows),
+        sz::field(2, &SchemaRecord::registry));
+};
+
+// Same layout as value_writer<FileBookmarkItemModel>
+namespace qxstl::serialization
+{
+    template<>
+    QVariant value_writer(std::vector<Row>& rows)
+    {
+        QByteArray arr;
+        QDataStream ss{&arr, QIODevice::WriteOnly};
+        ss << static_cast<int>(rows.size());
+        for(auto const& r: rows){ ss << r.uri_path << r.brief << r.description; }
+        return arr;
+    }
+
+    template<>
+    inline void value_reader(std::vector<Row>& rows, QVariant value)
+    {
+        QByteArray arr = value.toByteArray();
+        QDataStream ss{&arr, QIODevice::ReadOnly};
+        int count = 0;
+        ss >> count;
+        rows.resize(static_cast<size_t>(count));
+        for(auto& r: rows){ ss >> r.uri_path >> r.brief >> r.description; }
+    }
+}
+
+std::vector<Row> make_rows(int count)
+{
+    std::vector<Row> rows;
+    rows.reserve(static_cast<size_t>(count));
+    for(int i = 0; i < count; i++)
+    {
+        rows.push_back(Row{
+            QString("/home/user/projects/project%1/src/file%2.cpp").arg(i % 97).arg(i),
+            QString("Brief %1").arg(i),
+            QString{}});
+    }
+    return rows;
+}
+
+/// Return the time in ms, and the size written
+template<typename Record, typename Write, typename Read>
+double round_trip(Record& in, Record& out, qint64& size, Write write, Read read)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray arr;
+    {
+        QDataStream ss{&arr, QIODevice::WriteOnly};
+        write(ss, in);
+    }
+    {
+        QDataStream ss{&arr, QIODevice::ReadOnly};
+        read(ss, out);
+    }
+    size = arr.size();
+    return timer.nsecsElapsed() / 1.0e6;
+}
+
+int main(int argc, char** argv)
+{
+    QList<int> sizes;
+    for(int i = 1; i < argc; i++){ sizes << QString(argv[i]).toInt(); }
+    if(sizes.isEmpty()){ sizes << 10000 << 100000 << 1000000; }
+
+    std::cout << std::setw(10) << "rows"
+              << std::setw(14) << "legacy ms"
+              << std::setw(14) << "legacy MB/s"
+              << std::setw(14) << "schema ms"
+              << std::setw(14) << "schema MB/s" << std::endl;
+
+    QStringList registry{"firefox", "code", "konsole", "okular"};
+
+    for(int count: sizes)
+    {
+        std::vector<Row> rows = make_rows(count);
+
+        LegacyRecord legacy_in{rows, registry}, legacy_out;
+        qint64 legacy_size = 0;
+        double t_legacy = round_trip(
+            legacy_in, legacy_out, legacy_size,
+            [](QDataStream& ss, LegacyRecord& r){ sz::StreamWriter{&ss}(r); },
+            [](QDataStream& ss, LegacyRecord& r)
+            {
+                sz::StreamReader reader;
+                reader.set_stream(&ss);
+                reader(r);
+            });
+
+        SchemaRecord schema_in{rows, registry}, schema_out;
+        qint64 schema_size = 0;
+        double t_schema = round_trip(
+            schema_in, schema_out, schema_size,
+            [](QDataStream& ss, SchemaRecord& r){ sz::SchemaWriter{&ss, 1}(r); },
+            [](QDataStream& ss, SchemaRecord& r){ sz::SchemaReader{&ss}(r); });
+
+        if(legacy_out.rows != rows || schema_out.rows != rows
+           || legacy_out.registry != registry || schema_out.registry != registry)
+        {
+            std::cerr << " [ERROR] Round trip mismatch at " << count << " rows" << std::endl;
+            return 1;
+        }
+
+        auto mbps = [](qint64 size, double ms){ return size / 1.0e3 / ms; };
+        std::cout << std::setw(10) << count
+                  << std::setw(14) << std::fixed << std::setprecision(1) << t_legacy
+                  << std::setw(14) << mbps(legacy_size, t_legacy)
+                  << std::setw(14) << t_schema
+                  << std::setw(14) << mbps(schema_size, t_schema) << std::endl;
+    }
+    return 0;
+}
@@ -0,0 +1,74 @@
+/**  Brief: Synthetic datasets of the benchmarks
+ *
+ *   Bookmarks and commands are generated from a fixed seed, so that runs
+ *   on the same machine can be compared.
+ ************************************************************************/
+#ifndef BENCH_DATASET_HPP
+#define BENCH_DATASET_HPP
+
+#include <random>
+#include <vector>
+
+#include <QtCore>
+
+#include "src/FileBookmarkItem.hpp"
+
+namespace bench
+{
+
+/// Paths of make_bookmarks(), spread over a tree of projects, with URLs
+/// mixed in.
+inline QStringList make_bookmark_paths(int count, unsigned seed = 42)
+{
+    static const char* const extensions[] = {"cpp", "hpp", "txt", "pdf", "org", "png"};
+    std::mt19937 rng{seed};
+    QStringList paths;
+    paths.reserve(count);
+    for(int i = 0; i < count; i++)
+    {
+        unsigned r = rng();
+        paths << ((r % 10 == 0)
+            ? QString("https://example.com/docs/page%1.html").arg(i)
+            : QString("/home/user/projects/project%1/src/module%2/file%3.%4")
+                  .arg(r % 97).arg((r >> 8) % 13).arg(i).arg(extensions[(r >> 16) % 6]));
+    }
+    return paths;
+}
+
+/// Bookmarks spread over a tree of projects, with URLs mixed in.
+inline std::vector<FileBookmarkItem> make_bookmarks(int count, unsigned seed = 42)
+{
+    auto paths = make_bookmark_paths(count, seed);
+    // Same draws as the paths
+    std::mt19937 rng{seed};
+    std::vector<FileBookmarkItem> items;
+    items.reserve(static_cast<size_t>(count));
+    for(int i = 0; i < count; i++)
+    {
+        unsigned r = rng();
+        items.emplace_back(paths[i], QString("Brief %1").arg(r % 100000), QString{});
+        items.back().resolve_names();
+    }
+    return items;
+}
+
+/// Shell commands, as typed in the launcher.
+inline QStringList make_commands(int count, unsigned seed = 42)
+{
+    static const char* const programs[] = {
+        "firefox", "code", "konsole", "okular", "emacs", "gimp", "vlc", "dolphin"};
+    std::mt19937 rng{seed};
+    QStringList commands;
+    commands.reserve(count);
+    for(int i = 0; i < count; i++)
+    {
+        unsigned r = rng();
+        commands << QString("%1 --profile p%2 /home/user/file%3")
+                        .arg(programs[r % 8]).arg((r >> 8) % 50).arg(i);
+    }
+    return commands;
+}
+
+}
+
+#endif // BENCH_DATASET_HPP
@@ -10,39 +10,47 @@
 #include <cassert>
 #include <string>
 
+#include "trace.hpp"
+
 namespace qxstl::gui {
 
 /**
   * Class FormLoader is a helper for loading QtWidgets dynamically
-  * from a Form without compilation. */
+  * from a Form without compilation, or from a form compiled by uic
+  * with the same API, see compiled().
+  *
+  * Widgets are indexed by object name in a single traversal of the
+  * form, so that looking them up does not walk the widget tree. */
 class FormLoader
 {
 private:
     QString  formFile;
     QWidget* form;
     QWidget* m_parent;
+    QHash<QString, QWidget*> m_widgets;
 public:
 
+    /// Load the form from a .ui file at runtime with QUiLoader.
     FormLoader(QMainWindow* parent, QString path)
     {
-        m_parent = parent;
-
         this->LoadForm(path);
-        parent->setCentralWidget(form);
-        parent->setWindowTitle(form->windowTitle());
-
-        // Set Width and height
-        parent->resize(form->width(), form->height());
+        this->install(parent);
+    }
 
-        // Center Window in the screen
-        parent->setGeometry(
-            QStyle::alignedRect(
-                Qt::LeftToRight,
-                Qt::AlignCenter,
-                parent->size(),
-                qApp->desktop()->availableGeometry()
-                )
-            );
+    /** Build the form with a class generated by uic from a .ui file,
+     *  for instance Ui::MainWindow, which avoids parsing XML at startup.
+     *  Root is the class of the top-level widget of the form.
+     */
+    template<typename UiForm, typename Root = QMainWindow>
+    static FormLoader compiled(QMainWindow* parent)
+    {
+        qxstl::trace::Span span{"FormLoader::compiled"};
+        auto root = new Root;
+        // The generated class only holds pointers to the widgets, which
+        // are owned by the root widget.
+        UiForm ui;
+        ui.setupUi(root);
+        return FormLoader(parent, root, QString("<compiled %1>").arg(root->objectName()));
     }
 
     virtual ~FormLoader() = default;
@@ -53,6 +61,7 @@ public:
 
     void LoadForm(QString filePath)
     {
+        qxstl::trace::Span span{"FormLoader::LoadForm"};
         QUiLoader loader;
         formFile = filePath;
         QFile file(filePath);
@@ -62,12 +71,15 @@ public:
         file.close();
     }
 
+    /// Path of the .ui file, or a description of the compiled form.
+    QString source() const { return formFile; }
+
     QWidget* GetForm() { return form;  }
 
     template<typename T>
     T* find_child(QString widget_name)
     {
-        T* widget = form->findChild<T*>(widget_name);
+        T* widget = this->lookup<T>(widget_name);
         // Throws exception if widget is not found in order to
         // make the failure easier to trace.
         this->ensure_widget_loaded(widget, widget_name);
@@ -78,7 +90,7 @@ public:
     template<typename Sender, typename Callback>
     void on_clicked(QString widget_name, Callback&& event_handler)
     {
-        Sender* pSender = form->findChild<Sender*>(widget_name);
+        Sender* pSender = this->lookup<Sender>(widget_name);
         this->ensure_widget_loaded(pSender, widget_name);
         QObject::connect(pSender, &Sender::clicked, event_handler);
     }
@@ -86,7 +98,7 @@ public:
     template<typename Sender, typename Receiver, typename Method>
     void on_clicked(QString widget_name, Receiver pReceiver, Method&& receiver_method)
     {
-        Sender* pSender = form->findChild<Sender*>(widget_name);
+        Sender* pSender = this->lookup<Sender>(widget_name);
         this->ensure_widget_loaded(pSender, widget_name);
         QObject::connect(pSender, &Sender::clicked, [=]
                          {
@@ -98,7 +110,7 @@ public:
     template<typename Sender, typename Callback>
     void on_src_clicked(QString widget_name, Callback&& event_handler)
     {
-        Sender* pSender = form->findChild<Sender*>(widget_name);
+        Sender* pSender = this->lookup<Sender>(widget_name);
         this->ensure_widget_loaded(pSender, widget_name);
         QObject::connect(pSender, &Sender::clicked, [=]{ event_handler(pSender); });
     }
@@ -120,7 +132,7 @@ public:
     template<typename Sender, typename Callback>
     void on_double_clicked(QString widget_name, Callback&& event_handler)
     {
-        Sender* pSender = form->findChild<Sender*>(widget_name);
+        Sender* pSender = this->lookup<Sender>(widget_name);
         this->ensure_widget_loaded(pSender, widget_name);
         QObject::connect(pSender, &Sender::doubleClicked, event_handler);
     }
@@ -129,18 +141,65 @@ public:
     template<typename Sender, typename Receiver, typename Method>
     void on_double_clicked(QString widget_name, Receiver pReceiver, Method&& receiver_method)
     {
-        Sender* pSender = form->findChild<Sender*>(widget_name);
-        if(pSender == nullptr){
-            using namespace std::string_literals;
-            throw std::runtime_error("Error: Unable to load widget named: <"s
-                                     + widget_name.toStdString()
-                                     + "> from the form file "s + formFile.toStdString());
-        }
+        Sender* pSender = this->lookup<Sender>(widget_name);
+        this->ensure_widget_loaded(pSender, widget_name);
         QObject::connect(pSender, &Sender::doubleClicked, pReceiver, receiver_method);
     }
 
 private:
 
+    FormLoader(QMainWindow* parent, QWidget* form, QString source)
+        : formFile{source}, form{form}
+    {
+        this->install(parent);
+    }
+
+    void install(QMainWindow* parent)
+    {
+        m_parent = parent;
+        this->index_widgets();
+
+        parent->setCentralWidget(form);
+        parent->setWindowTitle(form->windowTitle());
+
+        // Set Width and height
+        parent->resize(form->width(), form->height());
+
+        // Center Window in the screen
+        parent->setGeometry(
+            QStyle::alignedRect(
+                Qt::LeftToRight,
+                Qt::AlignCenter,
+                parent->size(),
+                qApp->desktop()->availableGeometry()
+                )
+            );
+    }
+
+    /// Index the widgets of the form by name, the first one wins when
+    /// names are duplicated.
+    void index_widgets()
+    {
+        m_widgets.clear();
+        const auto widgets = form->findChildren<QWidget*>();
+        m_widgets.reserve(widgets.size());
+        for(QWidget* w: widgets)
+        {
+            if(!w->objectName().isEmpty() && !m_widgets.contains(w->objectName()))
+            {
+                m_widgets.insert(w->objectName(), w);
+            }
+        }
+    }
+
+    template<typename T>
+    T* lookup(QString const& widget_name)
+    {
+        if(T* widget = qobject_cast<T*>(m_widgets.value(widget_name))) { return widget; }
+        // Widgets added to the form after it was loaded are not indexed.
+        return form->findChild<T*>(widget_name);
+    }
+
     /** Ensure that widget was loaded from XML. Throws exception if the widget
      *  cannot be found in the form file.
      * This function makes the error diagnosing easier.
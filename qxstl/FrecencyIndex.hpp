@@ -0,0 +1,128 @@
+/*  Brief:  Exponentially decayed usage scores (frecency)
+ *
+ *
+ ************************************************************************/
+
+#ifndef FRECENCYINDEX_HPP
+#define FRECENCYINDEX_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+namespace qxstl::ranking
+{
+
+/** Class FrecencyIndex scores items by how often and how recently they
+ *  were used: every use adds 1 to the score of the item, and scores decay
+ *  exponentially with the given half-life.
+ *
+ *  + Decaying every score on every event would cost O(n). Instead, a use
+ *    at time t adds exp(lambda * t) to the score, and the sum is kept as
+ *    its logarithm, the rank. All scores decay by the same factor, so the
+ *    ranks order the items at any time without being updated:
+ *
+ *      score(now) = exp(rank - lambda * now)
+ *
+ *  + A use costs O(1) for the score, and O(log n) for the ordered set of
+ *    ranks that answers top(k) in O(k).
+ *
+ *  Times are in seconds, relative to any fixed epoch.
+ *************************************************************************/
+class FrecencyIndex
+{
+public:
+    using Key = std::uint64_t;
+
+    explicit FrecencyIndex(double half_life_seconds = 14 * 86400.0)
+        : m_lambda{std::log(2.0) / half_life_seconds}
+    { }
+
+    /// Rank added by a single use at the given time.
+    double rank_of_use(double time) const
+    {
+        return m_lambda * time;
+    }
+
+    /// Record a use of the item at the given time.
+    void record(Key key, double time)
+    {
+        this->add_rank(key, this->rank_of_use(time));
+    }
+
+    /// Add a rank computed by rank_of_use(), or the total rank of an item
+    /// saved by a compaction.
+    void add_rank(Key key, double rank)
+    {
+        auto it = m_ranks.find(key);
+        if(it == m_ranks.end())
+        {
+            m_ranks.emplace(key, rank);
+            m_order.emplace(rank, key);
+            return;
+        }
+        double old = it->second;
+        // log(exp(a) + exp(b)) without overflow
+        double hi = std::max(old, rank), lo = std::min(old, rank);
+        double sum = hi + std::log1p(std::exp(lo - hi));
+        m_order.erase({old, key});
+        m_order.emplace(sum, key);
+        it->second = sum;
+    }
+
+    /// Rank of an item, -infinity if it was never used. Higher is better.
+    double rank(Key key) const
+    {
+        auto it = m_ranks.find(key);
+        return it == m_ranks.end() ? -std::numeric_limits<double>::infinity() : it->second;
+    }
+
+    /// Decayed number of uses of the item at the given time.
+    double score(Key key, double now) const
+    {
+        auto it = m_ranks.find(key);
+        return it == m_ranks.end() ? 0.0 : std::exp(it->second - m_lambda * now);
+    }
+
+    /// The k best items with their ranks, best first.
+    std::vector<std::pair<Key, double>> top(std::size_t k) const
+    {
+        std::vector<std::pair<Key, double>> result;
+        for(auto it = m_order.rbegin(); it != m_order.rend() && result.size() < k; ++it)
+            result.emplace_back(it->second, it->first);
+        return result;
+    }
+
+    /// Number of items used at least once
+    std::size_t size() const
+    {
+        return m_ranks.size();
+    }
+
+    void clear()
+    {
+        m_ranks.clear();
+        m_order.clear();
+    }
+
+    /// Ranks of all items, in no particular order.
+    std::unordered_map<Key, double> const& ranks() const
+    {
+        return m_ranks;
+    }
+
+private:
+    double                           m_lambda;
+    std::unordered_map<Key, double>  m_ranks;
+    // Ascending (rank, key)
+    std::set<std::pair<double, Key>> m_order;
+};
+
+}
+
+#endif // FRECENCYINDEX_HPP
@@ -0,0 +1,229 @@
+/*  Brief:  Interned paths sharing their directory prefixes
+ *
+ *
+ ************************************************************************/
+
+#ifndef PATHTRIE_HPP
+#define PATHTRIE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <QtCore>
+
+namespace qxstl::storage
+{
+
+/** Class PathTrie interns paths as nodes of a tree of segments split at
+ *  '/', so that paths of the same directory share the nodes of their
+ *  prefix. A path is referenced by the 32-bit identifier of its last
+ *  node, and the string is rebuilt only when it is asked for.
+ *
+ *  + Segments are stored once per node in a pool of UTF-8 bytes. A node
+ *    costs 12 bytes plus a slot of the hash table finding the child of a
+ *    node by segment, instead of a UTF-16 copy of the whole path.
+ *
+ *  + Any string is interned exactly: empty segments are nodes too, so
+ *    that "/a//b/" is rebuilt as is. The empty string is the node 0.
+ *
+ *  + Nodes are never freed, interning a path that is already known does
+ *    not grow the trie. Paths that are only compared with the interned
+ *    ones, such as results of the filesystem, are looked up with find()
+ *    instead, which never adds a node.
+ *
+ *  + Paths can be read concurrently from worker threads, while new paths
+ *    are interned from the GUI thread.
+ *************************************************************************/
+class PathTrie
+{
+public:
+    using Id = std::uint32_t;
+
+    PathTrie()
+    {
+        // Root: the empty path
+        m_nodes.push_back(Node{0, 0, 0});
+        m_slots.assign(1024, 0);
+    }
+
+    PathTrie(PathTrie const&) = delete;
+    PathTrie& operator=(PathTrie const&) = delete;
+
+    /// Return the node of a path, adding the missing ones.
+    Id intern(QString const& path)
+    {
+        if(path.isEmpty()) { return 0; }
+        QByteArray utf8 = path.toUtf8();
+        QWriteLocker lock{&m_lock};
+        Id node = 0;
+        int first = 0;
+        for(;;)
+        {
+            int last = utf8.indexOf('/', first);
+            int end  = last < 0 ? utf8.size() : last;
+            node = this->child(node, utf8.constData() + first, end - first);
+            if(last < 0) { return node; }
+            first = last + 1;
+        }
+    }
+
+    /// Return the node of a path already interned, 0 if it is not.
+    Id find(QString const& path) const
+    {
+        if(path.isEmpty()) { return 0; }
+        QByteArray utf8 = path.toUtf8();
+        QReadLocker lock{&m_lock};
+        Id node = 0;
+        int first = 0;
+        for(;;)
+        {
+            int last = utf8.indexOf('/', first);
+            int end  = last < 0 ? utf8.size() : last;
+            node = this->find_child(node, utf8.constData() + first, end - first);
+            if(node == 0 || last < 0) { return node; }
+            first = last + 1;
+        }
+    }
+
+    /// Rebuild the path of a node.
+    QString path(Id id) const
+    {
+        QReadLocker lock{&m_lock};
+        if(id == 0 || id >= m_nodes.size()) { return QString{}; }
+        // Segments from the node up to the root, then written backwards
+        std::vector<Id> chain;
+        std::size_t size = 0;
+        for(Id n = id; n != 0; n = m_nodes[n].parent)
+        {
+            chain.push_back(n);
+            size += m_nodes[n].length + 1;
+        }
+        std::string utf8;
+        utf8.reserve(size);
+        for(auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            if(it != chain.rbegin()) { utf8 += '/'; }
+            auto const& node = m_nodes[*it];
+            utf8.append(m_pool, node.offset, node.length);
+        }
+        return QString::fromUtf8(utf8.data(), static_cast<int>(utf8.size()));
+    }
+
+    /// Last segment of the path, the file name.
+    QString name(Id id) const
+    {
+        QReadLocker lock{&m_lock};
+        if(id == 0 || id >= m_nodes.size()) { return QString{}; }
+        auto const& node = m_nodes[id];
+        return QString::fromUtf8(m_pool.data() + node.offset, static_cast<int>(node.length));
+    }
+
+    /// Node of the path without its last segment, 0 for a single segment.
+    Id parent(Id id) const
+    {
+        QReadLocker lock{&m_lock};
+        return id < m_nodes.size() ? m_nodes[id].parent : 0;
+    }
+
+    /// Number of nodes, including the root
+    std::size_t size() const
+    {
+        QReadLocker lock{&m_lock};
+        return m_nodes.size();
+    }
+
+    /// Bytes allocated for the nodes, the segments and the hash table.
+    std::size_t memory_usage() const
+    {
+        QReadLocker lock{&m_lock};
+        return m_nodes.capacity() * sizeof(Node) + m_pool.capacity()
+               + m_slots.capacity() * sizeof(Id);
+    }
+
+private:
+    struct Node
+    {
+        Id            parent;
+        std::uint32_t offset;
+        std::uint32_t length;
+    };
+
+    mutable QReadWriteLock m_lock;
+    std::vector<Node>      m_nodes;
+    std::string            m_pool;
+    // Open addressing with linear probing, 0 marks an empty slot. The
+    // table is kept at most half full.
+    std::vector<Id>        m_slots;
+
+    static std::uint64_t hash(Id parent, const char* data, int size)
+    {
+        // FNV-1a over the parent and the segment
+        std::uint64_t h = 0xcbf29ce484222325ull ^ parent;
+        h *= 0x100000001b3ull;
+        for(int i = 0; i < size; i++)
+        {
+            h ^= static_cast<unsigned char>(data[i]);
+            h *= 0x100000001b3ull;
+        }
+        return h;
+    }
+
+    bool equals(Id id, Id parent, const char* data, int size) const
+    {
+        auto const& node = m_nodes[id];
+        return node.parent == parent && node.length == static_cast<std::uint32_t>(size)
+               && m_pool.compare(node.offset, node.length, data, static_cast<std::size_t>(size)) == 0;
+    }
+
+    /// Find the child of a node, 0 if missing. A lock must be held.
+    Id find_child(Id parent, const char* data, int size) const
+    {
+        std::size_t mask = m_slots.size() - 1;
+        std::size_t slot = hash(parent, data, size) & mask;
+        while(m_slots[slot] != 0)
+        {
+            if(this->equals(m_slots[slot], parent, data, size)) { return m_slots[slot]; }
+            slot = (slot + 1) & mask;
+        }
+        return 0;
+    }
+
+    /// Find or add the child of a node, the write lock must be held.
+    Id child(Id parent, const char* data, int size)
+    {
+        std::size_t mask = m_slots.size() - 1;
+        std::size_t slot = hash(parent, data, size) & mask;
+        while(m_slots[slot] != 0)
+        {
+            if(this->equals(m_slots[slot], parent, data, size)) { return m_slots[slot]; }
+            slot = (slot + 1) & mask;
+        }
+        auto id = static_cast<Id>(m_nodes.size());
+        m_nodes.push_back(Node{parent, static_cast<std::uint32_t>(m_pool.size()),
+                               static_cast<std::uint32_t>(size)});
+        m_pool.append(data, static_cast<std::size_t>(size));
+        m_slots[slot] = id;
+        if(m_nodes.size() * 2 > m_slots.size()) { this->rehash(); }
+        return id;
+    }
+
+    void rehash()
+    {
+        std::vector<Id> slots(m_slots.size() * 2, 0);
+        std::size_t mask = slots.size() - 1;
+        for(Id id = 1; id < m_nodes.size(); id++)
+        {
+            auto const& node = m_nodes[id];
+            std::size_t slot = hash(node.parent, m_pool.data() + node.offset,
+                                    static_cast<int>(node.length)) & mask;
+            while(slots[slot] != 0) { slot = (slot + 1) & mask; }
+            slots[slot] = id;
+        }
+        m_slots.swap(slots);
+    }
+};
+
+}
+
+#endif // PATHTRIE_HPP
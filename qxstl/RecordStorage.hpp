@@ -0,0 +1,220 @@
+/*  Brief:  Storage policies of RecordTableModel
+ *
+ *
+ ************************************************************************/
+
+#ifndef RECORDSTORAGE_HPP
+#define RECORDSTORAGE_HPP
+
+#include <cstddef>
+#include <deque>
+#include <iterator>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace qxstl::model
+{
+
+/** Class DequeStorage keeps whole items in a deque, this is the default
+ *  storage of RecordTableModel.
+ *
+ *  A storage holds the items in insertion order and provides:
+ *
+ *   + reference, const_reference - what get() returns, a reference to the
+ *     stored item or an item rebuilt by value.
+ *
+ *   + size(), clear(), push_back(item), erase(pos) and erase_marked(marks),
+ *     which erases the positions flagged in a std::vector<bool>.
+ *
+ *   + get(pos), modify(pos, func) - func takes the item by reference and
+ *     the change is written back to the storage.
+ *
+ *   + begin(), end() - iterators over the items in insertion order.
+ *************************************************************************/
+template<typename TItem>
+class DequeStorage
+{
+public:
+    using value_type      = TItem;
+    using reference       = TItem&;
+    using const_reference = TItem const&;
+
+    std::size_t size() const { return m_items.size(); }
+
+    void clear() { m_items.clear(); }
+
+    void push_back(TItem item) { m_items.push_back(std::move(item)); }
+
+    void erase(std::size_t pos) { m_items.erase(m_items.begin() + static_cast<std::ptrdiff_t>(pos)); }
+
+    void erase_marked(std::vector<bool> const& marked)
+    {
+        std::size_t j = 0;
+        for(std::size_t i = 0; i < m_items.size(); i++)
+        {
+            if(marked[i]) { continue; }
+            if(i != j) { m_items[j] = std::move(m_items[i]); }
+            j++;
+        }
+        m_items.erase(m_items.begin() + static_cast<std::ptrdiff_t>(j), m_items.end());
+    }
+
+    TItem&       get(std::size_t pos)       { return m_items[pos]; }
+    TItem const& get(std::size_t pos) const { return m_items[pos]; }
+
+    template<typename Func>
+    decltype(auto) modify(std::size_t pos, Func&& func)
+    {
+        return std::forward<Func>(func)(m_items[pos]);
+    }
+
+    auto begin()       { return m_items.begin(); }
+    auto end()         { return m_items.end();   }
+    auto begin() const { return m_items.begin(); }
+    auto end()   const { return m_items.end();   }
+
+private:
+    std::deque<TItem> m_items;
+};
+
+/** Layout of the columns of a ColumnStorage, it must be specialized for
+ *  each item type. A specialization provides:
+ *
+ *    using Columns = std::tuple<std::vector<...>, ...>;
+ *    static void  append(Columns& columns, TItem const& item);
+ *    static TItem load(Columns const& columns, std::size_t pos);
+ *    static void  store(Columns& columns, std::size_t pos, TItem const& item);
+ *
+ *  Every column must have one element per item.
+ */
+template<typename TItem>
+struct ColumnLayout;
+
+/** Class ColumnStorage keeps each field of the items in its own
+ *  contiguous vector (struct of arrays), as laid out by Layout.
+ *
+ *  + A scan over a single field, such as matching paths or filtering on a
+ *    type, only reads that vector instead of whole items. Small fields can
+ *    be packed as bytes, and flags as bits with std::vector<bool>.
+ *
+ *  + Items are rebuilt by value by get() and by the iterators, a change
+ *    goes through modify(), which writes all fields back.
+ *
+ *  + column<K>() gives read access to the vectors.
+ *************************************************************************/
+template<typename TItem, typename Layout = ColumnLayout<TItem>>
+class ColumnStorage
+{
+public:
+    using Columns         = typename Layout::Columns;
+    using value_type      = TItem;
+    using reference       = TItem;
+    using const_reference = TItem;
+
+    /// Input iterator rebuilding the items one by one
+    class const_iterator
+    {
+    public:
+        using iterator_category = std::input_iterator_tag;
+        using value_type        = TItem;
+        using difference_type   = std::ptrdiff_t;
+        using pointer           = void;
+        using reference         = TItem;
+
+        const_iterator(ColumnStorage const* storage, std::size_t pos)
+            : m_storage{storage}, m_pos{pos}
+        { }
+
+        TItem operator*() const { return m_storage->get(m_pos); }
+
+        const_iterator& operator++() { ++m_pos; return *this; }
+        const_iterator  operator++(int) { auto it = *this; ++m_pos; return it; }
+
+        bool operator==(const_iterator const& rhs) const { return m_pos == rhs.m_pos; }
+        bool operator!=(const_iterator const& rhs) const { return m_pos != rhs.m_pos; }
+
+    private:
+        ColumnStorage const* m_storage;
+        std::size_t          m_pos;
+    };
+
+    std::size_t size() const { return m_size; }
+
+    void clear()
+    {
+        std::apply([](auto&... column){ (column.clear(), ...); }, m_columns);
+        m_size = 0;
+    }
+
+    void push_back(TItem const& item)
+    {
+        Layout::append(m_columns, item);
+        m_size++;
+    }
+
+    void erase(std::size_t pos)
+    {
+        auto offset = static_cast<std::ptrdiff_t>(pos);
+        std::apply([offset](auto&... column){ (column.erase(column.begin() + offset), ...); },
+                   m_columns);
+        m_size--;
+    }
+
+    void erase_marked(std::vector<bool> const& marked)
+    {
+        std::size_t kept = 0;
+        std::apply([&](auto&... column){ ((kept = compact(column, marked)), ...); }, m_columns);
+        m_size = kept;
+    }
+
+    TItem get(std::size_t pos) const { return Layout::load(m_columns, pos); }
+
+    template<typename Func>
+    decltype(auto) modify(std::size_t pos, Func&& func)
+    {
+        TItem item = Layout::load(m_columns, pos);
+        if constexpr(std::is_void_v<decltype(func(item))>)
+        {
+            std::forward<Func>(func)(item);
+            Layout::store(m_columns, pos, item);
+        }
+        else
+        {
+            decltype(auto) result = std::forward<Func>(func)(item);
+            Layout::store(m_columns, pos, item);
+            return result;
+        }
+    }
+
+    /// Vector of the K-th field, indexed by position
+    template<std::size_t K>
+    auto const& column() const { return std::get<K>(m_columns); }
+
+    const_iterator begin() const { return const_iterator{this, 0};      }
+    const_iterator end()   const { return const_iterator{this, m_size}; }
+
+private:
+    Columns     m_columns;
+    std::size_t m_size = 0;
+
+    // Keep the unmarked elements of a column in place, return their number
+    template<typename Column>
+    static std::size_t compact(Column& column, std::vector<bool> const& marked)
+    {
+        std::size_t j = 0;
+        for(std::size_t i = 0; i < column.size(); i++)
+        {
+            if(marked[i]) { continue; }
+            if(i != j) { column[j] = std::move(column[i]); }
+            j++;
+        }
+        column.resize(j);
+        return j;
+    }
+};
+
+}
+
+#endif // RECORDSTORAGE_HPP
@@ -10,14 +10,156 @@
 #include <iostream>
 #include <functional>
 #include <deque>
+#include <list>
+#include <unordered_map>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <iterator>
+#include <memory>
+#include <numeric>
+#include <type_traits>
 
 #include <QtWidgets>
 #include <QApplication>
 #include <QSysInfo>
 
+#include "metrics.hpp"
+#include "RecordStorage.hpp"
+
 namespace qxstl::model
 {
 
+/** Interface for objects that mirror the content of a RecordTableModel,
+ *  such as search indexes. Items are identified by their position in
+ *  insertion order (see RecordTableModel::begin()), which does not depend
+ *  on the sort order or on the filter of the view.
+ */
+template<typename TItem>
+struct RecordObserver
+{
+    virtual ~RecordObserver() = default;
+
+    // An item was appended at the given position
+    virtual void item_inserted(int position, TItem const& item) = 0;
+
+    // The item at the given position was modified
+    virtual void item_updated(int position, TItem const& item) = 0;
+
+    // Items were erased, the following positions are shifted down.
+    // Positions are sorted in ascending order.
+    virtual void items_removed(std::vector<int> const& positions) = 0;
+
+    // All items were erased, new items may follow.
+    virtual void items_reset() = 0;
+
+    // The model was attached to a source of count items, which are
+    // decoded later, see RecordTableModel::attach().
+    virtual void items_attached(int count)
+    {
+        Q_UNUSED(count)
+    }
+
+    // An item of the attached source was decoded into the model. It is
+    // not a new item, it was already counted by items_attached().
+    virtual void item_loaded(int position, TItem const& item)
+    {
+        Q_UNUSED(position)
+        Q_UNUSED(item)
+    }
+
+    // The user moved the items at the given positions, see
+    // RecordTableModel::manual_order(). All keys changed if it is empty.
+    virtual void order_changed(std::vector<int> const& positions)
+    {
+        Q_UNUSED(positions)
+    }
+};
+
+/** Read-only collection of items that a RecordTableModel can display
+ *  without holding them in memory, such as a memory-mapped file, an index
+ *  or a generator. Items are decoded one by one on demand. Implementations
+ *  must be thread-safe for reading, a snapshot may read the source from a
+ *  worker thread.
+ */
+template<typename TItem>
+struct RecordSource
+{
+    virtual ~RecordSource() = default;
+
+    // Number of items
+    virtual int size() const = 0;
+
+    // Decode the item at a position
+    virtual TItem item(int position) const = 0;
+};
+
+/** Source computing items with a function, for generated datasets.
+ *  Example:
+ *    auto source = std::make_shared<FunctionSource<Item>>(
+ *                      1000000, [](int n){ return Item{n}; });
+ *    model.attach(source);
+ */
+template<typename TItem>
+class FunctionSource: public RecordSource<TItem>
+{
+    int                         m_size;
+    std::function<TItem (int)>  m_func;
+public:
+    FunctionSource(int size, std::function<TItem (int)> func)
+        : m_size{size}, m_func{std::move(func)}
+    { }
+
+    int size() const override { return m_size; }
+
+    TItem item(int position) const override { return m_func(position); }
+};
+
+/** Source made of another one with some of its items replaced or removed,
+ *  see RecordTableModel::source(). The changes are copied, it does not
+ *  change when the model does.
+ */
+template<typename TItem>
+class PatchedSource: public RecordSource<TItem>
+{
+    std::shared_ptr<RecordSource<TItem> const> m_base;
+    std::unordered_map<int, TItem>              m_patched;
+    std::vector<int>                            m_removed;
+public:
+    PatchedSource(std::shared_ptr<RecordSource<TItem> const> base,
+                  std::unordered_map<int, TItem> patched, std::vector<int> removed)
+        : m_base{std::move(base)}, m_patched{std::move(patched)}, m_removed{std::move(removed)}
+    { }
+
+    int size() const override
+    {
+        return m_base->size() - static_cast<int>(m_removed.size());
+    }
+
+    TItem item(int position) const override
+    {
+        int s = base_position(m_removed, position);
+        auto it = m_patched.find(s);
+        return it != m_patched.end() ? it->second : m_base->item(s);
+    }
+
+    /// Position in the base source of the item at a position, given the
+    /// positions of the removed items in ascending order.
+    static int base_position(std::vector<int> const& removed, int position)
+    {
+        // removed[i] - i items are kept before removed[i], which does not
+        // decrease: count the removed items before the position.
+        size_t lo = 0, hi = removed.size();
+        while(lo < hi)
+        {
+            size_t mid = (lo + hi) / 2;
+            if(removed[mid] - static_cast<int>(mid) <= position) { lo = mid + 1; }
+            else                                                 { hi = mid; }
+        }
+        return position + static_cast<int>(lo);
+    }
+};
+
 /**
  *
  *  Note: References that helped implementing this class.
@@ -38,17 +180,38 @@ namespace qxstl::model
  *   + How to make a constant correct read only model view architecture in QT?
  *    - https://stackoverflow.com/questions/9988342/
  *
+ *  Note: Sorting never moves the items, it only permutes the vector
+ *  m_order, which maps view rows to positions in the dataset. Rows are
+ *  compared through locale-aware collation keys (natural order), which are
+ *  computed the first time a column is sorted and kept up to date on
+ *  every insertion and change.
+ *
+ *  Note: Each item has a stable identifier, see id(), and the rows can be
+ *  reordered by the user through moveRows() or drag and drop. The order
+ *  set this way is a sort order too: items keep their positions. Sorting
+ *  by a column or a rank hides it, and sort(-1) displays it again instead
+ *  of the insertion order.
+ *
+ *  Note: Items are held by the storage policy TStorage, see
+ *  RecordStorage.hpp. The default DequeStorage keeps whole items, while
+ *  ColumnStorage keeps each field in its own vector and rebuilds items by
+ *  value: at() then returns a copy, and items are changed with modify().
+ *
  **************************************************************************/
-template<typename TItem>
+template<typename TItem, typename TStorage = DequeStorage<TItem>>
 class RecordTableModel: public QAbstractTableModel
 {
 public:
 
     RecordTableModel()
-    { }
+    {
+        this->init_collator();
+    }
 
     RecordTableModel(QWidget* parent): QAbstractTableModel(parent)
-    { }
+    {
+        this->init_collator();
+    }
 
     virtual ~RecordTableModel() = default;
 
@@ -69,50 +232,567 @@ public:
     // if the column 1 is not editable, this function returns false for column 1.
     virtual bool is_column_editable(int column) const = 0;
 
+    // Columns that the view can sort by clicking at the header.
+    virtual bool is_column_sortable(int column) const
+    {
+        Q_UNUSED(column)
+        return true;
+    }
+
+    // Data of roles other than display and edit, such as colors and
+    // tooltips. Derived classes may override it.
+    virtual QVariant display_item_role(TItem const& item, int column, int role) const
+    {
+        Q_UNUSED(item)
+        Q_UNUSED(column)
+        Q_UNUSED(role)
+        return QVariant{};
+    }
+
+    /** Display the items of a source without decoding them (lazy mode).
+     *
+     *  + Rows are exposed to views in pages, through canFetchMore() and
+     *    fetchMore(), as the user scrolls.
+     *
+     *  + Only the rows painted by the view are decoded, by data(), and the
+     *    decoded items are kept in a cache of bounded size, evicting the
+     *    least recently used.
+     *
+     *  + Changing or removing an item by its position, see modify_item(),
+     *    set_item_data() and remove_item_at(), only decodes that item. It
+     *    is kept aside and the others are left in the source.
+     *
+     *  + The first operation that needs all items, such as inserting,
+     *    sorting or filtering, decodes all of them into the model and
+     *    detaches the source, see materialize().
+     */
+    void attach(std::shared_ptr<RecordSource<TItem> const> source)
+    {
+        this->beginResetModel();
+        for(auto const& item: m_dataset){ this->on_item_removed(item); }
+        m_dataset.clear();
+        m_order.clear();
+        for(auto& keys: m_sort_keys){ keys.second.clear(); }
+        m_rank_keys.clear();
+        this->clear_manual_order();
+        m_filtered = false;
+        m_hidden.clear();
+        m_ids.clear();
+        this->clear_patches();
+        m_source = std::move(source);
+        // Identifiers of the source items are reserved, see id_at().
+        m_source_first_id = m_next_id;
+        m_next_id += static_cast<quint64>(m_source->size());
+        m_fetched = std::min(m_fetch_page_size, m_source->size());
+        m_cache.clear();
+        m_cache_index.clear();
+        for(auto obs: m_observers){ obs->items_reset(); }
+        for(auto obs: m_observers){ obs->items_attached(m_source->size()); }
+        // Rows of a source are displayed in insertion order.
+        if(this->is_sorted())
+        {
+            this->decode_all();
+            this->sort_indices();
+        }
+        this->endResetModel();
+    }
+
+    /// Number of rows exposed to views by each fetchMore() call.
+    void set_fetch_page_size(int rows)
+    {
+        m_fetch_page_size = std::max(rows, 1);
+    }
+
+    /// Maximum number of decoded items kept by the lazy mode.
+    void set_cache_capacity(int items)
+    {
+        m_cache_capacity = std::max(items, 1);
+        this->trim_cache();
+    }
+
+    /// True while items of an attached source are not decoded.
+    bool has_source() const
+    {
+        return m_source != nullptr;
+    }
+
+    /// Source whose items are not decoded yet, null once materialized.
+    /// Once items were changed or removed, a copy of the changes on top of
+    /// the attached source, see PatchedSource.
+    std::shared_ptr<RecordSource<TItem> const> source() const
+    {
+        if(!m_source || (m_patched.empty() && m_removed.empty())) { return m_source; }
+        if(!m_patched_source)
+        {
+            m_patched_source = std::make_shared<PatchedSource<TItem>>(m_source, m_patched, m_removed);
+        }
+        return m_patched_source;
+    }
+
+    /// Decode all items of the attached source and detach it. Rows not
+    /// fetched yet are inserted into the views.
+    void materialize()
+    {
+        if(!m_source) { return; }
+        int shown = m_fetched;
+        int n     = this->source_size();
+        this->decode_all();
+        if(shown == n) { return; }
+        // Views only know the fetched rows so far.
+        m_order.resize(static_cast<size_t>(shown));
+        this->beginInsertRows(QModelIndex(), shown, n - 1);
+        for(int s = shown; s < n; s++){ m_order.push_back(s); }
+        this->endInsertRows();
+    }
+
     void add_item(TItem item)
     {
-        int n = m_dataset.size();
-        this->beginInsertRows(QModelIndex(), n, n);
+        this->materialize();
+        this->on_item_added(item);
+        int s = static_cast<int>(m_dataset.size());
         m_dataset.push_back(std::move(item));
+        m_ids.push_back(m_next_id++);
+        this->append_keys(s);
+        if(m_filtered) { m_hidden.push_back(false); }
+        this->notify_inserted(s);
+        // When the model is sorted, the row is inserted at its place
+        // found by binary search instead of sorting the model again.
+        int n = this->insert_position(s);
+        this->beginInsertRows(QModelIndex(), n, n);
+        m_order.insert(m_order.begin() + n, s);
         // Notify view that model data has changed => view updates itself
         this->endInsertRows();
     }
 
+    /** Append a range of items firing a single model signal.
+     *  Example: model.add_items(items.begin(), items.end());
+     *  Note: Elements are copied unless move iterators are passed.
+     */
+    template<typename Iterator>
+    void add_items(Iterator first, Iterator last)
+    {
+        int n = static_cast<int>(std::distance(first, last));
+        if(n == 0) { return; }
+        this->materialize();
+        int start = static_cast<int>(m_order.size());
+        this->beginInsertRows(QModelIndex(), start, start + n - 1);
+        for(; first != last; ++first)
+        {
+            int s = static_cast<int>(m_dataset.size());
+            TItem item = *first;
+            this->on_item_added(item);
+            m_dataset.push_back(std::move(item));
+            m_ids.push_back(m_next_id++);
+            this->append_keys(s);
+            if(m_filtered) { m_hidden.push_back(false); }
+            this->notify_inserted(s);
+            m_order.push_back(s);
+        }
+        this->endInsertRows();
+        // Rows are appended and then moved to their place all at once.
+        if(this->is_sorted()) { this->sort_order(); }
+    }
+
+    /** Replace all items of the model by the container elements, which are
+     *  moved into the model. Views are reset only once.
+     *  Example: model.assign(std::move(items_vector));
+     */
+    template<typename Container>
+    void assign(Container&& items)
+    {
+        static_assert(!std::is_lvalue_reference<Container>::value,
+                      "assign() takes ownership of the container elements, use std::move()");
+        this->beginResetModel();
+        for(auto const& item: m_dataset){ this->on_item_removed(item); }
+        m_dataset.clear();
+        this->detach();
+        for(auto& keys: m_sort_keys){ keys.second.clear(); }
+        m_rank_keys.clear();
+        // Positions of a previous filter or order are meaningless now
+        this->clear_manual_order();
+        m_filtered = false;
+        m_hidden.clear();
+        m_ids.clear();
+        for(auto obs: m_observers){ obs->items_reset(); }
+        for(auto& item: items)
+        {
+            this->on_item_added(item);
+            m_dataset.push_back(std::move(item));
+            m_ids.push_back(m_next_id++);
+            this->append_keys(static_cast<int>(m_dataset.size()) - 1);
+            this->notify_inserted(static_cast<int>(m_dataset.size()) - 1);
+        }
+        this->sort_indices();
+        this->endResetModel();
+    }
+
+    /// Remove rows from first to last, including the last one, firing a
+    /// single model signal.
+    void remove_rows(int first, int last)
+    {
+        int size = this->count();
+        if(first < 0 || last >= size || first > last){ return; }
+        std::vector<int> rows(static_cast<size_t>(last - first + 1));
+        std::iota(rows.begin(), rows.end(), first);
+        this->remove_items(std::move(rows));
+    }
+
+    /** Remove the items displayed at the given rows, which may be anywhere
+     *  in the view, such as a multi-row selection. Items are erased in a
+     *  single pass, views are notified once per range of contiguous rows,
+     *  or reset once if there are many ranges.
+     */
+    void remove_items(std::vector<int> rows)
+    {
+        int size = this->count();
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+        rows.erase(std::remove_if(rows.begin(), rows.end(),
+                                  [size](int r){ return r < 0 || r >= size; }),
+                   rows.end());
+        if(rows.empty()) { return; }
+        // Rows of a source are positions.
+        if(m_source) { this->remove_source_items(rows); return; }
+
+        std::vector<std::pair<int, int>> ranges;
+        for(int r: rows)
+        {
+            if(!ranges.empty() && ranges.back().second + 1 == r) { ranges.back().second = r; }
+            else                                                  { ranges.emplace_back(r, r); }
+        }
+        bool reset = ranges.size() > 16;
+        if(reset) { this->beginResetModel(); }
+
+        std::vector<bool> dead(m_dataset.size(), false);
+        std::vector<int>  positions;
+        positions.reserve(rows.size());
+        for(int r: rows)
+        {
+            int s = m_order[r];
+            this->on_item_removed(m_dataset.get(static_cast<size_t>(s)));
+            dead[s] = true;
+            positions.push_back(s);
+        }
+        // From the last range, so that the rows of the others stay valid.
+        // Erased items are still stored until all rows are gone.
+        for(auto it = ranges.rbegin(); it != ranges.rend(); ++it)
+        {
+            if(!reset) { this->beginRemoveRows(QModelIndex(), it->first, it->second); }
+            m_order.erase(m_order.begin() + it->first, m_order.begin() + it->second + 1);
+            if(!reset) { this->endRemoveRows(); }
+        }
+
+        // Compact the dataset in a single pass, items are erased from
+        // arbitrary places when the model is sorted.
+        std::sort(positions.begin(), positions.end());
+        std::vector<int> remap(m_dataset.size(), -1);
+        for(int i = 0, j = 0; i < static_cast<int>(dead.size()); i++)
+        {
+            if(!dead[i]){ remap[i] = j++; }
+        }
+        m_dataset.erase_marked(dead);
+        erase_marked(m_ids, dead);
+        for(auto& keys: m_sort_keys){ erase_marked(keys.second, dead); }
+        if(m_rank) { erase_marked(m_rank_keys, dead); }
+        if(m_has_manual) { erase_marked(m_manual_keys, dead); }
+        if(m_filtered) { erase_marked(m_hidden, dead); }
+        for(auto& s: m_order){ s = remap[s]; }
+        for(auto obs: m_observers){ obs->items_removed(positions); }
+
+        if(reset) { this->endResetModel(); }
+    }
+
     /// Remove item N or row N
     void remove_item(int n)
     {
-        if(n > m_dataset.size()){ return; }
-        this->beginRemoveRows(QModelIndex(), n, n);
-        m_dataset.erase(m_dataset.begin() + n);
-        this->endRemoveRows();
+        if(n < 0 || n >= this->count()){ return; }
+        this->remove_items({n});
     }
 
+    /// Number of rows of the view. In lazy mode, only the fetched rows.
     int count() const
     {
-        return m_dataset.size();
+        if(m_source) { return m_fetched; }
+        return static_cast<int>(m_order.size());
+    }
+
+    /// Return the item displayed at the row N of the view, a copy when the
+    /// storage rebuilds items, see modify().
+    typename TStorage::reference at(int n)
+    {
+        this->materialize();
+        return m_dataset.get(static_cast<size_t>(m_order.at(n)));
+    }
+
+    /** Change the item displayed at the row N of the view in place, func
+     *  takes the item by reference. Views are not notified, refresh_rows()
+     *  must be called once the changes are done.
+     */
+    template<typename Func>
+    decltype(auto) modify(int n, Func&& func)
+    {
+        this->materialize();
+        return m_dataset.modify(static_cast<size_t>(m_order.at(n)), std::forward<Func>(func));
+    }
+
+    /// Return the item at a position in insertion order, see begin().
+    typename TStorage::const_reference item(int position) const
+    {
+        if(m_source) { return this->cached_item(position); }
+        return m_dataset.get(static_cast<size_t>(position));
+    }
+
+    /// Position in insertion order of the item displayed at the row N.
+    int position(int n) const
+    {
+        if(m_source) { return n; }
+        return m_order.at(n);
+    }
+
+    /// Identifier of the item displayed at the row N. It is unique during
+    /// the life of the model, and does not change when rows are sorted,
+    /// moved, filtered or when other items are removed.
+    quint64 id(int n) const
+    {
+        return this->id_at(this->position(n));
+    }
+
+    /// Position in insertion order of the item with an identifier, -1 if
+    /// it was removed. Identifiers increase with positions, they are found
+    /// by binary search.
+    int position_of_id(quint64 id) const
+    {
+        if(m_source)
+        {
+            auto n = static_cast<quint64>(m_source->size());
+            if(id < m_source_first_id || id >= m_source_first_id + n) { return -1; }
+            auto s = static_cast<int>(id - m_source_first_id);
+            auto it = std::lower_bound(m_removed.begin(), m_removed.end(), s);
+            if(it != m_removed.end() && *it == s) { return -1; }
+            return s - static_cast<int>(it - m_removed.begin());
+        }
+        auto it = std::lower_bound(m_ids.begin(), m_ids.end(), id);
+        if(it == m_ids.end() || *it != id) { return -1; }
+        return static_cast<int>(it - m_ids.begin());
+    }
+
+    /** Move rows to the row dest of the view, before the row displayed
+     *  there, keeping their relative order. The rows need not be
+     *  contiguous. Only the row permutation is changed, it is kept as the
+     *  sort order of the view (see is_manual_order()), until sort() is
+     *  called. A contiguous block fires a single rowsMoved signal, other
+     *  selections a single layout change. Observers are told which keys
+     *  changed, see manual_order().
+     *
+     *  Note: The moved rows get keys between the ones of their new
+     *  neighbours, in O(k) for k rows, the other keys do not change. The
+     *  permutation itself is a vector indexed by data() on every paint, so
+     *  it is spliced in O(n) (a rotation for a block) instead of being
+     *  kept in an order-statistic tree, which would make each row lookup
+     *  O(log n).
+     */
+    bool move_rows(std::vector<int> rows, int dest)
+    {
+        int n = this->count();
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+        if(rows.empty() || rows.front() < 0 || rows.back() >= n || dest < 0 || dest > n)
+            return false;
+        int first = rows.front(), last = rows.back();
+        bool contiguous = last - first + 1 == static_cast<int>(rows.size());
+        // Moving a block next to itself does not change anything.
+        if(contiguous && dest >= first && dest <= last + 1) { return false; }
+        this->materialize();
+        // Every key is assigned when the order starts from another one
+        bool renumbered = !m_manual;
+        this->start_manual_order();
+
+        auto is_moved = [&](int r){ return std::binary_search(rows.begin(), rows.end(), r); };
+        int before = dest - 1;
+        while(before >= 0 && is_moved(before)) { --before; }
+        int after = dest;
+        while(after < n && is_moved(after)) { ++after; }
+        if(!this->place_rows(rows, before, after))
+        {
+            // Keys too close to each other for the doubles: spread them.
+            this->renumber_manual_order();
+            this->place_rows(rows, before, after);
+            renumbered = true;
+        }
+        std::vector<int> changed;
+        if(!renumbered) { for(int r: rows){ changed.push_back(m_order[r]); } }
+
+        if(!contiguous || !this->beginMoveRows(QModelIndex(), first, last, QModelIndex(), dest))
+        {
+            // The keys place the rows there, the permutation is spliced
+            // instead of sorted again.
+            this->change_layout([&]
+            {
+                std::vector<bool> moved(static_cast<size_t>(n), false);
+                for(int r: rows){ moved[static_cast<size_t>(r)] = true; }
+                std::vector<int> order;
+                order.reserve(m_order.size());
+                for(int r = 0; r < dest; r++){ if(!moved[r]) { order.push_back(m_order[r]); } }
+                for(int r: rows){ order.push_back(m_order[r]); }
+                for(int r = dest; r < n; r++){ if(!moved[r]) { order.push_back(m_order[r]); } }
+                m_order.swap(order);
+            });
+        }
+        else
+        {
+            if(dest > last) { std::rotate(m_order.begin() + first, m_order.begin() + last + 1, m_order.begin() + dest); }
+            else            { std::rotate(m_order.begin() + dest, m_order.begin() + first, m_order.begin() + last + 1); }
+            this->endMoveRows();
+        }
+        for(auto obs: m_observers){ obs->order_changed(changed); }
+        return true;
+    }
+
+    /// True if the view displays the order set by move_rows().
+    bool is_manual_order() const
+    {
+        return m_manual;
+    }
+
+    /// Keys of the order set by move_rows(), indexed by position, lower
+    /// keys come first. Empty if the rows were never moved.
+    std::vector<double> const& manual_order() const
+    {
+        return m_manual_keys;
+    }
+
+    /** Display the order of keys saved from manual_order(), such as
+     *  the one of a previous session. The items are decoded. Return false
+     *  if there is not one key per item.
+     */
+    bool set_manual_order(std::vector<double> keys)
+    {
+        if(static_cast<int>(keys.size()) != this->item_count()) { return false; }
+        this->materialize();
+        m_manual_keys = std::move(keys);
+        m_manual_end  = 0;
+        for(double k: m_manual_keys){ m_manual_end = std::max(m_manual_end, k + 1); }
+        m_has_manual  = true;
+        m_manual      = true;
+        m_sort_column = -1;
+        m_rank        = nullptr;
+        m_rank_keys.clear();
+        this->sort_order();
+        return true;
+    }
+
+    /// Change the key of a single item of the manual order, as reported
+    /// by order_changed(). Ignored if there is no manual order.
+    void set_manual_key(int position, double key)
+    {
+        if(!m_has_manual || position < 0 || position >= this->item_count()) { return; }
+        m_manual_keys[static_cast<size_t>(position)] = key;
+        m_manual_end = std::max(m_manual_end, key + 1);
+        if(m_manual) { this->sort_order(); }
     }
 
-    TItem& at(int n)
+    /// Items in insertion order, for scanning the columns of a
+    /// ColumnStorage. It does not see the items of an attached source.
+    TStorage const& storage() const
     {
-        return m_dataset.at(n);
+        return m_dataset;
     }
 
-    // Return begin iterator
-    auto begin() { return m_dataset.begin(); }
-    auto end()   { return m_dataset.end();   }
+    // Iterators over the items in insertion order, regardless of the
+    // order currently displayed by the view.
+    auto begin() { this->materialize(); return m_dataset.begin(); }
+    auto end()   { this->materialize(); return m_dataset.end();   }
 
+    // Note: The constant iterators do not see the items of an attached
+    // source, see materialize().
     auto begin() const { return m_dataset.begin(); }
     auto end()   const  { return m_dataset.end();   }
 
 
     void clear()
     {
-        int n = static_cast<int>(m_dataset.size());
+        int n = this->count();
+        if(n == 0) { return; }
         this->beginRemoveRows(QModelIndex(), 0, n - 1);
+        for(auto const& item: m_dataset){ this->on_item_removed(item); }
         m_dataset.clear();
+        this->detach();
+        m_order.clear();
+        m_hidden.clear();
+        m_ids.clear();
+        for(auto& keys: m_sort_keys){ keys.second.clear(); }
+        m_rank_keys.clear();
+        this->clear_manual_order();
+        for(auto obs: m_observers){ obs->items_reset(); }
         this->endRemoveRows();
     }
 
+    /// Row of the view displaying the item at a position in insertion
+    /// order, -1 if it is hidden by the row filter.
+    int row_of(int position) const
+    {
+        if(m_source) { return position >= 0 && position < m_fetched ? position : -1; }
+        int n = this->count();
+        // Unsorted and unfiltered: rows are positions.
+        if(position >= 0 && position < n && m_order[position] == position) { return position; }
+        auto it = std::find(m_order.begin(), m_order.end(), position);
+        return it == m_order.end() ? -1 : static_cast<int>(it - m_order.begin());
+    }
+
+    /// Number of items, including the ones hidden by the row filter.
+    int item_count() const
+    {
+        if(m_source) { return this->source_size(); }
+        return static_cast<int>(m_dataset.size());
+    }
+
+    /** Show only the items at the given positions, in insertion order (see
+     *  begin()), keeping the current sort order. Items added afterwards are
+     *  shown until the filter is changed.
+     */
+    void set_row_filter(std::vector<int> const& positions)
+    {
+        this->materialize();
+        this->beginResetModel();
+        m_filtered = true;
+        m_hidden.assign(m_dataset.size(), true);
+        for(int s: positions)
+        {
+            if(s >= 0 && s < static_cast<int>(m_hidden.size())) { m_hidden[s] = false; }
+        }
+        this->sort_indices();
+        this->endResetModel();
+    }
+
+    /// Show all items again.
+    void clear_row_filter()
+    {
+        if(!m_filtered) { return; }
+        this->beginResetModel();
+        m_filtered = false;
+        m_hidden.clear();
+        this->sort_indices();
+        this->endResetModel();
+    }
+
+    bool is_filtered() const
+    {
+        return m_filtered;
+    }
+
+    /// Register an object notified of every change of the items. The
+    /// observer is not owned by the model.
+    void add_observer(RecordObserver<TItem>* observer)
+    {
+        m_observers.push_back(observer);
+    }
+
+    void remove_observer(RecordObserver<TItem>* observer)
+    {
+        m_observers.erase(std::remove(m_observers.begin(), m_observers.end(), observer),
+                          m_observers.end());
+    }
+
     //========= Necessary Member Functions for Redendering the Model =======//
 
     // Header:
@@ -133,7 +813,7 @@ public:
     int rowCount(const QModelIndex &parent = QModelIndex()) const override
     {
         Q_UNUSED(parent)
-        return static_cast<int>(m_dataset.size());
+        return this->count();
     }
 
     int columnCount(const QModelIndex &parent = QModelIndex()) const override
@@ -148,13 +828,37 @@ public:
         if (!index.isValid())
             return QVariant();
 
-        if(role == Qt::DisplayRole || role == Qt::EditRole)
+        static auto& latency = qxstl::metrics::histogram(
+            "qxstl_model_data_seconds", "Time of RecordTableModel::data()");
+        qxstl::metrics::ScopedTimer timer{latency};
+
+        auto display = [&](TItem const& item) -> QVariant
         {
-            auto& item = m_dataset.at( static_cast<size_t>(index.row()) );
-            return  this->display_item_row(item, index.column());
-        }
-        // FIXME: Implement me!
-        return QVariant();
+            if(role == Qt::DisplayRole || role == Qt::EditRole)
+            {
+                return  this->display_item_row(item, index.column());
+            }
+            return this->display_item_role(item, index.column(), role);
+        };
+        // Only rows painted by the view are decoded.
+        if(m_source) { return display(this->cached_item(index.row())); }
+        return display(m_dataset.get(static_cast<size_t>(m_order.at(index.row()))));
+    }
+
+    bool canFetchMore(const QModelIndex &parent) const override
+    {
+        if(parent.isValid() || !m_source) { return false; }
+        return m_fetched < this->source_size();
+    }
+
+    /// Expose the next page of rows of the attached source.
+    void fetchMore(const QModelIndex &parent) override
+    {
+        if(!this->canFetchMore(parent)) { return; }
+        int last = std::min(m_fetched + m_fetch_page_size, this->source_size()) - 1;
+        this->beginInsertRows(QModelIndex(), m_fetched, last);
+        m_fetched = last + 1;
+        this->endInsertRows();
     }
 
     /** QT Docs: The base class implementation returns a combination of flags that
@@ -164,15 +868,19 @@ public:
     flags(const QModelIndex &index) const override
     {
         // return  Qt::ItemIsEnabled;
+        // Rows can be dropped between rows, or on a row for inserting
+        // them before it, see dropMimeData().
         if (!index.isValid())
-            return Qt::ItemIsEnabled;
+            return Qt::ItemIsEnabled | Qt::ItemIsDropEnabled;
+
+        auto drag = Qt::ItemIsDragEnabled | Qt::ItemIsDropEnabled;
 
         // Make column read-only by the user if it is not editable.
         if(!this->is_column_editable(index.column()))
-            return QAbstractTableModel::flags(index) & ~Qt::ItemIsEditable;
+            return (QAbstractTableModel::flags(index) | drag) & ~Qt::ItemIsEditable;
 
         // All columns are editable
-        return QAbstractTableModel::flags(index)
+        return QAbstractTableModel::flags(index) | drag
                | Qt::ItemIsEnabled | Qt::ItemIsSelectable
                | Qt::ItemIsUserCheckable |  Qt::ItemIsEditable;
         // return QAbstractTableModel::flags(index) | Qt::ItemIsEditable | Qt::ItemIsSelectable | Qt::ItemIsSelectable;
@@ -193,20 +901,685 @@ public:
     setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole) override
     {
         if(!index.isValid() && role != Qt::EditRole) { return false; }
+        if(m_source) { return this->set_item_data(index.row(), index.column(), value); }
         int row = index.row();
         int col = index.column();
-        TItem& item = m_dataset[row];
-        if(set_element(col, value, item))
+        bool changed = m_dataset.modify(static_cast<size_t>(m_order.at(row)),
+                                        [&](TItem& item){ return this->set_element(col, value, item); });
+        if(changed)
         {
-            emit this->dataChanged(index, index);
+            this->refresh_row(row);
             return true;
         }
         return false;
     }
 
+    /** Move count rows from sourceRow before the row destinationChild, see
+     *  move_rows().
+     *
+     * QT Docs: On models that support this, moves count rows starting with
+     * the given sourceRow under parent sourceParent to row destinationChild
+     * under parent destinationParent.
+     ***********************************************************************/
+    bool moveRows(  const QModelIndex &sourceParent, int sourceRow, int count
+                  , const QModelIndex &destinationParent, int destinationChild) override
+    {
+        if(sourceParent.isValid() || destinationParent.isValid() || count <= 0) { return false; }
+        std::vector<int> rows(static_cast<size_t>(count));
+        std::iota(rows.begin(), rows.end(), sourceRow);
+        return this->move_rows(std::move(rows), destinationChild);
+    }
+
+    //========= Drag and drop of rows within the view ======================//
+
+    /// MIME type of dragged rows, identifiers of the items of this model.
+    static QString rows_mime_type()
+    {
+        return QStringLiteral("application/x-qxstl-record-ids");
+    }
+
+    QStringList mimeTypes() const override
+    {
+        return { rows_mime_type() };
+    }
+
+    /// Rows are dragged by identifier, which stay valid if the model
+    /// changes during the drag.
+    QMimeData* mimeData(const QModelIndexList &indexes) const override
+    {
+        std::vector<int> rows;
+        for(auto const& index: indexes){ if(index.isValid()) { rows.push_back(index.row()); } }
+        std::sort(rows.begin(), rows.end());
+        rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+
+        QByteArray arr;
+        QDataStream ss{&arr, QIODevice::WriteOnly};
+        // Rows of another model are not accepted
+        ss << static_cast<quint64>(reinterpret_cast<quintptr>(this));
+        ss << static_cast<quint32>(rows.size());
+        for(int r: rows){ ss << this->id(r); }
+
+        auto data = new QMimeData;
+        data->setData(rows_mime_type(), arr);
+        return data;
+    }
+
+    Qt::DropActions supportedDropActions() const override
+    {
+        return Qt::MoveAction;
+    }
+
+    /** Move the dragged rows before the row where they are dropped, at the
+     *  end when they are dropped below the last row.
+     *
+     *  Note: After a move, the view calls removeRows() for the dragged
+     *  rows, which is not implemented, so items are only moved.
+     ***********************************************************************/
+    bool dropMimeData(  const QMimeData *data, Qt::DropAction action
+                      , int row, int column, const QModelIndex &parent) override
+    {
+        Q_UNUSED(column)
+        if(action == Qt::IgnoreAction) { return true; }
+        if(action != Qt::MoveAction || !data->hasFormat(rows_mime_type())) { return false; }
+
+        QByteArray arr = data->data(rows_mime_type());
+        QDataStream ss{&arr, QIODevice::ReadOnly};
+        quint64 owner = 0;
+        quint32 size  = 0;
+        ss >> owner >> size;
+        if(owner != static_cast<quint64>(reinterpret_cast<quintptr>(this))) { return false; }
+
+        this->materialize();
+        // Rows displaying each position, -1 for hidden items
+        std::vector<int> rows_of(m_dataset.size(), -1);
+        for(int r = 0; r < static_cast<int>(m_order.size()); r++){ rows_of[m_order[r]] = r; }
+        std::vector<int> rows;
+        for(quint32 k = 0; k < size && !ss.atEnd(); k++)
+        {
+            quint64 id = 0;
+            ss >> id;
+            int s = this->position_of_id(id);
+            if(s >= 0 && rows_of[s] >= 0) { rows.push_back(rows_of[s]); }
+        }
+        int dest = row >= 0 ? row : parent.isValid() ? parent.row() : this->count();
+        return this->move_rows(std::move(rows), dest);
+    }
+
+    /** Sort the view by a column. A negative column restores the insertion
+     *  order. Only the row permutation is changed, items are not moved.
+     *
+     * QT Docs: Sorts the model by column in the given order.
+     ***********************************************************************/
+    void sort(int column, Qt::SortOrder order = Qt::AscendingOrder) override
+    {
+        if(column >= this->column_count()) { return; }
+        if(column >= 0 && !this->is_column_sortable(column)) { return; }
+        m_sort_column = column;
+        m_sort_order  = order;
+        m_rank        = nullptr;
+        m_rank_keys.clear();
+        // The order set by the user replaces the insertion order.
+        m_manual      = column < 0 && m_has_manual;
+        // Rows of a source are already in insertion order.
+        if(column < 0 && m_source) { return; }
+        this->materialize();
+
+        if(column >= 0 && m_sort_keys.count(column) == 0)
+        {
+            auto& keys = m_sort_keys[column];
+            for(auto const& item: m_dataset)
+                keys.push_back(m_collator.sortKey(this->display_item_row(item, column)));
+        }
+        this->sort_order();
+    }
+
+    /** Sort the view by a score of the items, highest first, such as how
+     *  often they are used. Ties keep the insertion order. Scores are
+     *  computed once per item, and again when refresh_rows() is called.
+     *  Sorting by a column with sort() drops the rank.
+     */
+    void sort_by_rank(std::function<double (TItem const&)> rank)
+    {
+        m_sort_column = -1;
+        m_rank        = std::move(rank);
+        m_manual      = false;
+        this->materialize();
+        m_rank_keys.clear();
+        for(auto const& item: m_dataset){ m_rank_keys.push_back(m_rank(item)); }
+        this->sort_order();
+    }
+
+    /// True if the view is sorted by sort_by_rank()
+    bool is_ranked() const
+    {
+        return static_cast<bool>(m_rank);
+    }
+
+    /// Column the view is sorted by, -1 for insertion order or a rank.
+    int sort_column() const
+    {
+        return m_sort_column;
+    }
+
+    /// Notify views that all columns of the row N have changed.
+    void refresh_row(int n)
+    {
+        this->refresh_rows({n});
+    }
+
+    /** Notify views that items at the given rows were modified in place.
+     *  Collation keys are updated and the rows whose sort key changed
+     *  are moved to their new place.
+     */
+    void refresh_rows(std::vector<int> const& rows)
+    {
+        if(rows.empty()) { return; }
+        std::vector<int> moved;
+        for(int row: rows)
+        {
+            int s = m_order.at(row);
+            if(this->update_keys(s)) { moved.push_back(s); }
+        }
+        auto range = std::minmax_element(rows.begin(), rows.end());
+        emit this->dataChanged(this->index(*range.first, 0),
+                               this->index(*range.second, this->column_count() - 1));
+
+        // A single row is moved by binary search, which needs all other
+        // rows in their place. Several changed rows are sorted together.
+        moved.erase(std::unique(moved.begin(), moved.end()), moved.end());
+        if(moved.size() == 1) { this->reposition(moved.front()); }
+        else if(moved.size() > 1) { this->sort_order(); }
+    }
+
+    /// Change the item at a position in insertion order, which may be
+    /// hidden by the row filter. See modify() and refresh_items().
+    template<typename Func>
+    decltype(auto) modify_item(int position, Func&& func)
+    {
+        if(m_source)
+        {
+            // Only this item is decoded, see source().
+            int s = this->base_position(position);
+            auto it = m_patched.find(s);
+            if(it == m_patched.end())
+            {
+                it = m_patched.emplace(s, this->cached_item(position)).first;
+                this->uncache(s);
+            }
+            m_patched_source.reset();
+            return std::forward<Func>(func)(it->second);
+        }
+        return m_dataset.modify(static_cast<size_t>(position), std::forward<Func>(func));
+    }
+
+    /// Change a column of the item at a position in insertion order, like
+    /// setData(). Return false if the item did not change.
+    bool set_item_data(int position, int column, QVariant const& value)
+    {
+        if(position < 0 || position >= this->item_count()) { return false; }
+        bool changed = this->modify_item(position, [&](TItem& item)
+                                         {
+                                             return this->set_element(column, value, item);
+                                         });
+        if(changed) { this->refresh_items({position}); }
+        return changed;
+    }
+
+    /// Remove the item at a position in insertion order. Items of a source
+    /// are removed without decoding the others. Ignored if the item is
+    /// hidden by the row filter.
+    void remove_item_at(int position)
+    {
+        if(position < 0 || position >= this->item_count()) { return; }
+        if(m_source) { this->remove_source_items({position}); return; }
+        int row = this->row_of(position);
+        if(row >= 0) { this->remove_items({row}); }
+    }
+
+    /// Like refresh_rows(), for items at positions in insertion order,
+    /// including the ones hidden by the row filter.
+    void refresh_items(std::vector<int> const& positions)
+    {
+        if(positions.empty()) { return; }
+        if(m_source)
+        {
+            // Rows of a source are positions, only the fetched ones are
+            // displayed.
+            std::vector<int> rows;
+            for(int s: positions)
+            {
+                for(auto obs: m_observers){ obs->item_updated(s, this->cached_item(s)); }
+                if(s < m_fetched) { rows.push_back(s); }
+            }
+            if(rows.empty()) { return; }
+            auto range = std::minmax_element(rows.begin(), rows.end());
+            emit this->dataChanged(this->index(*range.first, 0),
+                                   this->index(*range.second, this->column_count() - 1));
+            return;
+        }
+        std::vector<int> rows_of(m_dataset.size(), -1);
+        for(int r = 0; r < static_cast<int>(m_order.size()); r++){ rows_of[m_order[r]] = r; }
+        std::vector<int> rows;
+        for(int s: positions)
+        {
+            if(rows_of[s] >= 0) { rows.push_back(rows_of[s]); }
+            // Not displayed: only the keys and the observers are updated.
+            else                { this->update_keys(s); }
+        }
+        this->refresh_rows(rows);
+    }
+
+protected:
+
+    // Called before an item is stored in the model, derived classes can
+    // override it for computing cached data from the item.
+    virtual void on_item_added(TItem& item)
+    {
+        Q_UNUSED(item)
+    }
+
+    // Called before an item is erased from the model.
+    virtual void on_item_removed(TItem const& item)
+    {
+        Q_UNUSED(item)
+    }
 
 private:
-    std::deque<TItem>         m_dataset;
+    TStorage                  m_dataset;
+    // Maps each row of the view to a position of m_dataset
+    std::vector<int>          m_order;
+    // Collation keys of each column already sorted, indexed like m_dataset
+    std::map<int, std::deque<QCollatorSortKey>> m_sort_keys;
+    // Scores of sort_by_rank(), indexed like m_dataset
+    std::function<double (TItem const&)> m_rank;
+    std::deque<double>        m_rank_keys;
+    // Order set by move_rows(), items are sorted by ascending keys, which
+    // are indexed like m_dataset. All keys are below m_manual_end. The keys
+    // are kept while the view is sorted otherwise, m_manual is set while
+    // the view displays them.
+    bool                      m_has_manual  = false;
+    bool                      m_manual      = false;
+    std::vector<double>       m_manual_keys;
+    double                    m_manual_end  = 0;
+    // Identifiers of the items, indexed like m_dataset, see id()
+    std::vector<quint64>      m_ids;
+    quint64                   m_next_id          = 1;
+    // Identifier of the first item of the source, the following ones
+    // are consecutive.
+    quint64                   m_source_first_id  = 0;
+    QCollator                 m_collator;
+    int                       m_sort_column = -1;
+    Qt::SortOrder             m_sort_order  = Qt::AscendingOrder;
+    // Row filter, items hidden from the view are flagged, indexed like m_dataset
+    bool                      m_filtered = false;
+    std::vector<bool>         m_hidden;
+    std::vector<RecordObserver<TItem>*> m_observers;
+    // Items not decoded yet, see attach()
+    std::shared_ptr<RecordSource<TItem> const> m_source;
+    // Rows of the source exposed to views
+    int                       m_fetched         = 0;
+    int                       m_fetch_page_size = 256;
+    // Decoded items of the source, most recently used first
+    int                       m_cache_capacity  = 1024;
+    mutable std::list<std::pair<int, TItem>> m_cache;
+    mutable std::unordered_map<int, typename std::list<std::pair<int, TItem>>::iterator> m_cache_index;
+    // Items of the source changed or removed without decoding the others,
+    // by position in the source. Removed positions are sorted.
+    std::unordered_map<int, TItem> m_patched;
+    std::vector<int>          m_removed;
+    // Copy of the changes returned by source(), reset when they change
+    mutable std::shared_ptr<RecordSource<TItem> const> m_patched_source;
+
+    quint64 id_at(int s) const
+    {
+        if(m_source) { return m_source_first_id + static_cast<quint64>(this->base_position(s)); }
+        return m_ids.at(static_cast<size_t>(s));
+    }
+
+    // Number of items of the source that were not removed
+    int source_size() const
+    {
+        return m_source->size() - static_cast<int>(m_removed.size());
+    }
+
+    // Position in the source of the item at a position of the model
+    int base_position(int position) const
+    {
+        return PatchedSource<TItem>::base_position(m_removed, position);
+    }
+
+    void clear_patches()
+    {
+        m_patched.clear();
+        m_removed.clear();
+        m_patched_source.reset();
+    }
+
+    // Drop an item of the source from the cache, by position in the source.
+    void uncache(int s)
+    {
+        auto it = m_cache_index.find(s);
+        if(it == m_cache_index.end()) { return; }
+        m_cache.erase(it->second);
+        m_cache_index.erase(it);
+    }
+
+    // Remove items of the source, positions are sorted and valid. Rows are
+    // positions, contiguous rows are removed at once, from the last ones
+    // so that the rows before keep their place.
+    void remove_source_items(std::vector<int> const& positions)
+    {
+        std::vector<int> bases;
+        bases.reserve(positions.size());
+        for(int p: positions){ bases.push_back(this->base_position(p)); }
+        size_t end = positions.size();
+        while(end > 0)
+        {
+            size_t begin = end - 1;
+            while(begin > 0 && positions[begin - 1] + 1 == positions[begin]) { --begin; }
+            int first = positions[begin];
+            int last  = std::min(positions[end - 1], m_fetched - 1);
+            bool shown = first <= last;
+            if(shown) { this->beginRemoveRows(QModelIndex(), first, last); }
+            for(size_t k = begin; k < end; k++)
+            {
+                m_removed.insert(std::lower_bound(m_removed.begin(), m_removed.end(), bases[k]),
+                                 bases[k]);
+                m_patched.erase(bases[k]);
+                this->uncache(bases[k]);
+            }
+            if(shown)
+            {
+                m_fetched -= last - first + 1;
+                this->endRemoveRows();
+            }
+            end = begin;
+        }
+        m_patched_source.reset();
+        for(auto obs: m_observers){ obs->items_removed(positions); }
+    }
+
+    void clear_manual_order()
+    {
+        m_has_manual = false;
+        m_manual     = false;
+        m_manual_keys.clear();
+        m_manual_end = 0;
+    }
+
+    // Keys of the manual order from the order currently displayed,
+    // including the items hidden by the filter.
+    void start_manual_order()
+    {
+        if(m_manual) { return; }
+        std::vector<int> all(m_dataset.size());
+        std::iota(all.begin(), all.end(), 0);
+        if(this->is_sorted())
+            std::sort(all.begin(), all.end(), [this](int a, int b){ return this->row_less(a, b); });
+        m_manual_keys.assign(all.size(), 0);
+        for(size_t i = 0; i < all.size(); i++){ m_manual_keys[all[i]] = static_cast<double>(i); }
+        m_manual_end  = static_cast<double>(all.size());
+        m_sort_column = -1;
+        m_rank        = nullptr;
+        m_rank_keys.clear();
+        m_has_manual  = true;
+        m_manual      = true;
+    }
+
+    // Keys 0, 1, 2 ... keeping the manual order.
+    void renumber_manual_order()
+    {
+        std::vector<int> all(m_dataset.size());
+        std::iota(all.begin(), all.end(), 0);
+        std::sort(all.begin(), all.end(), [this](int a, int b){ return this->row_less(a, b); });
+        for(size_t i = 0; i < all.size(); i++){ m_manual_keys[all[i]] = static_cast<double>(i); }
+        m_manual_end = static_cast<double>(all.size());
+    }
+
+    // Give the items at the given rows keys between the keys of the rows
+    // before and after, which may be out of the view. Return false if the
+    // keys cannot be told apart.
+    bool place_rows(std::vector<int> const& rows, int before, int after)
+    {
+        auto count = static_cast<double>(rows.size());
+        int  n     = static_cast<int>(m_order.size());
+        double hi = after < n ? m_manual_keys[m_order[after]] : m_manual_end + count;
+        double lo = before >= 0 ? m_manual_keys[m_order[before]] : hi - count - 1;
+        double step = (hi - lo) / (count + 1);
+        if(!(lo + step > lo) || !(lo + step * count < hi)) { return false; }
+        for(size_t k = 0; k < rows.size(); k++)
+            m_manual_keys[m_order[rows[k]]] = lo + step * static_cast<double>(k + 1);
+        m_manual_end = std::max(m_manual_end, hi + 1);
+        return true;
+    }
+
+    // Drop the source without decoding it
+    void detach()
+    {
+        m_source.reset();
+        this->clear_patches();
+        m_fetched = 0;
+        m_cache.clear();
+        m_cache_index.clear();
+    }
+
+    // Decode an item of the source through the cache.
+    TItem const& cached_item(int position) const
+    {
+        int s = this->base_position(position);
+        auto patched = m_patched.find(s);
+        if(patched != m_patched.end()) { return patched->second; }
+        auto it = m_cache_index.find(s);
+        if(it != m_cache_index.end())
+        {
+            m_cache.splice(m_cache.begin(), m_cache, it->second);
+            return it->second->second;
+        }
+        m_cache.emplace_front(s, m_source->item(s));
+        m_cache_index[s] = m_cache.begin();
+        this->trim_cache();
+        return m_cache.front().second;
+    }
+
+    void trim_cache() const
+    {
+        while(static_cast<int>(m_cache.size()) > m_cache_capacity)
+        {
+            m_cache_index.erase(m_cache.back().first);
+            m_cache.pop_back();
+        }
+    }
+
+    // Move all items of the source into the model, without notifying views.
+    void decode_all()
+    {
+        auto source = std::move(m_source);
+        int n = source->size();
+        auto removed = m_removed.begin();
+        int p = 0;
+        for(int s = 0; s < n; s++)
+        {
+            if(removed != m_removed.end() && *removed == s) { ++removed; continue; }
+            auto patched = m_patched.find(s);
+            auto it      = m_cache_index.find(s);
+            TItem item = patched != m_patched.end() ? std::move(patched->second)
+                       : it != m_cache_index.end()  ? std::move(it->second->second)
+                                                    : source->item(s);
+            this->on_item_added(item);
+            m_dataset.push_back(std::move(item));
+            m_ids.push_back(m_source_first_id + static_cast<quint64>(s));
+            this->append_keys(p);
+            for(auto obs: m_observers){ obs->item_loaded(p, m_dataset.get(static_cast<size_t>(p))); }
+            p++;
+        }
+        m_cache.clear();
+        m_cache_index.clear();
+        this->clear_patches();
+        m_fetched = 0;
+        m_order.resize(static_cast<size_t>(p));
+        std::iota(m_order.begin(), m_order.end(), 0);
+    }
+
+    void init_collator()
+    {
+        // Natural order: "file2" comes before "file10"
+        m_collator.setNumericMode(true);
+        m_collator.setCaseSensitivity(Qt::CaseInsensitive);
+    }
+
+    bool is_sorted() const
+    {
+        return m_sort_column >= 0 || m_rank || m_manual;
+    }
+
+    void notify_inserted(int s)
+    {
+        auto const& item = m_dataset.get(static_cast<size_t>(s));
+        for(auto obs: m_observers){ obs->item_inserted(s, item); }
+    }
+
+    // Recompute the keys of the item at position s of m_dataset after a
+    // change and notify observers. Return true if its sort key changed.
+    bool update_keys(int s)
+    {
+        bool moved = false;
+        auto const& item = m_dataset.get(static_cast<size_t>(s));
+        for(auto& keys: m_sort_keys)
+        {
+            auto key = m_collator.sortKey(this->display_item_row(item, keys.first));
+            if(keys.first == m_sort_column && key.compare(keys.second[s]) != 0) { moved = true; }
+            keys.second[s] = key;
+        }
+        if(m_rank)
+        {
+            double rank = m_rank(item);
+            if(rank != m_rank_keys[s]) { moved = true; }
+            m_rank_keys[s] = rank;
+        }
+        for(auto obs: m_observers){ obs->item_updated(s, item); }
+        return moved;
+    }
+
+    // Compute collation keys for the item at position s of m_dataset
+    void append_keys(int s)
+    {
+        // New items come last in the manual order
+        if(m_has_manual) { m_manual_keys.push_back(m_manual_end); m_manual_end += 1; }
+        if(m_sort_keys.empty() && !m_rank) { return; }
+        auto const& item = m_dataset.get(static_cast<size_t>(s));
+        for(auto& keys: m_sort_keys)
+        {
+            keys.second.push_back(
+                m_collator.sortKey(this->display_item_row(item, keys.first)));
+        }
+        if(m_rank) { m_rank_keys.push_back(m_rank(item)); }
+    }
+
+    // Compare two positions of m_dataset according to the current sort
+    // order, ties are broken by insertion order.
+    bool row_less(int a, int b) const
+    {
+        if(m_manual)
+        {
+            double ka = m_manual_keys[a], kb = m_manual_keys[b];
+            if(ka != kb) { return ka < kb; }
+            return a < b;
+        }
+        if(m_rank)
+        {
+            double ra = m_rank_keys[a], rb = m_rank_keys[b];
+            if(ra != rb) { return ra > rb; }
+            return a < b;
+        }
+        auto const& keys = m_sort_keys.at(m_sort_column);
+        int c = keys[a].compare(keys[b]);
+        if(c != 0) { return m_sort_order == Qt::AscendingOrder ? c < 0 : c > 0; }
+        return a < b;
+    }
+
+    // Row where the item at position s of m_dataset must be inserted.
+    int insert_position(int s) const
+    {
+        if(!this->is_sorted()) { return static_cast<int>(m_order.size()); }
+        auto it = std::lower_bound(m_order.begin(), m_order.end(), s,
+                                   [this](int a, int b){ return this->row_less(a, b); });
+        return static_cast<int>(it - m_order.begin());
+    }
+
+    // Rebuild the row permutation without notifying views.
+    void sort_indices()
+    {
+        m_order.clear();
+        m_order.reserve(m_dataset.size());
+        for(int s = 0; s < static_cast<int>(m_dataset.size()); s++)
+        {
+            if(!m_filtered || !m_hidden[s]) { m_order.push_back(s); }
+        }
+        if(!this->is_sorted()) { return; }
+        std::sort(m_order.begin(), m_order.end(),
+                  [this](int a, int b){ return this->row_less(a, b); });
+    }
+
+    // Rebuild the row permutation keeping selections and current indexes.
+    void sort_order()
+    {
+        this->change_layout([this]{ this->sort_indices(); });
+    }
+
+    // Change the row permutation with func, keeping selections and current
+    // indexes, in a single layout change.
+    template<typename Func>
+    void change_layout(Func&& func)
+    {
+        emit this->layoutAboutToBeChanged({}, QAbstractItemModel::VerticalSortHint);
+
+        QModelIndexList old_list = this->persistentIndexList();
+        std::vector<int> old_positions;
+        old_positions.reserve(old_list.size());
+        for(auto const& idx: old_list){ old_positions.push_back(m_order.at(idx.row())); }
+
+        func();
+
+        // Rows displaying each position, -1 for hidden items
+        std::vector<int> rows(m_dataset.size(), -1);
+        for(int i = 0; i < static_cast<int>(m_order.size()); i++){ rows[m_order[i]] = i; }
+        QModelIndexList new_list;
+        new_list.reserve(old_list.size());
+        for(int k = 0; k < old_list.size(); k++)
+        {
+            int row = rows[old_positions[k]];
+            new_list << (row >= 0 ? this->index(row, old_list[k].column()) : QModelIndex{});
+        }
+        this->changePersistentIndexList(old_list, new_list);
+
+        emit this->layoutChanged({}, QAbstractItemModel::VerticalSortHint);
+    }
+
+    // Move the item at position s of m_dataset to its sorted row.
+    void reposition(int s)
+    {
+        int from = static_cast<int>(std::find(m_order.begin(), m_order.end(), s) - m_order.begin());
+        m_order.erase(m_order.begin() + from);
+        int to = this->insert_position(s);
+        m_order.insert(m_order.begin() + from, s);
+        if(to == from) { return; }
+        // The destination of beginMoveRows refers to rows before the move.
+        int dest = to > from ? to + 1 : to;
+        if(!this->beginMoveRows(QModelIndex(), from, from, QModelIndex(), dest)) { return; }
+        m_order.erase(m_order.begin() + from);
+        m_order.insert(m_order.begin() + to, s);
+        this->endMoveRows();
+    }
+
+    // Erase elements of a container whose positions are marked
+    template<typename Container>
+    static void erase_marked(Container& container, std::vector<bool> const& marked)
+    {
+        size_t k = 0;
+        container.erase(std::remove_if(container.begin(), container.end(),
+                                       [&](auto const&){ return marked[k++]; }),
+                        container.end());
+    }
 
 }; //---- End of class RecordTableModel ---//
 
@@ -0,0 +1,335 @@
+/*  Brief:  Trigram inverted index for substring search
+ *
+ *
+ ************************************************************************/
+
+#ifndef TRIGRAMINDEX_HPP
+#define TRIGRAMINDEX_HPP
+
+#include <algorithm>
+#include <cstring>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+
+#include <QtCore>
+
+namespace qxstl::search
+{
+
+/** Class TrigramIndex maps every sequence of three characters (trigram) of
+ *  a set of documents to the sorted list of documents containing it.
+ *
+ *  A substring query intersects the lists of its trigrams, starting from
+ *  the shortest one, and verifies the remaining candidates. Queries shorter
+ *  than three characters fall back to a linear scan.
+ *
+ *  + Documents are identified by their position, [0, size()). Erasing
+ *    documents shifts the following positions down, like in a vector.
+ *
+ *  + Matching is case-insensitive.
+ *
+ *  + Queries can run concurrently from worker threads, while the index is
+ *    updated from the GUI thread. Long queries poll a cancellation flag.
+ *************************************************************************/
+class TrigramIndex
+{
+public:
+    using DocList    = std::vector<int>;
+    // Return true when the query must be abandoned
+    using CancelFlag = std::function<bool ()>;
+
+    TrigramIndex() = default;
+
+    TrigramIndex(TrigramIndex const&) = delete;
+    TrigramIndex& operator=(TrigramIndex const&) = delete;
+
+    /// Number of documents
+    int size() const
+    {
+        QReadLocker lock{&m_lock};
+        return static_cast<int>(m_texts.size());
+    }
+
+    void clear()
+    {
+        QWriteLocker lock{&m_lock};
+        m_texts.clear();
+        m_postings.clear();
+    }
+
+    /// Append a document, its position is the former size().
+    void append(QString const& text)
+    {
+        QWriteLocker lock{&m_lock};
+        int doc = static_cast<int>(m_texts.size());
+        m_texts.push_back(normalize(text));
+        // The document has the greatest position: lists stay sorted.
+        for(auto key: trigrams(m_texts.back()))
+            m_postings[key].push_back(doc);
+    }
+
+    /// Replace the text of the document at the given position. An
+    /// unchanged text is detected under the read lock, so that it does
+    /// not wait for running queries.
+    void update(int doc, QString const& text)
+    {
+        QString norm = normalize(text);
+        {
+            QReadLocker lock{&m_lock};
+            if(doc < 0 || doc >= static_cast<int>(m_texts.size())) { return; }
+            if(m_texts[doc] == norm) { return; }
+        }
+        auto keys = trigrams(norm);
+
+        QWriteLocker lock{&m_lock};
+        // Changed by another writer meanwhile
+        if(doc >= static_cast<int>(m_texts.size()) || m_texts[doc] == norm) { return; }
+        for(auto key: trigrams(m_texts[doc]))
+        {
+            auto it = m_postings.find(key);
+            if(it == m_postings.end()) { continue; }
+            auto& list = it->second;
+            auto pos = std::lower_bound(list.begin(), list.end(), doc);
+            if(pos != list.end() && *pos == doc) { list.erase(pos); }
+            if(list.empty()) { m_postings.erase(it); }
+        }
+        for(auto key: keys)
+        {
+            auto& list = m_postings[key];
+            auto pos = std::lower_bound(list.begin(), list.end(), doc);
+            if(pos == list.end() || *pos != doc) { list.insert(pos, doc); }
+        }
+        m_texts[doc] = std::move(norm);
+    }
+
+    /// Erase the documents at the given positions in a single pass.
+    void erase(std::vector<int> const& docs)
+    {
+        QWriteLocker lock{&m_lock};
+        int n = static_cast<int>(m_texts.size());
+        std::vector<int> remap(n, 0);
+        for(int d: docs){ if(d >= 0 && d < n) { remap[d] = -1; } }
+        for(int i = 0, j = 0; i < n; i++)
+        {
+            if(remap[i] == 0) { remap[i] = j++; }
+            else              { remap[i] = -1;  }
+        }
+        for(auto it = m_postings.begin(); it != m_postings.end(); )
+        {
+            auto& list = it->second;
+            size_t k = 0;
+            for(int d: list){ if(remap[d] >= 0) { list[k++] = remap[d]; } }
+            list.resize(k);
+            if(list.empty()) { it = m_postings.erase(it); }
+            else             { ++it; }
+        }
+        size_t k = 0;
+        for(int i = 0; i < n; i++)
+        {
+            if(remap[i] >= 0) { m_texts[k++] = std::move(m_texts[i]); }
+        }
+        m_texts.resize(k);
+    }
+
+    /// Return the sorted positions of documents containing the pattern.
+    DocList query(QString const& pattern, CancelFlag const& cancelled) const
+    {
+        QReadLocker lock{&m_lock};
+        QString norm = normalize(pattern);
+        int n = static_cast<int>(m_texts.size());
+        DocList result;
+
+        if(norm.size() < 3)
+        {
+            for(int d = 0; d < n; d++)
+            {
+                if((d & 0xFFF) == 0 && cancelled()) { return {}; }
+                if(m_texts[d].contains(norm)) { result.push_back(d); }
+            }
+            return result;
+        }
+
+        std::vector<DocList const*> lists;
+        for(auto key: trigrams(norm))
+        {
+            auto it = m_postings.find(key);
+            if(it == m_postings.end()) { return {}; }
+            lists.push_back(&it->second);
+        }
+        std::sort(lists.begin(), lists.end(),
+                  [](auto a, auto b){ return a->size() < b->size(); });
+
+        result = *lists.front();
+        DocList tmp;
+        for(size_t i = 1; i < lists.size() && !result.empty(); i++)
+        {
+            if(cancelled()) { return {}; }
+            tmp.clear();
+            std::set_intersection(result.begin(), result.end(),
+                                  lists[i]->begin(), lists[i]->end(),
+                                  std::back_inserter(tmp));
+            std::swap(result, tmp);
+        }
+        // All trigrams present does not imply that they are contiguous.
+        if(norm.size() > 3)
+        {
+            size_t k = 0;
+            for(size_t i = 0; i < result.size(); i++)
+            {
+                if((i & 0xFFF) == 0 && cancelled()) { return {}; }
+                if(m_texts[result[i]].contains(norm)) { result[k++] = result[i]; }
+            }
+            result.resize(k);
+        }
+        return result;
+    }
+
+    /** Save the index to a file. The fingerprint identifies the dataset the
+     *  index was built from, load() rejects the file if it differs.
+     */
+    bool save(QString const& file_name, QByteArray const& fingerprint) const
+    {
+        QReadLocker lock{&m_lock};
+        QSaveFile file(file_name);
+        if(!file.open(QIODevice::WriteOnly)) { return false; }
+        QDataStream ss{&file};
+        ss.setVersion(QDataStream::Qt_5_0);
+        ss << file_magic << file_version << fingerprint << byte_order_mark();
+        ss << static_cast<quint32>(m_texts.size());
+        for(auto const& text: m_texts){ ss << text; }
+        ss << static_cast<quint32>(m_postings.size());
+        for(auto const& entry: m_postings)
+        {
+            ss << static_cast<quint64>(entry.first)
+               << static_cast<quint32>(entry.second.size());
+            // Lists are written in host byte order, see byte_order_mark()
+            ss.writeRawData(reinterpret_cast<const char*>(entry.second.data()),
+                            static_cast<int>(entry.second.size() * sizeof(int)));
+        }
+        return ss.status() == QDataStream::Ok && file.commit();
+    }
+
+    /// Load the index from a file, return false if the file is missing,
+    /// corrupt, or was built from another dataset.
+    bool load(QString const& file_name, QByteArray const& fingerprint)
+    {
+        QWriteLocker lock{&m_lock};
+        m_texts.clear();
+        m_postings.clear();
+
+        QFile file(file_name);
+        if(!file.open(QIODevice::ReadOnly)) { return false; }
+        QDataStream ss{&file};
+        ss.setVersion(QDataStream::Qt_5_0);
+
+        quint32 magic = 0, version = 0, bom = 0, count = 0;
+        QByteArray file_fingerprint;
+        ss >> magic >> version >> file_fingerprint >> bom;
+        if(magic != file_magic || version != file_version
+            || file_fingerprint != fingerprint || bom != byte_order_mark())
+            return false;
+
+        // Every length is checked against the bytes left, so that a corrupt
+        // file cannot make us allocate more than its size.
+        auto fits = [&](quint64 count, quint64 min_bytes)
+        {
+            return count * min_bytes <= static_cast<quint64>(file.bytesAvailable());
+        };
+        bool valid = true;
+        ss >> count;
+        // A string takes at least its 4 bytes length.
+        if(ss.status() != QDataStream::Ok || !fits(count, 4)) { return false; }
+        m_texts.resize(count);
+        for(auto& text: m_texts)
+        {
+            // QDataStream allocates the length read before the characters,
+            // it is checked first. The stream reads the file unbuffered.
+            QByteArray length = file.peek(4);
+            if(length.size() != 4) { valid = false; break; }
+            quint32 nbytes = qFromBigEndian<quint32>(length.constData());
+            if(nbytes != 0xFFFFFFFF && !fits(nbytes + quint64{4}, 1)) { valid = false; break; }
+            ss >> text;
+        }
+        if(valid) { ss >> count; }
+        // A list takes at least its key and its size.
+        if(!valid || ss.status() != QDataStream::Ok || !fits(count, 12)) { valid = false; count = 0; }
+        m_postings.reserve(count);
+        auto ndocs = static_cast<int>(m_texts.size());
+        for(quint32 i = 0; i < count && valid && ss.status() == QDataStream::Ok; i++)
+        {
+            quint64 key = 0;
+            quint32 size = 0;
+            ss >> key >> size;
+            if(ss.status() != QDataStream::Ok || !fits(size, sizeof(int))) { valid = false; break; }
+            auto& list = m_postings[key];
+            list.resize(size);
+            int nbytes = static_cast<int>(size * sizeof(int));
+            if(ss.readRawData(reinterpret_cast<char*>(list.data()), nbytes) != nbytes)
+            {
+                valid = false;
+                break;
+            }
+            // Documents are sorted positions of m_texts, query() relies on it.
+            for(quint32 k = 0; k < size && valid; k++)
+            {
+                int doc = list[k];
+                valid = doc >= 0 && doc < ndocs && (k == 0 || list[k - 1] < doc);
+            }
+        }
+        if(!valid || ss.status() != QDataStream::Ok)
+        {
+            m_texts.clear();
+            m_postings.clear();
+            return false;
+        }
+        return true;
+    }
+
+private:
+    static constexpr quint32 file_magic   = 0x51544758; // "QTGX"
+    static constexpr quint32 file_version = 1;
+
+    mutable QReadWriteLock                  m_lock;
+    // Normalized text of each document
+    std::vector<QString>                    m_texts;
+    std::unordered_map<quint64, DocList>    m_postings;
+
+    static quint32 byte_order_mark()
+    {
+        quint32 mark;
+        const char bytes[] = {1, 2, 3, 4};
+        std::memcpy(&mark, bytes, sizeof(mark));
+        return mark;
+    }
+
+    static QString normalize(QString const& text)
+    {
+        return text.toCaseFolded();
+    }
+
+    // Sorted unique trigrams of a normalized text, three UTF-16 code
+    // units packed in an integer.
+    static std::vector<quint64> trigrams(QString const& text)
+    {
+        std::vector<quint64> keys;
+        int n = text.size();
+        if(n < 3) { return keys; }
+        keys.reserve(static_cast<size_t>(n - 2));
+        const QChar* p = text.constData();
+        for(int i = 0; i + 2 < n; i++)
+        {
+            keys.push_back(  (static_cast<quint64>(p[i].unicode())     << 32)
+                           | (static_cast<quint64>(p[i + 1].unicode()) << 16)
+                           |  static_cast<quint64>(p[i + 2].unicode()));
+        }
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        return keys;
+    }
+
+}; //---- End of class TrigramIndex ---//
+
+}
+
+#endif // TRIGRAMINDEX_HPP
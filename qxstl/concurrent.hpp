@@ -0,0 +1,99 @@
+#ifndef QXSTL_CONCURRENT_HPP
+#define QXSTL_CONCURRENT_HPP
+
+#include <functional>
+#include <memory>
+
+#include <QtCore>
+
+namespace qxstl::concurrent
+{
+
+/// Run a function in a thread pool.
+inline void run(QThreadPool* pool, std::function<void ()> func)
+{
+    class Task: public QRunnable
+    {
+        std::function<void ()> m_func;
+    public:
+        Task(std::function<void ()> func): m_func(std::move(func))
+        { }
+
+        void run() override { m_func(); }
+    };
+    pool->start(new Task(std::move(func)));
+}
+
+/** Class Receiver delivers callbacks posted by worker threads to the thread
+ *  that created the receiver, usually the GUI thread.
+ *
+ *  Workers hold a Sender, which remains safe to use after the receiver is
+ *  destroyed: callbacks posted from then on, or still waiting in the event
+ *  queue, are silently dropped.
+ *
+ *  Example:
+ *
+ *    auto sender = receiver.sender();
+ *    qxstl::concurrent::run(pool, [sender]{
+ *        auto result = compute();
+ *        sender.post([result]{ show(result); });
+ *    });
+ *************************************************************************/
+class Receiver
+{
+    struct State
+    {
+        QMutex   mutex;
+        // Set to null when the receiver is destroyed
+        QObject* context = nullptr;
+    };
+    std::shared_ptr<State> m_state;
+
+public:
+
+    class Sender
+    {
+        std::shared_ptr<State> m_state;
+    public:
+        explicit Sender(std::shared_ptr<State> state): m_state(std::move(state))
+        { }
+
+        /// Thread-safe: queue the function for running on the receiver thread.
+        void post(std::function<void ()> func) const
+        {
+            QMutexLocker lock{&m_state->mutex};
+            if(m_state->context == nullptr) { return; }
+            QMetaObject::invokeMethod(m_state->context, std::move(func),
+                                      Qt::QueuedConnection);
+        }
+    };
+
+    Receiver(): m_state{std::make_shared<State>()}
+    {
+        m_state->context = new QObject;
+    }
+
+    ~Receiver()
+    {
+        QObject* context = nullptr;
+        {
+            QMutexLocker lock{&m_state->mutex};
+            std::swap(context, m_state->context);
+        }
+        // Also discards the callbacks still waiting in the event queue.
+        delete context;
+    }
+
+    Receiver(Receiver const&) = delete;
+    Receiver& operator=(Receiver const&) = delete;
+
+    Sender sender() const { return Sender{m_state}; }
+
+    /// Object living in the receiver thread, it can be used as the context
+    /// of timers and connections that must not outlive the receiver.
+    QObject* context() const { return m_state->context; }
+};
+
+} // --- End of namespace qxstl::concurrent --- //
+
+#endif // QXSTL_CONCURRENT_HPP
@@ -0,0 +1,187 @@
+#ifndef QXSTL_METRICS_HPP
+#define QXSTL_METRICS_HPP
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <QtCore>
+
+/** Counters and latency histograms of hot paths, cheap enough to stay
+ *  enabled in production, exported in the Prometheus text format.
+ *
+ *  Metrics are registered once, usually in a function-local static, and
+ *  updated without locks afterwards:
+ *
+ *    static auto& latency = qxstl::metrics::histogram(
+ *        "app_probe_seconds", "Time of a filesystem probe");
+ *    qxstl::metrics::ScopedTimer timer{latency};
+ */
+namespace qxstl::metrics
+{
+
+/// Monotonic counter
+class Counter
+{
+    std::atomic<quint64> m_value{0};
+public:
+    void    add(quint64 n = 1) { m_value.fetch_add(n, std::memory_order_relaxed); }
+    quint64 value() const      { return m_value.load(std::memory_order_relaxed); }
+};
+
+/** Histogram of durations with power-of-two buckets: bucket i counts the
+ *  durations in (2^(i-1), 2^i] nanoseconds, the last one is unbounded.
+ *  The relative error of a bucket is at most a factor of 2, enough to
+ *  tell microseconds from milliseconds at a fixed cost per sample.
+ */
+class Histogram
+{
+public:
+    static constexpr int buckets = 40;
+
+    void observe_ns(quint64 ns)
+    {
+        int bucket = ns <= 1 ? 0 : 64 - qCountLeadingZeroBits(ns - 1);
+        if(bucket >= buckets) { bucket = buckets - 1; }
+        m_buckets[bucket].fetch_add(1, std::memory_order_relaxed);
+        m_sum_ns.fetch_add(ns, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    quint64 count()  const { return m_count.load(std::memory_order_relaxed);  }
+    quint64 sum_ns() const { return m_sum_ns.load(std::memory_order_relaxed); }
+    quint64 bucket(int i) const { return m_buckets[i].load(std::memory_order_relaxed); }
+
+    /// Upper bound of bucket i in nanoseconds
+    static quint64 upper_bound_ns(int i) { return quint64{1} << i; }
+
+private:
+    std::array<std::atomic<quint64>, buckets> m_buckets{};
+    std::atomic<quint64> m_sum_ns{0};
+    std::atomic<quint64> m_count{0};
+};
+
+/// Records the time from its construction to the end of the scope.
+class ScopedTimer
+{
+    using Clock = std::chrono::steady_clock;
+    Histogram&        m_histogram;
+    Clock::time_point m_start;
+public:
+    explicit ScopedTimer(Histogram& histogram)
+        : m_histogram{histogram}, m_start{Clock::now()}
+    { }
+
+    ~ScopedTimer()
+    {
+        auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            Clock::now() - m_start).count();
+        m_histogram.observe_ns(static_cast<quint64>(ns));
+    }
+
+    ScopedTimer(ScopedTimer const&) = delete;
+    ScopedTimer& operator=(ScopedTimer const&) = delete;
+};
+
+/** Class Registry owns the metrics of the process. Registration takes a
+ *  lock, metrics are never removed so references to them stay valid.
+ */
+class Registry
+{
+    template<typename Metric>
+    struct Entry
+    {
+        QByteArray name;
+        QByteArray help;
+        std::unique_ptr<Metric> metric;
+    };
+
+    mutable std::mutex                m_mutex;
+    std::vector<Entry<Counter>>       m_counters;
+    std::vector<Entry<Histogram>>     m_histograms;
+
+    template<typename Metric>
+    static Metric& find_or_add(std::vector<Entry<Metric>>& entries,
+                               QByteArray const& name, QByteArray const& help)
+    {
+        for(auto& e: entries)
+        {
+            if(e.name == name) { return *e.metric; }
+        }
+        entries.push_back({name, help, std::make_unique<Metric>()});
+        return *entries.back().metric;
+    }
+
+public:
+    static Registry& global()
+    {
+        static Registry registry;
+        return registry;
+    }
+
+    Counter& counter(QByteArray const& name, QByteArray const& help)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return find_or_add(m_counters, name, help);
+    }
+
+    Histogram& histogram(QByteArray const& name, QByteArray const& help)
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        return find_or_add(m_histograms, name, help);
+    }
+
+    /// Prometheus text exposition format, version 0.0.4
+    QByteArray prometheus_text() const
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        QByteArray out;
+        for(auto const& e: m_counters)
+        {
+            out += "# HELP " + e.name + " " + e.help + "\n";
+            out += "# TYPE " + e.name + " counter\n";
+            out += e.name + " " + QByteArray::number(e.metric->value()) + "\n";
+        }
+        for(auto const& e: m_histograms)
+        {
+            Histogram const& h = *e.metric;
+            out += "# HELP " + e.name + " " + e.help + "\n";
+            out += "# TYPE " + e.name + " histogram\n";
+            quint64 cumulative = 0;
+            for(int i = 0; i < Histogram::buckets - 1; i++)
+            {
+                cumulative += h.bucket(i);
+                double le = Histogram::upper_bound_ns(i) / 1.0e9;
+                out += e.name + "_bucket{le=\"" + QByteArray::number(le, 'g', 6) + "\"} "
+                       + QByteArray::number(cumulative) + "\n";
+            }
+            // Samples are recorded concurrently, keep +Inf consistent
+            // with the buckets read above.
+            quint64 count = std::max(h.count(), cumulative + h.bucket(Histogram::buckets - 1));
+            out += e.name + "_bucket{le=\"+Inf\"} " + QByteArray::number(count) + "\n";
+            out += e.name + "_sum " + QByteArray::number(h.sum_ns() / 1.0e9, 'g', 9) + "\n";
+            out += e.name + "_count " + QByteArray::number(count) + "\n";
+        }
+        return out;
+    }
+};
+
+/// Counter of the global registry
+inline Counter& counter(QByteArray const& name, QByteArray const& help)
+{
+    return Registry::global().counter(name, help);
+}
+
+/// Histogram of the global registry
+inline Histogram& histogram(QByteArray const& name, QByteArray const& help)
+{
+    return Registry::global().histogram(name, help);
+}
+
+}
+
+#endif // QXSTL_METRICS_HPP
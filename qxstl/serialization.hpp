@@ -2,11 +2,24 @@
 #define SERIALIZATION_HPP
 
 //--- STL Headers --//
+#include <algorithm>
 #include <memory> // std::unique_ptr, std::shared_ptr
+#include <tuple>
+#include <type_traits>
+#include <vector>
 
 //--- QT Headers ---//
 #include <QtCore>
 
+#ifdef Q_OS_UNIX
+#include <fcntl.h>   // open()
+#include <unistd.h>  // fsync(), close()
+#endif
+
+#ifdef Q_OS_WIN
+#include <io.h>      // _commit()
+#endif
+
 namespace qxstl::serialization
 {
 
@@ -34,6 +47,12 @@ inline void value_reader(int& ref, QVariant value)
     ref = value.toInt();
 }
 
+template<>
+inline void value_reader(qint64& ref, QVariant value)
+{
+    ref = value.toLongLong();
+}
+
 template<>
 inline void value_reader(double& ref, QVariant value)
 {
@@ -124,6 +143,33 @@ public:
     }
 };
 
+/** Sync the content of a QSaveFile to the disk, then atomically replace
+ *  the target file, and sync the directory entry. Throws on failure.
+ */
+inline void commit_save_file(QSaveFile& file)
+{
+    if(!file.flush())
+    {
+        throw std::runtime_error(" [ERROR] Cannot write file.");
+    }
+#if defined(Q_OS_UNIX)
+    ::fsync(file.handle());
+#elif defined(Q_OS_WIN)
+    ::_commit(file.handle());
+#endif
+    if(!file.commit())
+    {
+        throw std::runtime_error(" [ERROR] Cannot replace file: "
+                                 + file.errorString().toStdString());
+    }
+#if defined(Q_OS_UNIX)
+    // Make the rename itself durable
+    QString dir = QFileInfo(file.fileName()).absolutePath();
+    int fd = ::open(QFile::encodeName(dir).constData(), O_RDONLY);
+    if(fd >= 0) { ::fsync(fd); ::close(fd); }
+#endif
+}
+
 struct StreamReader
 {
 private:
@@ -189,6 +235,310 @@ struct FileReader: public StreamReader
     }
 };
 
+//======== Schema mode ========================================//
+//
+// Types declare their fields at compile time, instead of visiting them
+// by name at runtime:
+//
+//   struct Settings
+//   {
+//       QStringList commands;
+//       qint64      generation = 0;
+//
+//       static constexpr auto schema = std::make_tuple(
+//           qxstl::serialization::field(1, &Settings::commands),
+//           qxstl::serialization::field(2, &Settings::generation));
+//   };
+//
+// Fields are written to a single QDataStream in the declaration order,
+// each one preceded by its tag and its size, without QVariant boxing,
+// nested buffers or name lookups. A record is preceded by its size too.
+// Readers skip the fields they do not know and keep the default value of
+// the fields missing from the stream, so that a file written with a newer
+// schema can be read by an older one, and conversely. Tags must never be
+// reused for a different field. A file starts with a header, which
+// distinguishes it from the legacy QMap-based format.
+//
+// Records are encoded in memory before being written, the stream does
+// not need to be seekable.
+
+/// Field of a schema: the tag written to the stream and the member.
+template<typename Class, typename Member>
+struct Field
+{
+    quint16         tag;
+    Member Class::* member;
+};
+
+template<typename Class, typename Member>
+constexpr Field<Class, Member> field(quint16 tag, Member Class::* member)
+{
+    return {tag, member};
+}
+
+template<typename T, typename = void>
+struct has_schema: std::false_type {};
+
+template<typename T>
+struct has_schema<T, std::void_t<decltype(T::schema)>>: std::true_type {};
+
+template<typename T> void write_value(QDataStream& ss, T const& value);
+template<typename T> void write_value(QDataStream& ss, std::vector<T> const& values);
+template<typename T> void read_value(QDataStream& ss, T& value);
+template<typename T> void read_value(QDataStream& ss, std::vector<T>& values);
+
+/// Writes a quint32 placeholder, then the number of bytes written after
+/// it when closed. The stream must be seekable, it is only used on the
+/// in-memory buffer of a record, see write_fields().
+class SizePrefix
+{
+    QDataStream& m_ss;
+    qint64       m_at;
+public:
+    explicit SizePrefix(QDataStream& ss)
+        : m_ss{ss}, m_at{ss.device()->pos()}
+    {
+        m_ss << quint32{0};
+    }
+
+    void close()
+    {
+        QIODevice* dev = m_ss.device();
+        qint64 end = dev->pos();
+        dev->seek(m_at);
+        m_ss << static_cast<quint32>(end - m_at - 4);
+        dev->seek(end);
+    }
+};
+
+/// The record is encoded in memory, where patching the sizes of its fields
+/// is free, then written with its size in one call: seeking a QSaveFile
+/// flushes its buffer.
+template<typename T>
+void write_fields(QDataStream& ss, T const& record)
+{
+    QByteArray bytes;
+    {
+        QDataStream rs{&bytes, QIODevice::WriteOnly};
+        rs.setVersion(ss.version());
+        rs.setByteOrder(ss.byteOrder());
+        rs.setFloatingPointPrecision(ss.floatingPointPrecision());
+        auto write = [&](auto const& f)
+        {
+            rs << f.tag;
+            SizePrefix field_size{rs};
+            write_value(rs, record.*(f.member));
+            field_size.close();
+        };
+        std::apply([&](auto const&... f){ (write(f), ...); }, T::schema);
+    }
+    ss << static_cast<quint32>(bytes.size());
+    ss.writeRawData(bytes.constData(), bytes.size());
+}
+
+/// Return false if the stream is truncated or a field is corrupt.
+template<typename T>
+bool read_fields(QDataStream& ss, T& record)
+{
+    bool ok = true;
+    QIODevice* dev = ss.device();
+    quint32 record_size = 0;
+    ss >> record_size;
+    qint64 record_end = dev->pos() + record_size;
+    while(ok && ss.status() == QDataStream::Ok && dev->pos() < record_end)
+    {
+        quint16 tag = 0;
+        quint32 size = 0;
+        ss >> tag >> size;
+        qint64 end = dev->pos() + size;
+        if(ss.status() != QDataStream::Ok || end > record_end) { return false; }
+        auto read = [&](auto const& f)
+        {
+            if(f.tag != tag) { return; }
+            read_value(ss, record.*(f.member));
+            // A value must fill its field exactly.
+            if(dev->pos() != end) { ok = false; }
+        };
+        std::apply([&](auto const&... f){ (read(f), ...); }, T::schema);
+        // Unknown tags are fields of a newer schema.
+        if(dev->pos() < end) { ss.skipRawData(static_cast<int>(end - dev->pos())); }
+    }
+    return ok && ss.status() == QDataStream::Ok && dev->pos() == record_end;
+}
+
+template<typename T>
+void write_value(QDataStream& ss, T const& value)
+{
+    if constexpr(has_schema<T>::value) { write_fields(ss, value); }
+    else                               { ss << value; }
+}
+
+template<typename T>
+void write_value(QDataStream& ss, std::vector<T> const& values)
+{
+    ss << static_cast<quint32>(values.size());
+    for(auto const& value: values){ write_value(ss, value); }
+}
+
+template<typename T>
+void read_value(QDataStream& ss, T& value)
+{
+    if constexpr(has_schema<T>::value)
+    {
+        if(!read_fields(ss, value)) { ss.setStatus(QDataStream::ReadCorruptData); }
+    }
+    else { ss >> value; }
+}
+
+template<typename T>
+void read_value(QDataStream& ss, std::vector<T>& values)
+{
+    quint32 size = 0;
+    ss >> size;
+    values.clear();
+    // The size is not trusted for reserving memory, the stream may be corrupt.
+    values.reserve(std::min<quint32>(size, 1u << 16));
+    for(quint32 i = 0; i < size && ss.status() == QDataStream::Ok; i++)
+    {
+        values.emplace_back();
+        read_value(ss, values.back());
+    }
+}
+
+constexpr quint32 schema_magic = 0x51585346; // "QXSF"
+
+/// Writes records declaring a schema to a stream, after a header made of
+/// a magic number and a version identifying the set of records.
+struct SchemaWriter
+{
+private:
+    QDataStream* pss = nullptr;
+
+public:
+    SchemaWriter() { }
+    SchemaWriter(QDataStream* pss, quint32 version)
+    {
+        this->set_stream(pss, version);
+    }
+
+    virtual ~SchemaWriter()
+    {
+    }
+
+    void set_stream(QDataStream* pss, quint32 version)
+    {
+        this->pss = pss;
+        pss->setVersion(QDataStream::Qt_5_0);
+        (*pss) << schema_magic << version;
+    }
+
+    template<typename T>
+    void operator()(T const& record)
+    {
+        write_fields(*pss, record);
+    }
+
+    bool ok() const
+    {
+        return pss->status() == QDataStream::Ok;
+    }
+};
+
+/// Reads records written by SchemaWriter.
+struct SchemaReader
+{
+private:
+    QDataStream* pss       = nullptr;
+    quint32      m_version = 0;
+    bool         m_schema  = false;
+
+public:
+    SchemaReader() { }
+    SchemaReader(QDataStream* pss)
+    {
+        this->set_stream(pss);
+    }
+
+    /// Read the header, see is_schema().
+    void set_stream(QDataStream* pss)
+    {
+        this->pss = pss;
+        pss->setVersion(QDataStream::Qt_5_0);
+        quint32 magic = 0;
+        (*pss) >> magic >> m_version;
+        m_schema = pss->status() == QDataStream::Ok && magic == schema_magic;
+    }
+
+    /// False if the stream is empty or in the legacy format.
+    bool is_schema() const { return m_schema; }
+
+    /// Version written by the caller of SchemaWriter, it tells which
+    /// records the stream contains.
+    quint32 version() const { return m_version; }
+
+    /// Return false if the record is missing or corrupt.
+    template<typename T>
+    bool operator()(T& record)
+    {
+        return m_schema && read_fields(*pss, record);
+    }
+};
+
+/** SchemaWriter to a temporary file, which atomically replaces the target
+ *  file when commit() is called. Data is synced to the disk before the
+ *  rename, so a crash leaves either the old or the new file, never a
+ *  truncated one. If commit() is not called, the target file is left
+ *  untouched.
+ */
+struct SchemaFileWriter: public SchemaWriter
+{
+private:
+    std::unique_ptr<QSaveFile>   file;
+    std::unique_ptr<QDataStream> dts;
+
+public:
+    SchemaFileWriter(QString file_name, quint32 version)
+        : SchemaWriter{}
+    {
+        file = std::make_unique<QSaveFile>(file_name);
+        if(!file->open(QIODevice::WriteOnly))
+        {
+            throw std::runtime_error(" [ERROR] Cannot open file.");
+        }
+        dts = std::make_unique<QDataStream>(file.get());
+        this->set_stream(dts.get(), version);
+    }
+
+    void commit()
+    {
+        if(!this->ok())
+        {
+            throw std::runtime_error(" [ERROR] Cannot write file.");
+        }
+        commit_save_file(*file);
+    }
+};
+
+struct SchemaFileReader: public SchemaReader
+{
+private:
+    std::unique_ptr<QFile>       file;
+    std::unique_ptr<QDataStream> dts;
+
+public:
+    SchemaFileReader(QString file_name)
+        : SchemaReader{}
+    {
+        file = std::make_unique<QFile>(file_name);
+        if(!file->open(QIODevice::ReadOnly))
+        {
+            throw std::runtime_error(" [ERROR] Cannot open the file.");
+        }
+        dts = std::make_unique<QDataStream>(file.get());
+        this->set_stream(dts.get());
+    }
+};
+
 }
 
 #endif // SERIALIZATION_HPP
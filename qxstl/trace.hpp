@@ -0,0 +1,172 @@
+#ifndef QXSTL_TRACE_HPP
+#define QXSTL_TRACE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <QtCore>
+
+/** Scoped trace spans exported in the Chrome trace_event JSON format,
+ *  which can be opened in Perfetto (ui.perfetto.dev) or chrome://tracing.
+ *
+ *  Example:
+ *
+ *    qxstl::trace::start("startup.json");
+ *    {
+ *        qxstl::trace::Span span{"load_settings"};
+ *        ...
+ *    }
+ *    qxstl::trace::finish();
+ *
+ *  While tracing is off, a span only costs a branch on a flag in its
+ *  constructor and destructor, it does not read the clock.
+ */
+namespace qxstl::trace
+{
+
+namespace detail
+{
+    using Clock = std::chrono::steady_clock;
+
+    struct Event
+    {
+        const char* name;
+        // 'X' complete event with a duration, 'i' instant event
+        char        phase;
+        qint64      ts_us;
+        qint64      dur_us;
+        quint64     tid;
+    };
+
+    struct State
+    {
+        std::mutex         mutex;
+        std::vector<Event> events;
+        QString            file_name;
+        Clock::time_point  epoch;
+    };
+
+    inline std::atomic<bool> enabled{false};
+
+    inline State& state()
+    {
+        static State s;
+        return s;
+    }
+
+    inline qint64 now_us()
+    {
+        return std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - state().epoch).count();
+    }
+
+    inline quint64 thread_id()
+    {
+        return std::hash<std::thread::id>{}(std::this_thread::get_id()) & 0xFFFFFFFF;
+    }
+
+    inline void record(Event const& event)
+    {
+        std::lock_guard<std::mutex> lock{state().mutex};
+        state().events.push_back(event);
+    }
+}
+
+/// True between start() and finish().
+inline bool is_enabled()
+{
+    return detail::enabled.load(std::memory_order_relaxed);
+}
+
+/// Start recording spans, which are written to the file by finish().
+/// Timestamps are relative to this call.
+inline void start(QString file_name)
+{
+    auto& s = detail::state();
+    {
+        std::lock_guard<std::mutex> lock{s.mutex};
+        s.file_name = std::move(file_name);
+        s.epoch     = detail::Clock::now();
+        s.events.clear();
+        s.events.reserve(256);
+    }
+    detail::enabled.store(true, std::memory_order_relaxed);
+}
+
+/// Record an event without duration, such as the first paint.
+inline void instant(const char* name)
+{
+    if(!is_enabled()) { return; }
+    detail::record({name, 'i', detail::now_us(), 0, detail::thread_id()});
+}
+
+/// Stop recording and write the trace file. Does nothing if tracing is off.
+inline void finish()
+{
+    if(!detail::enabled.exchange(false)) { return; }
+
+    auto& s = detail::state();
+    std::lock_guard<std::mutex> lock{s.mutex};
+    QJsonArray array;
+    qint64 pid = QCoreApplication::applicationPid();
+    for(auto const& e: s.events)
+    {
+        QJsonObject obj{
+            {"name", QString::fromUtf8(e.name)},
+            {"ph",   QString(QChar::fromLatin1(e.phase))},
+            {"ts",   e.ts_us},
+            {"pid",  pid},
+            {"tid",  static_cast<qint64>(e.tid)}
+        };
+        if(e.phase == 'X') { obj.insert("dur", e.dur_us); }
+        // Instant events span the thread track
+        if(e.phase == 'i') { obj.insert("s", "t"); }
+        array.append(obj);
+    }
+    QJsonObject root{{"traceEvents", array}, {"displayTimeUnit", "ms"}};
+
+    QFile file{s.file_name};
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Truncate)
+       || file.write(QJsonDocument(root).toJson(QJsonDocument::Compact)) < 0)
+    {
+        std::cerr << " [ERROR] Unable to write trace file "
+                  << s.file_name.toStdString() << std::endl;
+        return;
+    }
+    std::cout << " [INFO] Trace written to " << s.file_name.toStdString()
+              << " (" << s.events.size() << " events)" << std::endl;
+    s.events.clear();
+}
+
+/// Records the time from its construction to the end of the scope.
+/// The name must outlive the trace, a string literal.
+class Span
+{
+    const char* m_name;
+    qint64      m_start;
+public:
+    explicit Span(const char* name): m_name{name}, m_start{-1}
+    {
+        if(is_enabled()) { m_start = detail::now_us(); }
+    }
+
+    ~Span()
+    {
+        // Also skips spans opened before start()
+        if(m_start < 0 || !is_enabled()) { return; }
+        qint64 end = detail::now_us();
+        detail::record({m_name, 'X', m_start, end - m_start, detail::thread_id()});
+    }
+
+    Span(Span const&) = delete;
+    Span& operator=(Span const&) = delete;
+};
+
+}
+
+#endif // QXSTL_TRACE_HPP
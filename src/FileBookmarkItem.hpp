@@ -3,16 +3,149 @@
 
 #include <QtCore>
 
+#include <qxstl/PathTrie.hpp>
+
+#include "fileprobeservice.hpp"
+
+/** Metadata resolved from the bookmark target. It is computed once when
+ *  the item is inserted or loaded, so that rendering the model never has
+ *  to touch the filesystem. */
+struct FileBookmarkMeta
+{
+    using Status = FileProbeResult::Status;
+    using PathId = qxstl::storage::PathTrie::Id;
+
+    Status  status = Status::Pending;
+    // "FILE", "DIR", "URL", or the probe status when it is not known yet.
+    // A literal shared by all items, it is never allocated.
+    QString item_type;
+    // Node of the canonical path when it is interned, usually the path
+    // itself, 0 otherwise or when the target does not exist or is not a
+    // local file
+    PathId  canonical_path = 0;
+};
+
+/** A bookmark of a file, a directory or a URL.
+ *
+ *  The path is interned in a trie shared by all bookmarks of the process,
+ *  see paths(): bookmarks of the same project tree share their directory
+ *  prefix, and an item holds a 32-bit node instead of UTF-16 copies of the
+ *  path, the file name and the directory. The strings are rebuilt on
+ *  demand, for display or opening.
+ */
 struct FileBookmarkItem
 {
-    QString uri_path;
+    using PathId = qxstl::storage::PathTrie::Id;
+
     QString brief;
     QString description;
 
+    FileBookmarkMeta meta;
+
     FileBookmarkItem(){}
-    FileBookmarkItem(QString uri_path, QString brief, QString description):
-        uri_path(uri_path), brief(brief), description(description)
-    {}
+    FileBookmarkItem(QString const& uri_path, QString brief, QString description):
+        brief(brief), description(description)
+    {
+        this->set_uri_path(uri_path);
+    }
+
+    /// Paths of all bookmarks
+    static qxstl::storage::PathTrie& paths()
+    {
+        static qxstl::storage::PathTrie trie;
+        return trie;
+    }
+
+    /// Path or URL of the target, as entered by the user
+    QString uri_path() const
+    {
+        return paths().path(m_path);
+    }
+
+    void set_uri_path(QString const& uri_path)
+    {
+        m_path   = paths().intern(uri_path);
+        m_is_url = uri_path.startsWith("http://")
+                   || uri_path.startsWith("https://")
+                   || uri_path.startsWith("ftp://");
+    }
+
+    /// Node of the path in paths(), equal for equal paths
+    PathId path_id() const
+    {
+        return m_path;
+    }
+
+    /// Set a path already interned, with its kind, as returned by
+    /// path_id() and is_file_uri().
+    void set_path_id(PathId path, bool is_url)
+    {
+        m_path   = path;
+        m_is_url = is_url;
+    }
+
+    // Check whether URI string is file or an URL, FTP ...
+    bool is_file_uri() const
+    {
+        return not m_is_url;
+    }
+
+    /// Name of the file or directory, the whole URL for other targets.
+    QString file_name() const
+    {
+        if(!this->is_file_uri()) { return this->uri_path(); }
+        return paths().name(m_path);
+    }
+
+    /// Absolute path of the directory containing the target, empty for
+    /// other targets.
+    QString file_path() const
+    {
+        if(!this->is_file_uri()) { return QString{}; }
+        QString path = this->uri_path();
+        // Relative to the current directory, QFileInfo only performs
+        // string manipulation here.
+        if(QDir::isRelativePath(path)) { return QFileInfo{path}.absolutePath(); }
+        QString dir = paths().path(paths().parent(m_path));
+        // The root directory "/" or "C:/" is not shortened.
+        if(dir.isEmpty() || dir.endsWith(':')) { dir += '/'; }
+        return dir;
+    }
+
+    /** Compute the metadata that can be derived from the path string
+     *  alone, without accessing the filesystem. The type and the canonical
+     *  path are pending until apply_probe() is called. */
+    void resolve_names()
+    {
+        meta = FileBookmarkMeta{};
+        meta.status    = FileBookmarkMeta::Status::Ok;
+        meta.item_type = QStringLiteral("URL");
+
+        if(!is_file_uri()) { return; }
+        this->apply_probe(FileProbeResult{});
+    }
+
+    /// Update the metadata with the answer of a filesystem probe.
+    void apply_probe(FileProbeResult const& result)
+    {
+        using Status = FileBookmarkMeta::Status;
+        meta.status = result.status;
+        // Usually the path itself. Other paths are not interned, the trie
+        // would keep every target ever probed.
+        meta.canonical_path = paths().find(result.canonical_path);
+        switch(result.status)
+        {
+        case Status::Ok:          meta.item_type = result.is_file ? QStringLiteral("FILE")
+                                                                  : QStringLiteral("DIR"); break;
+        case Status::Missing:     meta.item_type = QStringLiteral("MISSING");     break;
+        case Status::Unreachable: meta.item_type = QStringLiteral("UNREACHABLE"); break;
+        case Status::Pending:     meta.item_type = QStringLiteral("PENDING");     break;
+        }
+    }
+
+private:
+    PathId m_path   = 0;
+    bool   m_is_url = false;
 };
 
 
@@ -1,41 +1,130 @@
 #include <qxstl/serialization.hpp>
+#include <qxstl/trace.hpp>
+#include <qxstl/metrics.hpp>
 #include "appmainwindow.hpp"
 
+#ifndef APPLAUNCHER_RUNTIME_UI
+// Generated by uic from user_interface.ui, see CMAKE_AUTOUIC.
+#include "ui_user_interface.h"
+#endif
+
 namespace qx = qxstl::event;
 
+namespace
+{
+    /// The form compiled by uic, or with APPLAUNCHER_RUNTIME_UI, loaded
+    /// from the .ui resource at runtime so that it can be edited without
+    /// recompiling.
+    FormLoader make_form_loader(QMainWindow* parent)
+    {
+#ifdef APPLAUNCHER_RUNTIME_UI
+        return FormLoader(parent, ":/assets/user_interface.ui");
+#else
+        return FormLoader::compiled<Ui::MainWindow>(parent);
+#endif
+    }
+}
+
 AppMainWindow::AppMainWindow()
-    : loader{FormLoader(this, ":/assets/user_interface.ui")}
+    : loader{make_form_loader(this)}
 {
     form = loader.GetForm();
+    std::cout << " [INFO] Form: " << loader.source().toStdString() << std::endl;
 
     //====== Set Up Tabs ===================================/q
-    tab_applauncher   = std::make_unique<Tab_ApplicationLauncher>(
-        this,
-        &loader,
-        std::bind(&AppMainWindow::save_settings, this)
-        );
-    tab_deskbookmarks = std::make_unique<Tab_DesktopBookmarks>(this, &loader);
+    {
+        qxstl::trace::Span span{"Tab_ApplicationLauncher"};
+        tab_applauncher   = std::make_unique<Tab_ApplicationLauncher>(
+            this,
+            &loader,
+            std::bind(&AppMainWindow::save_settings, this)
+            );
+    }
+    {
+        qxstl::trace::Span span{"Tab_DesktopBookmarks"};
+        tab_deskbookmarks = std::make_unique<Tab_DesktopBookmarks>(
+            this,
+            &loader,
+            std::bind(&AppMainWindow::save_settings, this)
+            );
+    }
 
     //===== Set up User Interface Theme =================//
 
-    qx::set_app_dark_style();
+    {
+        qxstl::trace::Span span{"set_app_dark_style"};
+        qx::set_app_dark_style();
+    }
 
     //========= Create Tray Icon =======================//
 
     // Do not quit when user clicks at close button
     this->setAttribute(Qt::WA_QuitOnClose, false);
 
-    tray_icon = qx::make_window_toggle_trayicon(
-        this,
-        ":/assets/appicon.png"
-        , "Tray Icon Test"
-        );
+    {
+        qxstl::trace::Span span{"make_window_toggle_trayicon"};
+        tray_icon = qx::make_window_toggle_trayicon(
+            this,
+            ":/assets/appicon.png"
+            , "Tray Icon Test"
+            );
+    }
 
     //========= Load Application state =================//
 
     this->setWindowAlwaysOnTop();
-    this->load_settings();
-    this->load_window_settings();
+    {
+        qxstl::trace::Span span{"load_settings"};
+        this->load_settings();
+    }
+    {
+        qxstl::trace::Span span{"load_window_settings"};
+        this->load_window_settings();
+    }
+
+    //====== Set Up Persistence ===========================//
+
+    // Created after loading, so that loading is not saved back. The
+    // snapshot is taken on the GUI thread and written on a worker.
+    persistence = std::make_unique<PersistenceService>(
+        this->get_settings_file(),
+        [this]() -> PersistenceService::Snapshot
+        {
+            auto launcher  = tab_applauncher->snapshot();
+            auto bookmarks = tab_deskbookmarks->snapshot();
+            auto store     = this->get_bookmark_store_file();
+            return [launcher, bookmarks, store](qxstl::serialization::SchemaWriter& writer,
+                                                qint64 generation)
+            {
+                // The store is committed first: a crash in between leaves
+                // a store newer than the settings file, see load_settings().
+                bookmarks.write_store(store, generation);
+                writer(launcher);
+                writer(bookmarks.order);
+            };
+        });
+
+    // Replay the changes made after the settings file was written, then
+    // record new changes in the journal. Replayed changes are not recorded
+    // again, they schedule a snapshot instead, which compacts the journal.
+    persistence->open_journal(this->get_journal_file(), snapshot_generation,
+                              [this](JournalRecord const& record, qint64 generation)
+                              {
+                                  this->apply_journal_record(record, generation);
+                              });
+    auto journal = [this](JournalRecord const& record){ persistence->append(record); };
+    tab_applauncher->set_journal(journal);
+    tab_deskbookmarks->set_journal(journal);
+
+    //====== Load Usage Log ================================//
+
+    {
+        qxstl::trace::Span span{"load_usage_log"};
+        usage = std::make_unique<UsageLog>(this->get_usage_log_file());
+        std::cout << " [INFO] Usage log records = " << usage->load() << std::endl;
+    }
+    tab_applauncher->set_usage_log(usage.get());
+    tab_deskbookmarks->set_usage_log(usage.get());
 
     // ========== Event Handlers of tray Icon ===============================//
 
@@ -55,16 +144,39 @@ AppMainWindow::AppMainWindow()
                          // std::cout << " [TRACE] TrayIcon Clicked OK." << std::endl;
                      });
 
+    // Context menu of the tray icon with the most used commands, rebuilt
+    // every time it is shown.
+    auto tray_menu = new QMenu(this);
+    QObject::connect(tray_menu, &QMenu::aboutToShow,
+                     [this, tray_menu]
+                     {
+                         tray_menu->clear();
+                         for(auto const& text: tab_applauncher->most_used(10))
+                         {
+                             QObject::connect(tray_menu->addAction(text), &QAction::triggered,
+                                              [this, text]{ tab_applauncher->run_entry(text); });
+                         }
+                         tray_menu->addSeparator();
+                         QObject::connect(tray_menu->addAction("Show"), &QAction::triggered,
+                                          [this]{ this->handle_request({}); });
+                     });
+    tray_icon->setContextMenu(tray_menu);
+
     // ========== Set Event Handlers of Application Launcher Tab ============//
 
     // Enable Drag and Drop Event
     this->setAcceptDrops(true);
+    importer = std::make_unique<BookmarkImporter>();
 
     // Register pointer to static member function
     loader.on_button_clicked("btn_quit_app",
                              [self = this]
                              {
                                  self->save_settings();
+                                 // Wait for the settings file to be committed,
+                                 // the index fingerprint depends on it.
+                                 self->persistence->flush();
+                                 self->save_search_index();
                                  QApplication::quit();
                              });
 
@@ -132,12 +244,56 @@ AppMainWindow::get_settings_file()
     // On Linux, the typical location of the setting file is:
     //   /home/<USER>/.config/<ApplicationName>.qconf
     QString settings_file = QStandardPaths::standardLocations(QStandardPaths::ConfigLocation).at(0)
-                            + "/" + qApp->applicationName() + ".qconf";
-    std::cout << " [INFO] Settings file = " << settings_file.toStdString() << std::endl;
+                            + "/" + QCoreApplication::applicationName() + ".qconf";
     return settings_file;
 
 }
 
+QString
+AppMainWindow::get_journal_file()
+{
+    QFileInfo info{this->get_settings_file()};
+    return info.absolutePath() + "/" + info.completeBaseName() + ".qjournal";
+}
+
+QString
+AppMainWindow::get_bookmark_store_file()
+{
+    QFileInfo info{this->get_settings_file()};
+    return info.absolutePath() + "/" + info.completeBaseName() + ".qbk";
+}
+
+QString
+AppMainWindow::get_search_index_file()
+{
+    QFileInfo info{this->get_settings_file()};
+    return info.absolutePath() + "/" + info.completeBaseName() + ".qidx";
+}
+
+QString
+AppMainWindow::get_usage_log_file()
+{
+    QFileInfo info{this->get_settings_file()};
+    return info.absolutePath() + "/" + info.completeBaseName() + ".qusage";
+}
+
+QByteArray
+AppMainWindow::get_settings_fingerprint()
+{
+    QFileInfo info{this->get_bookmark_store_file()};
+    if(!info.exists()) { info = QFileInfo{this->get_settings_file()}; }
+    if(!info.exists()) { return QByteArray{}; }
+    return QByteArray::number(info.size()) + ":"
+           + QByteArray::number(info.lastModified().toMSecsSinceEpoch());
+}
+
+void
+AppMainWindow::save_search_index()
+{
+    tab_deskbookmarks->save_search_index(this->get_search_index_file(),
+                                         this->get_settings_fingerprint());
+}
+
 void
 AppMainWindow::load_window_settings()
 {
@@ -185,55 +341,166 @@ void
 AppMainWindow::load_settings()
 {
     QString settings_file = this->get_settings_file();    
+    std::cout << " [INFO] Settings file = " << settings_file.toStdString() << std::endl;
     // Abort if setting files does not exist
     if(!QFile(settings_file).exists()){ return; }
 
-    qxstl::serialization::FileReader reader(settings_file);
-    reader(*tab_applauncher);
-    reader(*tab_deskbookmarks);
+    PersistenceService::SnapshotInfo info;
+    BookmarkOrder order;
+    if(qxstl::serialization::SchemaFileReader reader(settings_file); reader.is_schema())
+    {
+        // The records of a newer version are unknown. The file is kept
+        // aside, since it is replaced on the next save.
+        if(reader.version() > PersistenceService::settings_format_version)
+        {
+            QString backup = settings_file + ".v" + QString::number(reader.version());
+            QFile::remove(backup);
+            QFile::copy(settings_file, backup);
+            std::cerr << " [ERROR] Settings file written by a newer version "
+                      << reader.version() << ", ignored and saved to "
+                      << backup.toStdString() << std::endl;
+            return;
+        }
+        // Older versions miss the records added later, see
+        // PersistenceService::settings_format_version.
+        LauncherSnapshot launcher;
+        if(!reader(launcher) || (reader.version() >= 2 && !reader(order)) || !reader(info))
+        {
+            std::cerr << " [ERROR] Settings file is corrupt, version "
+                      << reader.version() << std::endl;
+            info  = PersistenceService::SnapshotInfo{};
+            order = BookmarkOrder{};
+        }
+        tab_applauncher->restore(launcher);
+    }
+    else
+    {
+        // Format of former versions, a map of named entries. Bookmarks
+        // were only stored there before the store file existed.
+        qxstl::serialization::FileReader legacy(settings_file);
+        legacy(*tab_applauncher);
+        legacy(*tab_deskbookmarks);
+        // Missing from files written before the journal existed: generation 0
+        legacy(info);
+    }
+    snapshot_generation = info.journal_generation;
+    bookmark_generation = snapshot_generation;
+
+    // Bookmarks are mapped from the store, files written by former
+    // versions only have them in the settings file, loaded above.
+    tab_deskbookmarks->load_store(this->get_bookmark_store_file(), bookmark_generation);
+    // Positions of the order are the ones of the store written with it.
+    if(bookmark_generation == snapshot_generation) { tab_deskbookmarks->restore_order(order); }
+
+    tab_deskbookmarks->load_search_index(this->get_search_index_file(),
+                                         this->get_settings_fingerprint());
 
     std::cout << " [INFO] Settings loaded Ok." << std::endl;
 }
 
+void
+AppMainWindow::apply_journal_record(JournalRecord const& record, qint64 generation)
+{
+    // Skip changes already contained in the store or the settings file
+    if(record.is_bookmark())
+    {
+        if(generation >= bookmark_generation) { tab_deskbookmarks->apply(record); }
+        return;
+    }
+    if(generation >= snapshot_generation) { tab_applauncher->apply(record); }
+}
+
 /// Save application state
 void AppMainWindow::save_settings()
 {
+    static auto& calls = qxstl::metrics::counter(
+        "applauncher_save_settings_total", "Calls of save_settings()");
+    calls.add();
+    // Called while the tabs are loaded from the settings file.
+    if(!persistence) { return; }
+    persistence->mark_dirty();
+}
 
-    std::cout << " [INFO] START Settings saved OK" << std::endl;
-
-    auto settings_file = this->get_settings_file();
 
-    qxstl::serialization::FileWriter writer(settings_file);
-    writer(*tab_applauncher);
-    writer(*tab_deskbookmarks);
-    std::cout << " [INFO] END Settings saved OK" << std::endl;
+bool
+AppMainWindow::handle_request(InstanceRequest const& request)
+{
+    using Action = InstanceRequest::Action;
+    if(request.action == Action::Show)
+    {
+        this->showNormal();
+        this->raise();
+        this->activateWindow();
+        return true;
+    }
+    if(request.action == Action::Run)
+    {
+        return this->tab_applauncher->run_entry(request.argument);
+    }
+    if(request.action == Action::AddBookmark && !request.argument.isEmpty())
+    {
+        // Recorded in the journal by the bookmarks tab
+        this->tab_deskbookmarks->add_model_entry(request.argument, "", "");
+        return true;
+    }
+    return false;
 }
 
-
 void
 AppMainWindow::dragEnterEvent(QDragEnterEvent* event)
 {
-#if 1
-    if(this->tab_deskbookmarks->is_visible())
+    // Files are only added on drop, see dropEvent().
+    if(this->tab_deskbookmarks->is_visible() && event->mimeData()->hasUrls())
     {
-        const QMimeData* mimeData = event->mimeData();
-        std::cout << "Drag Event" << std::endl;
-        if(!mimeData->hasUrls())
-            return;
-        auto url = mimeData->urls()[0];
-        QString path;
-
-        if(url.isLocalFile())
-            path = mimeData->urls()[0].toLocalFile();
-        else
-            path = mimeData->urls()[0].toString();
+        event->acceptProposedAction();
+    }
+}
 
-        std::cout << " [TRACE] Dragged file: " << path.toStdString() << "\n";
-        // this->tview_disp->addItem(path);
-        this->tab_deskbookmarks->add_model_entry(path, "", "");
-        this->save_settings();
+void
+AppMainWindow::dropEvent(QDropEvent* event)
+{
+    if(!this->tab_deskbookmarks->is_visible() || !event->mimeData()->hasUrls()) { return; }
+    // Decoded from the text/uri-list payload, it may hold thousands of paths.
+    QList<QUrl> urls = event->mimeData()->urls();
+    event->acceptProposedAction();
+    std::cout << " [TRACE] Dropped " << urls.size() << " files" << std::endl;
+
+    // Large drops show their progress, and can be cancelled. The dialog
+    // only appears if the import takes a while.
+    QPointer<QProgressDialog> progress;
+    if(urls.size() >= 1000)
+    {
+        progress = new QProgressDialog("Adding bookmarks ...", "Cancel", 0, urls.size(), this);
+        progress->setMinimumDuration(500);
+        progress->setValue(0);
     }
-#endif
 
+    int job = importer->import(
+        urls,
+        [progress](int done, int total)
+        {
+            Q_UNUSED(total)
+            if(progress) { progress->setValue(done); }
+        },
+        [this, progress](std::vector<FileBookmarkItem> items)
+        {
+            if(progress) { progress->deleteLater(); }
+            int found = static_cast<int>(items.size());
+            // A single model insertion, its journal records are written at once.
+            persistence->begin_batch();
+            int added = this->tab_deskbookmarks->add_model_entries(std::move(items));
+            persistence->end_batch();
+            std::cout << " [INFO] Bookmarks added: " << added << " of "
+                      << found << " dropped files" << std::endl;
+        });
+    // Other drops being imported meanwhile go on.
+    if(progress)
+    {
+        QObject::connect(progress, &QProgressDialog::canceled, [this, progress, job]
+                         {
+                             this->importer->cancel(job);
+                             if(progress) { progress->deleteLater(); }
+                         });
+    }
 }
 
@@ -13,6 +13,10 @@
 #include "FileBookmarkItem.hpp"
 #include "tab_applicationlauncher.hpp"
 #include "tab_desktopbookmarks.hpp"
+#include "persistenceservice.hpp"
+#include "bookmarkimporter.hpp"
+#include "singleinstance.hpp"
+#include "usagelog.hpp"
 
 
 class AppMainWindow: public QMainWindow
@@ -24,9 +28,23 @@ private:
     //======== TrayIcon =============================//
     QSystemTrayIcon* tray_icon;
 
+    // Declared before the tabs, which keep a pointer to it.
+    std::unique_ptr<UsageLog>                usage;
     std::unique_ptr<Tab_DesktopBookmarks>    tab_deskbookmarks;
     std::unique_ptr<Tab_ApplicationLauncher> tab_applauncher;
 
+    // Declared after the tabs: it is destroyed first, flushing pending
+    // writes while the tabs still exist.
+    std::unique_ptr<PersistenceService>      persistence;
+    // Journal generations already contained in the settings file
+    qint64                                   snapshot_generation = 0;
+    // Journal generations already contained in the bookmark store, it may
+    // be one more than the settings file after a crash.
+    qint64                                   bookmark_generation = 0;
+    // Converts dropped files, declared last: it is destroyed first and its
+    // pending callbacks are dropped before the tabs are gone.
+    std::unique_ptr<BookmarkImporter>        importer;
+
 public:
 
 
@@ -34,7 +52,29 @@ public:
     /// Make this window stay alwys on top
     void setWindowAlwaysOnTop();
 
-    QString get_settings_file();
+    /// Settings file of the current user, it does not need a window.
+    static QString get_settings_file();
+
+    /// Prefix of the journal files recording changes since the settings
+    /// file was written, next to it.
+    QString get_journal_file();
+
+    /// Bookmark store, next to the settings file
+    QString get_bookmark_store_file();
+
+    /// File where the bookmark search index is saved, next to the settings file
+    QString get_search_index_file();
+
+    /// Log of launched commands and opened bookmarks, next to the settings file
+    QString get_usage_log_file();
+
+    /// Identify the current content of the bookmark store, the search index
+    /// is only reused if it was saved with the same fingerprint.
+    QByteArray get_settings_fingerprint();
+
+    /// Save the search index, it must be called after the last
+    /// save_settings() call.
+    void save_search_index();
 
     void load_window_settings();
 
@@ -43,11 +83,21 @@ public:
     /// Load application state
     void load_settings();
 
-    /// Save application state
+    /// Apply a change replayed from the journal
+    void apply_journal_record(JournalRecord const& record, qint64 generation);
+
+    /// Schedule a save of the application state, the file is written on
+    /// a worker thread after a short delay.
     void save_settings();
 
+    /// Handle a request forwarded by a later instance of the launcher.
+    bool handle_request(InstanceRequest const& request);
+
     void dragEnterEvent(QDragEnterEvent* event) override;
 
+    /// Bookmark all dropped files and URLs, see BookmarkImporter.
+    void dropEvent(QDropEvent* event) override;
+
 #if 0
     // See: https://stackoverflow.com/questions/18934964
     bool eventFilter(QObject* object, QEvent* event) override
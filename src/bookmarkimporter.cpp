@@ -0,0 +1,140 @@
+#include <algorithm>
+#include <atomic>
+
+#include "bookmarkimporter.hpp"
+
+namespace
+{
+    // URLs converted by each task of the thread pool
+    constexpr int chunk_size = 512;
+}
+
+/// State of an import, only accessed from the thread owning the importer
+/// but for cancelled, which the tasks check before converting their chunk.
+struct BookmarkImporter::Job
+{
+    int      id         = 0;
+    std::atomic<bool> cancelled{false};
+    int      total      = 0;
+    // URLs converted so far
+    int      done       = 0;
+    // Chunks not delivered yet
+    int      pending    = 0;
+    Progress progress;
+    Callback callback;
+    std::vector<std::vector<FileBookmarkItem>> chunks;
+};
+
+BookmarkImporter::BookmarkImporter()
+    : m_next_id{0}
+{
+    m_pool.setMaxThreadCount(std::max(QThread::idealThreadCount(), 1));
+}
+
+BookmarkImporter::~BookmarkImporter()
+{
+    // Tasks only manipulate strings and finish quickly, the chunks they
+    // post from now on are discarded by the receiver.
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+QString
+BookmarkImporter::path_of(QUrl const& url)
+{
+    if(url.isLocalFile()) { return url.toLocalFile(); }
+    return url.toString();
+}
+
+int
+BookmarkImporter::import(QList<QUrl> urls, Progress progress, Callback done)
+{
+    auto job = std::make_shared<Job>();
+    job->id         = ++m_next_id;
+    job->total      = urls.size();
+    job->progress   = std::move(progress);
+    job->callback   = std::move(done);
+    job->pending    = (urls.size() + chunk_size - 1) / chunk_size;
+    job->chunks.resize(static_cast<size_t>(job->pending));
+    if(job->pending == 0)
+    {
+        job->callback({});
+        return job->id;
+    }
+    m_jobs.insert(job->id, job);
+
+    auto sender = m_receiver.sender();
+    for(int chunk = 0; chunk < job->pending; chunk++)
+    {
+        QList<QUrl> part = urls.mid(chunk * chunk_size, chunk_size);
+        qxstl::concurrent::run(&m_pool, [this, sender, job, chunk, part]
+        {
+            if(job->cancelled) { return; }
+            std::vector<FileBookmarkItem> items;
+            items.reserve(static_cast<size_t>(part.size()));
+            // Interning is thread-safe, equal paths get the same node.
+            QSet<FileBookmarkItem::PathId> seen;
+            for(auto const& url: part)
+            {
+                QString path = path_of(url);
+                if(path.isEmpty()) { continue; }
+                FileBookmarkItem item{path, "", ""};
+                if(seen.contains(item.path_id())) { continue; }
+                seen.insert(item.path_id());
+                item.resolve_names();
+                items.push_back(std::move(item));
+            }
+            // The receiver is a member: if the importer is destroyed, the
+            // callback is dropped and this is never dereferenced.
+            sender.post([this, job, chunk, items]
+                        {
+                            this->on_chunk_done(job, chunk, std::move(items));
+                        });
+        });
+    }
+    return job->id;
+}
+
+void
+BookmarkImporter::cancel(int id)
+{
+    auto job = m_jobs.take(id);
+    if(job) { job->cancelled = true; }
+}
+
+void
+BookmarkImporter::cancel()
+{
+    for(auto const& job: m_jobs) { job->cancelled = true; }
+    m_jobs.clear();
+    m_pool.clear();
+}
+
+void
+BookmarkImporter::on_chunk_done(std::shared_ptr<Job> const& job, int chunk,
+                                std::vector<FileBookmarkItem> items)
+{
+    if(job->cancelled) { return; }
+    job->chunks[static_cast<size_t>(chunk)] = std::move(items);
+    job->done += std::min(chunk_size, job->total - chunk * chunk_size);
+    if(job->progress) { job->progress(job->done, job->total); }
+    if(--job->pending > 0) { return; }
+
+    // Chunks in the order of the URLs, without the paths repeated across
+    // chunks.
+    std::vector<FileBookmarkItem> result;
+    result.reserve(static_cast<size_t>(job->total));
+    QSet<FileBookmarkItem::PathId> seen;
+    for(auto& part: job->chunks)
+    {
+        for(auto& item: part)
+        {
+            if(seen.contains(item.path_id())) { continue; }
+            seen.insert(item.path_id());
+            result.push_back(std::move(item));
+        }
+    }
+    job->chunks.clear();
+    m_jobs.remove(job->id);
+    job->callback(std::move(result));
+}
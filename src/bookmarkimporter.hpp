@@ -0,0 +1,68 @@
+#ifndef BOOKMARKIMPORTER_HPP
+#define BOOKMARKIMPORTER_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QtCore>
+
+#include <qxstl/concurrent.hpp>
+
+#include "FileBookmarkItem.hpp"
+
+/** Class BookmarkImporter turns the URLs of a drop, possibly thousands of
+ *  them from a text/uri-list payload, into bookmarks without blocking the
+ *  GUI thread.
+ *
+ *  + URLs are split in chunks converted on a thread pool: local files are
+ *    decoded to paths, paths are interned and the metadata that depends
+ *    on the path alone is resolved. The filesystem is not accessed here,
+ *    targets are probed by the model once inserted, see FileProbeService.
+ *
+ *  + Duplicated URLs are dropped, the first occurrence is kept.
+ *
+ *  + Progress and the resulting items are delivered on the thread owning
+ *    the importer, items in a single call, in the order of the URLs.
+ *************************************************************************/
+class BookmarkImporter
+{
+public:
+    using Callback = std::function<void (std::vector<FileBookmarkItem> items)>;
+    /// Number of URLs converted so far, out of total.
+    using Progress = std::function<void (int done, int total)>;
+
+    BookmarkImporter();
+    ~BookmarkImporter();
+
+    BookmarkImporter(BookmarkImporter const&) = delete;
+    BookmarkImporter& operator=(BookmarkImporter const&) = delete;
+
+    /// Convert the URLs, then call done. Several imports may run at once,
+    /// returns the id of this one.
+    int import(QList<QUrl> urls, Progress progress, Callback done);
+
+    /// Drop the import if still running, its callbacks are not called.
+    void cancel(int id);
+
+    /// Drop all the imports still running.
+    void cancel();
+
+    /// Path of the bookmark of a URL, as dropped by file managers.
+    static QString path_of(QUrl const& url);
+
+private:
+    struct Job;
+
+    // Receives the chunks converted by the worker threads
+    qxstl::concurrent::Receiver m_receiver;
+    QThreadPool                 m_pool;
+    // Imports still running, by id
+    QHash<int, std::shared_ptr<Job>> m_jobs;
+    int                         m_next_id;
+
+    void on_chunk_done(std::shared_ptr<Job> const& job, int chunk,
+                       std::vector<FileBookmarkItem> items);
+};
+
+#endif // BOOKMARKIMPORTER_HPP
@@ -0,0 +1,246 @@
+#include <iostream>
+
+#include "bookmarksearch.hpp"
+
+namespace
+{
+    /// Copy of the items of a model that is not attached to a source
+    class ItemsSource: public qxstl::model::RecordSource<FileBookmarkItem>
+    {
+        std::vector<FileBookmarkItem> m_items;
+    public:
+        explicit ItemsSource(std::vector<FileBookmarkItem> items)
+            : m_items{std::move(items)}
+        { }
+
+        int size() const override { return static_cast<int>(m_items.size()); }
+
+        FileBookmarkItem item(int position) const override
+        {
+            return m_items[static_cast<size_t>(position)];
+        }
+    };
+}
+
+BookmarkSearch::BookmarkSearch(FileBookmarkItemModel* model)
+    : m_model{model}
+    , m_index{std::make_shared<TrigramIndex>()}
+    , m_generation{std::make_shared<std::atomic<quint64>>(0)}
+    , m_stale{true}
+    , m_rerun_scheduled{false}
+    , m_building{false}
+    , m_changes{0}
+    , m_snapshot_changes{0}
+{
+    m_model->add_observer(this);
+}
+
+BookmarkSearch::~BookmarkSearch()
+{
+    m_model->remove_observer(this);
+    // Cancel the running query
+    ++(*m_generation);
+}
+
+void
+BookmarkSearch::search(QString const& text)
+{
+    m_query = text;
+    quint64 generation = ++(*m_generation);
+
+    if(text.isEmpty())
+    {
+        m_model->clear_row_filter();
+        return;
+    }
+    this->ensure_index();
+
+    // Until the index is ready, the query scans a copy of the items.
+    auto index   = m_stale ? nullptr : m_index;
+    auto source  = m_stale ? this->snapshot() : nullptr;
+    auto current = m_generation;
+    auto sender  = m_receiver.sender();
+    qxstl::concurrent::run(QThreadPool::globalInstance(),
+                           [this, index, source, current, sender, generation, text]
+    {
+        auto cancelled = [&]{ return current->load() != generation; };
+        TrigramIndex::DocList positions;
+        if(index) { positions = index->query(text, cancelled); }
+        else
+        {
+            QString pattern = text.toCaseFolded();
+            for(int s = 0; s < source->size(); s++)
+            {
+                if((s & 0xFFF) == 0 && cancelled()) { return; }
+                if(document(source->item(s)).toCaseFolded().contains(pattern))
+                    positions.push_back(s);
+            }
+        }
+        if(cancelled()) { return; }
+
+        sender.post([this, current, generation, positions]
+                    {
+                        // The model changed or a new query started meanwhile.
+                        if(current->load() != generation) { return; }
+                        m_model->set_row_filter(positions);
+                    });
+    });
+}
+
+bool
+BookmarkSearch::load(QString const& file_name, QByteArray const& fingerprint)
+{
+    ++(*m_generation);
+    // An index being built is outdated by the loaded one.
+    ++m_changes;
+    // Queries still running keep reading the previous index.
+    auto index = std::make_shared<TrigramIndex>();
+    bool ok = index->load(file_name, fingerprint)
+              && index->size() == m_model->item_count();
+    if(ok) { m_index = std::move(index); }
+    m_stale = !ok;
+    std::cout << " [INFO] Search index "
+              << (ok ? "loaded from " : "will be rebuilt, cannot use ")
+              << file_name.toStdString() << std::endl;
+    return ok;
+}
+
+bool
+BookmarkSearch::save(QString const& file_name, QByteArray const& fingerprint)
+{
+    this->build_index_now();
+    return m_index->save(file_name, fingerprint);
+}
+
+void
+BookmarkSearch::item_inserted(int position, FileBookmarkItem const& item)
+{
+    Q_UNUSED(position)
+    if(!m_stale) { m_index->append(document(item)); }
+    this->on_model_changed();
+}
+
+void
+BookmarkSearch::item_updated(int position, FileBookmarkItem const& item)
+{
+    // Probes update items without changing their text, the index ignores
+    // those updates, but a running query does not need to restart either.
+    if(!m_stale)         { m_index->update(position, document(item)); }
+    else if(m_building)  { m_updated.push_back(position); }
+    // The copy scanned until the index is ready must follow text edits.
+    if(m_snapshot && position < m_snapshot->size()
+       && document(m_snapshot->item(position)) != document(item))
+        m_snapshot.reset();
+}
+
+void
+BookmarkSearch::items_removed(std::vector<int> const& positions)
+{
+    if(!m_stale) { m_index->erase(positions); }
+    this->on_model_changed();
+}
+
+void
+BookmarkSearch::items_reset()
+{
+    // Rebuilt on demand: the index is usually loaded from disk right after
+    // the model is loaded.
+    m_stale = true;
+    m_index = std::make_shared<TrigramIndex>();
+    this->on_model_changed();
+}
+
+QString
+BookmarkSearch::document(FileBookmarkItem const& item)
+{
+    // Fields are separated by a character that never appears in queries,
+    // so that a match cannot span two fields.
+    const QChar sep{0x1F};
+    return item.uri_path() + sep + item.brief + sep + item.description;
+}
+
+std::shared_ptr<BookmarkSearch::Source const>
+BookmarkSearch::snapshot()
+{
+    // A source is already safe to read from workers.
+    if(auto source = m_model->source()) { return source; }
+    if(!m_snapshot || m_snapshot_changes != m_changes)
+    {
+        // Copies share the strings of the model.
+        std::vector<FileBookmarkItem> items;
+        items.reserve(static_cast<size_t>(m_model->item_count()));
+        for(int s = 0; s < m_model->item_count(); s++){ items.push_back(m_model->item(s)); }
+        m_snapshot = std::make_shared<ItemsSource>(std::move(items));
+        m_snapshot_changes = m_changes;
+    }
+    return m_snapshot;
+}
+
+void
+BookmarkSearch::ensure_index()
+{
+    if(!m_stale || m_building) { return; }
+    m_building = true;
+    m_updated.clear();
+    m_build_timer.start();
+    auto source  = this->snapshot();
+    auto changes = m_changes;
+    auto sender  = m_receiver.sender();
+    qxstl::concurrent::run(QThreadPool::globalInstance(), [this, source, changes, sender]
+    {
+        auto index = std::make_shared<TrigramIndex>();
+        for(int s = 0; s < source->size(); s++){ index->append(document(source->item(s))); }
+        sender.post([this, index, changes]{ this->on_index_built(index, changes); });
+    });
+}
+
+void
+BookmarkSearch::on_index_built(std::shared_ptr<TrigramIndex> index, quint64 changes)
+{
+    m_building = false;
+    // Items were inserted or removed during the build: start again.
+    if(changes != m_changes)
+    {
+        if(!m_query.isEmpty()) { this->ensure_index(); }
+        return;
+    }
+    for(int s: m_updated){ index->update(s, document(m_model->item(s))); }
+    m_updated.clear();
+    m_index = std::move(index);
+    m_stale = false;
+    m_snapshot.reset();
+    std::cout << " [INFO] Search index built in "
+              << m_build_timer.elapsed() << " ms" << std::endl;
+    // The current query ran as a scan, the result is the same.
+}
+
+void
+BookmarkSearch::build_index_now()
+{
+    if(!m_stale) { return; }
+    QElapsedTimer timer;
+    timer.start();
+    m_index = std::make_shared<TrigramIndex>();
+    auto source = this->snapshot();
+    for(int s = 0; s < source->size(); s++){ m_index->append(document(source->item(s))); }
+    m_stale = false;
+    m_snapshot.reset();
+    // A build still running is outdated.
+    ++m_changes;
+    std::cout << " [INFO] Search index built in "
+              << timer.elapsed() << " ms" << std::endl;
+}
+
+void
+BookmarkSearch::on_model_changed()
+{
+    ++m_changes;
+    ++(*m_generation);
+    if(m_query.isEmpty() || m_rerun_scheduled) { return; }
+    m_rerun_scheduled = true;
+    QTimer::singleShot(0, m_receiver.context(), [this]
+                       {
+                           m_rerun_scheduled = false;
+                           this->search(m_query);
+                       });
+}
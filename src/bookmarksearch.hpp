@@ -0,0 +1,97 @@
+#ifndef BOOKMARKSEARCH_HPP
+#define BOOKMARKSEARCH_HPP
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include <qxstl/concurrent.hpp>
+#include <qxstl/RecordTableModel.hpp>
+#include <qxstl/TrigramIndex.hpp>
+
+#include "filebookmarkitemmodel.hpp"
+
+/** Class BookmarkSearch filters the bookmark model with a substring query
+ *  over the path, brief and description of the items.
+ *
+ *  + The trigram index is kept up to date incrementally as the model
+ *    changes, and it can be saved and loaded from disk, so that it does
+ *    not need to be rebuilt at startup.
+ *
+ *  + Queries run on a worker thread. A new query cancels the one that is
+ *    still running, and only the latest result is applied to the model.
+ *
+ *  + A missing or outdated index is rebuilt on a worker thread, queries
+ *    scan the bookmarks until it is ready.
+ *************************************************************************/
+class BookmarkSearch: public qxstl::model::RecordObserver<FileBookmarkItem>
+{
+public:
+
+    explicit BookmarkSearch(FileBookmarkItemModel* model);
+    ~BookmarkSearch();
+
+    BookmarkSearch(BookmarkSearch const&) = delete;
+    BookmarkSearch& operator=(BookmarkSearch const&) = delete;
+
+    /// Show only the bookmarks containing the text, show all of them if
+    /// the text is empty.
+    void search(QString const& text);
+
+    /// Load the index saved by save(), return false if the file is missing
+    /// or does not match the current content of the model.
+    bool load(QString const& file_name, QByteArray const& fingerprint);
+
+    bool save(QString const& file_name, QByteArray const& fingerprint);
+
+    //------ RecordObserver interface -------------//
+
+    void item_inserted(int position, FileBookmarkItem const& item) override;
+    void item_updated(int position, FileBookmarkItem const& item) override;
+    void items_removed(std::vector<int> const& positions) override;
+    void items_reset() override;
+
+private:
+    using TrigramIndex = qxstl::search::TrigramIndex;
+    using Source       = qxstl::model::RecordSource<FileBookmarkItem>;
+
+    FileBookmarkItemModel*                m_model;
+    std::shared_ptr<TrigramIndex>         m_index;
+    // Incremented by every query and every change of the model, a query
+    // whose generation is not the current one is abandoned.
+    std::shared_ptr<std::atomic<quint64>> m_generation;
+    qxstl::concurrent::Receiver           m_receiver;
+    QString                               m_query;
+    // Set when the index no longer mirrors the model and must be rebuilt
+    // before the next query.
+    bool                                  m_stale;
+    bool                                  m_rerun_scheduled;
+    // Set while the index is rebuilt on a worker thread
+    bool                                  m_building;
+    // Incremented when items are inserted or removed, an index built from
+    // an older snapshot is discarded.
+    quint64                               m_changes;
+    // Positions updated during the build, applied to the new index
+    std::vector<int>                      m_updated;
+    // Copy of the items read by workers while the index is not ready,
+    // taken at the m_snapshot_changes change.
+    std::shared_ptr<Source const>         m_snapshot;
+    quint64                               m_snapshot_changes;
+    QElapsedTimer                         m_build_timer;
+
+    /// Text indexed for a bookmark
+    static QString document(FileBookmarkItem const& item);
+
+    /// Start rebuilding a stale index on a worker thread.
+    void ensure_index();
+    /// Rebuild a stale index on the calling thread.
+    void build_index_now();
+    void on_index_built(std::shared_ptr<TrigramIndex> index, quint64 changes);
+    /// Items of the model, readable from worker threads.
+    std::shared_ptr<Source const> snapshot();
+    /// Abandon running queries, whose results refer to outdated positions,
+    /// and run the current query again.
+    void on_model_changed();
+};
+
+#endif // BOOKMARKSEARCH_HPP
@@ -0,0 +1,237 @@
+#include <array>
+#include <limits>
+#include <stdexcept>
+
+#include <qxstl/serialization.hpp>
+
+#include "bookmarkstore.hpp"
+
+namespace
+{
+    constexpr quint32 store_magic   = 0x534B4251; // "QBKS" in the file
+    constexpr quint32 store_version = 1;
+    constexpr qint64  header_size   = 32;
+    constexpr qint64  row_size      = 28;
+    // Offset of the kind byte in a row
+    constexpr int     kind_offset   = 24;
+
+    using Kind   = BookmarkStore::Kind;
+    using Status = FileProbeResult::Status;
+
+    quint32 read_u32(const uchar* p) { return qFromLittleEndian<quint32>(p); }
+
+    Kind kind_of(FileBookmarkItem const& item)
+    {
+        if(!item.is_file_uri()) { return Kind::Url; }
+        switch(item.meta.status)
+        {
+        case Status::Ok:          return item.meta.item_type == "FILE" ? Kind::File : Kind::Dir;
+        case Status::Missing:     return Kind::Missing;
+        case Status::Unreachable: return Kind::Unreachable;
+        case Status::Pending:     return Kind::Pending;
+        }
+        return Kind::Pending;
+    }
+
+    // Rows of the table written at once
+    constexpr int     table_chunk   = 4096;
+
+    void open_file(QSaveFile& file)
+    {
+        if(!file.open(QIODevice::WriteOnly))
+        {
+            throw std::runtime_error(" [ERROR] Cannot write bookmark store.");
+        }
+    }
+
+    /// Write size bytes. The size is 64 bits, a mapped store may be larger
+    /// than a QByteArray.
+    void write_bytes(QSaveFile& file, const char* data, qint64 size)
+    {
+        if(file.write(data, size) != size)
+        {
+            throw std::runtime_error(" [ERROR] Cannot write bookmark store.");
+        }
+    }
+
+    void write_bytes(QSaveFile& file, QByteArray const& data)
+    {
+        write_bytes(file, data.constData(), data.size());
+    }
+
+    /// Strings of a row, in the order of the table
+    std::array<QString, 3> fields_of(FileBookmarkItem const& item)
+    {
+        return {item.uri_path(), item.brief, item.description};
+    }
+
+    void put_header(uchar* p, quint32 rows, qint64 generation, quint64 heap_offset)
+    {
+        qToLittleEndian<quint32>(store_magic,   p);
+        qToLittleEndian<quint32>(store_version, p + 4);
+        qToLittleEndian<quint32>(rows,          p + 8);
+        qToLittleEndian<quint32>(0,             p + 12);
+        qToLittleEndian<qint64>(generation,     p + 16);
+        qToLittleEndian<quint64>(heap_offset,   p + 24);
+    }
+}
+
+BookmarkStore::BookmarkStore()
+    : m_data{nullptr}
+    , m_file_size{0}
+    , m_rows{0}
+    , m_generation{0}
+    , m_heap{nullptr}
+    , m_heap_size{0}
+{
+}
+
+BookmarkStore::~BookmarkStore()
+{
+    if(m_data != nullptr) { m_file->unmap(const_cast<uchar*>(m_data)); }
+}
+
+std::shared_ptr<BookmarkStore>
+BookmarkStore::open(QString const& file_name)
+{
+    // Not make_shared: the constructor is private.
+    std::shared_ptr<BookmarkStore> store{new BookmarkStore};
+    store->m_file = std::make_unique<QFile>(file_name);
+    if(!store->m_file->open(QIODevice::ReadOnly)) { return nullptr; }
+
+    qint64 size = store->m_file->size();
+    if(size < header_size) { return nullptr; }
+    const uchar* data = store->m_file->map(0, size);
+    if(data == nullptr) { return nullptr; }
+    store->m_data      = data;
+    store->m_file_size = size;
+
+    // Only the header is validated here, rows are checked when decoded.
+    quint32 rows        = read_u32(data + 8);
+    quint64 heap_offset = qFromLittleEndian<quint64>(data + 24);
+    if(read_u32(data) != store_magic || read_u32(data + 4) != store_version
+       || heap_offset > static_cast<quint64>(size)
+       || header_size + static_cast<qint64>(rows) * row_size > static_cast<qint64>(heap_offset)
+       || rows > static_cast<quint32>(std::numeric_limits<int>::max()))
+    {
+        return nullptr;
+    }
+    store->m_rows       = static_cast<int>(rows);
+    store->m_generation = qFromLittleEndian<qint64>(data + 16);
+    store->m_heap       = data + heap_offset;
+    store->m_heap_size  = size - static_cast<qint64>(heap_offset);
+    return store;
+}
+
+void
+BookmarkStore::write(QString const& file_name, qint64 generation,
+                     std::vector<FileBookmarkItem> const& items)
+{
+    constexpr qint64 max_u32 = std::numeric_limits<quint32>::max();
+    if(static_cast<qint64>(items.size()) > max_u32)
+    {
+        throw std::runtime_error(" [ERROR] Too many bookmarks for the store.");
+    }
+    auto   rows        = static_cast<quint32>(items.size());
+    qint64 heap_offset = header_size + static_cast<qint64>(rows) * row_size;
+
+    // Streamed: the offsets of a row only depend on the strings before it,
+    // so the table is written in chunks, then the strings are encoded
+    // again for the heap. Neither is held whole in memory.
+    QSaveFile file{file_name};
+    open_file(file);
+    QByteArray header(static_cast<int>(header_size), '\0');
+    put_header(reinterpret_cast<uchar*>(header.data()), rows, generation,
+               static_cast<quint64>(heap_offset));
+    write_bytes(file, header);
+
+    QByteArray table;
+    table.reserve(static_cast<int>(table_chunk * row_size));
+    qint64 heap_size = 0;
+    for(auto const& item: items)
+    {
+        uchar row[row_size] = {};
+        int n = 0;
+        for(auto const& text: fields_of(item))
+        {
+            // Offsets are 32 bits, the heap must not wrap them.
+            if(heap_size > max_u32)
+            {
+                throw std::runtime_error(" [ERROR] Bookmark store larger than 4 GiB.");
+            }
+            auto size = static_cast<quint32>(text.toUtf8().size());
+            qToLittleEndian<quint32>(static_cast<quint32>(heap_size), row + 8 * n);
+            qToLittleEndian<quint32>(size,                            row + 8 * n + 4);
+            heap_size += size;
+            n++;
+        }
+        row[kind_offset] = static_cast<uchar>(kind_of(item));
+        table.append(reinterpret_cast<const char*>(row), static_cast<int>(row_size));
+        if(table.size() >= table_chunk * row_size) { write_bytes(file, table); table.clear(); }
+    }
+    write_bytes(file, table);
+
+    for(auto const& item: items)
+    {
+        for(auto const& text: fields_of(item)){ write_bytes(file, text.toUtf8()); }
+    }
+    qxstl::serialization::commit_save_file(file);
+}
+
+void
+BookmarkStore::copy_to(QString const& file_name, qint64 generation) const
+{
+    // Only the header changes, the rows and the heap are written from the
+    // mapping as they are.
+    QByteArray header(static_cast<int>(header_size), '\0');
+    put_header(reinterpret_cast<uchar*>(header.data()), static_cast<quint32>(m_rows),
+               generation, static_cast<quint64>(m_heap - m_data));
+    QSaveFile file{file_name};
+    open_file(file);
+    write_bytes(file, header);
+    write_bytes(file, reinterpret_cast<const char*>(m_data + header_size),
+                m_file_size - header_size);
+    qxstl::serialization::commit_save_file(file);
+}
+
+qint64
+BookmarkStore::generation() const
+{
+    return m_generation;
+}
+
+int
+BookmarkStore::size() const
+{
+    return m_rows;
+}
+
+QString
+BookmarkStore::field(const uchar* row, int n) const
+{
+    quint32 offset = read_u32(row + 8 * n);
+    quint32 size   = read_u32(row + 8 * n + 4);
+    if(static_cast<qint64>(offset) + size > m_heap_size) { return QString{}; }
+    return QString::fromUtf8(reinterpret_cast<const char*>(m_heap + offset),
+                             static_cast<int>(size));
+}
+
+FileBookmarkItem
+BookmarkStore::item(int position) const
+{
+    const uchar* row = m_data + header_size + static_cast<qint64>(position) * row_size;
+    FileBookmarkItem item{this->field(row, 0), this->field(row, 1), this->field(row, 2)};
+    item.resolve_names();
+
+    FileProbeResult result;
+    switch(static_cast<Kind>(row[kind_offset]))
+    {
+    case Kind::File:        result.status = Status::Ok; result.is_file = true;  break;
+    case Kind::Dir:         result.status = Status::Ok; result.is_file = false; break;
+    case Kind::Missing:     result.status = Status::Missing;     break;
+    case Kind::Unreachable: result.status = Status::Unreachable; break;
+    default: return item;
+    }
+    if(item.is_file_uri()) { item.apply_probe(result); }
+    return item;
+}
@@ -0,0 +1,93 @@
+#ifndef BOOKMARKSTORE_HPP
+#define BOOKMARKSTORE_HPP
+
+#include <memory>
+#include <vector>
+
+#include <QtCore>
+
+#include <qxstl/RecordTableModel.hpp>
+#include <qxstl/serialization.hpp>
+
+#include "FileBookmarkItem.hpp"
+
+/** Class BookmarkStore is a binary file of bookmarks opened with mmap, so
+ *  that loading it costs nothing until rows are read: a row is decoded
+ *  only when a view paints it, see RecordTableModel::attach().
+ *
+ *  File layout, integers are little-endian, strings are UTF-8:
+ *
+ *    header (32 bytes):
+ *      u32 magic, u32 version, u32 row count, u32 reserved,
+ *      i64 journal generation, u64 offset of the string heap
+ *
+ *    row table, one fixed-width row per bookmark (28 bytes):
+ *      u32 offset, u32 size  - uri_path, relative to the heap
+ *      u32 offset, u32 size  - brief
+ *      u32 offset, u32 size  - description
+ *      u8  kind              - last known type of the target, see Kind
+ *      u8  reserved[3]
+ *
+ *    string heap
+ *
+ *  The file is immutable once written, readers are thread-safe.
+ *************************************************************************/
+class BookmarkStore: public qxstl::model::RecordSource<FileBookmarkItem>
+{
+public:
+
+    /// Type of the target when the store was written, shown until the
+    /// target is probed again.
+    enum class Kind: quint8 { Pending = 0, File, Dir, Missing, Unreachable, Url };
+
+    /// Map a store file, return null if it is missing or invalid.
+    static std::shared_ptr<BookmarkStore> open(QString const& file_name);
+
+    /// Write items to a store file atomically. Throws on failure, or if the
+    /// strings do not fit in the 32-bit offsets of the heap.
+    static void write(QString const& file_name, qint64 generation,
+                      std::vector<FileBookmarkItem> const& items);
+
+    ~BookmarkStore();
+
+    BookmarkStore(BookmarkStore const&) = delete;
+    BookmarkStore& operator=(BookmarkStore const&) = delete;
+
+    /// Copy this store to another file, changing only the generation.
+    /// The rows are not decoded. Throws on failure.
+    void copy_to(QString const& file_name, qint64 generation) const;
+
+    /// Journal generation the store was written at
+    qint64 generation() const;
+
+    //------ RecordSource interface -------------//
+
+    int size() const override;
+    FileBookmarkItem item(int position) const override;
+
+private:
+    std::unique_ptr<QFile> m_file;
+    const uchar*           m_data;
+    qint64                 m_file_size;
+    int                    m_rows;
+    qint64                 m_generation;
+    const uchar*           m_heap;
+    qint64                 m_heap_size;
+
+    BookmarkStore();
+
+    QString field(const uchar* row, int n) const;
+};
+
+/// Order of the rows of a store set by the user, saved in the settings
+/// file next to it, see RecordTableModel::manual_order(). It does not
+/// depend on widgets, so that HeadlessCli can read it.
+struct BookmarkOrder
+{
+    std::vector<double> keys;
+
+    static constexpr auto schema = std::make_tuple(
+        qxstl::serialization::field(1, &BookmarkOrder::keys));
+};
+
+#endif // BOOKMARKSTORE_HPP
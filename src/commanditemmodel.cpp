@@ -0,0 +1,111 @@
+#include "commanditemmodel.hpp"
+
+CommandItemModel::CommandItemModel()
+    : CommandItemModel(nullptr)
+{
+}
+
+CommandItemModel::CommandItemModel(QWidget* parent)
+    : qxstl::model::RecordTableModel<ParsedCommand>(parent)
+{
+}
+
+int
+CommandItemModel::column_count() const
+{
+    return 1;
+}
+
+QString
+CommandItemModel::column_name(int column) const
+{
+    return column == 0 ? "Command" : QString{};
+}
+
+bool
+CommandItemModel::is_column_editable(int column) const
+{
+    return column == 0;
+}
+
+QString
+CommandItemModel::display_item_row(ParsedCommand const& item, int column) const
+{
+    Q_UNUSED(column)
+    return item.text;
+}
+
+QVariant
+CommandItemModel::display_item_role(ParsedCommand const& item, int column, int role) const
+{
+    Q_UNUSED(column)
+    if(role == Qt::ForegroundRole && !item.is_valid()) { return QBrush{Qt::red}; }
+    if(role == Qt::ToolTipRole) { return item.is_valid() ? item.program : item.error(); }
+    return QVariant{};
+}
+
+bool
+CommandItemModel::set_element(int column, QVariant value, ParsedCommand& item)
+{
+    QString text = value.toString();
+    if(column != 0 || text.isEmpty() || text == item.text) { return false; }
+    item = ParsedCommand::parse(text);
+    return true;
+}
+
+void
+CommandItemModel::add_command(QString const& text)
+{
+    this->add_item(ParsedCommand::parse(text));
+}
+
+void
+CommandItemModel::assign_texts(QStringList const& texts)
+{
+    ParsedCommand::ProgramCache cache;
+    std::vector<ParsedCommand> commands;
+    commands.reserve(static_cast<size_t>(texts.size()));
+    for(auto const& text: texts)
+    {
+        commands.push_back(ParsedCommand::split(text));
+        commands.back().resolve(&cache);
+    }
+    this->assign(std::move(commands));
+}
+
+QStringList
+CommandItemModel::texts() const
+{
+    QStringList list;
+    list.reserve(this->item_count());
+    for(auto const& command: *this) { list << command.text; }
+    return list;
+}
+
+int
+CommandItemModel::find(QString const& name) const
+{
+    return ParsedCommand::find(this->item_count(),
+                               [this](int s) -> ParsedCommand const& { return this->item(s); },
+                               name);
+}
+
+int
+CommandItemModel::resolve_all()
+{
+    // A new binary may shadow the resolved one, so the lookup is redone
+    // even for entries whose binary did not change.
+    ParsedCommand::ProgramCache cache;
+    int broken = 0;
+    for(auto& command: *this)
+    {
+        if(!command.resolve(&cache)) { broken++; }
+    }
+    // Only colors and tooltips change, the text and the order do not.
+    if(this->count() > 0)
+    {
+        emit this->dataChanged(this->index(0, 0), this->index(this->count() - 1, 0),
+                               {Qt::ForegroundRole, Qt::ToolTipRole});
+    }
+    return broken;
+}
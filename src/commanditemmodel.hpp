@@ -0,0 +1,59 @@
+#ifndef COMMANDITEMMODEL_HPP
+#define COMMANDITEMMODEL_HPP
+
+#include <qxstl/RecordTableModel.hpp>
+
+#include "parsedcommand.hpp"
+
+/** Class CommandItemModel holds the command registry, displayed by a
+ *  QListView and by the drop-down list of the command input.
+ *
+ *  + Commands are stored parsed and resolved, contiguously, instead of
+ *    one QListWidgetItem per entry, see RecordTableModel.
+ *
+ *  + Broken entries are shown in red, with the reason as tooltip, and
+ *    valid entries have the resolved binary as tooltip.
+ *
+ *  + Positions in insertion order are the rows of the journal records,
+ *    the view may be ranked by use without moving the items.
+ *************************************************************************/
+class CommandItemModel: public qxstl::model::RecordTableModel<ParsedCommand>
+{
+public:
+
+    CommandItemModel();
+
+    explicit CommandItemModel(QWidget* parent);
+
+    int column_count() const override;
+
+    QString column_name(int column) const override;
+
+    // Entries are edited in place when the view allows it.
+    bool is_column_editable(int column) const override;
+
+    QString display_item_row(ParsedCommand const& item, int column) const override;
+
+    QVariant display_item_role(ParsedCommand const& item, int column, int role) const override;
+
+    /// Parse and resolve the new text of an entry.
+    bool set_element(int column, QVariant value, ParsedCommand& item) override;
+
+    /// Append a command line.
+    void add_command(QString const& text);
+
+    /// Replace all entries, firing a single reset. Each binary is looked
+    /// up once for the whole registry.
+    void assign_texts(QStringList const& texts);
+
+    /// Text of the entries in insertion order, as saved in the settings.
+    QStringList texts() const;
+
+    /// Position of an entry found by ParsedCommand::find(), or -1.
+    int find(QString const& name) const;
+
+    /// Resolve all entries again, return the number of broken ones.
+    int resolve_all();
+};
+
+#endif // COMMANDITEMMODEL_HPP
@@ -1,12 +1,34 @@
+#include <qxstl/metrics.hpp>
+
 #include "filebookmarkitemmodel.hpp"
 
 FileBookmarkItemModel::FileBookmarkItemModel()
+    : FileBookmarkItemModel(nullptr)
 {
 }
 
 FileBookmarkItemModel::FileBookmarkItemModel(QWidget* parent)
-    : qxstl::model::RecordTableModel<FileBookmarkItem>(parent)
+    : RecordTableModel(parent)
 {
+    m_probe = std::make_unique<FileProbeService>(
+        [this](FileProbeService::ResultMap const& results)
+        {
+            this->on_probe_results(results);
+        });
+
+    m_watcher = new QFileSystemWatcher(this);
+
+    // The target changed: probe it again instead of resolving it here.
+    // The watch is dropped, as QFileSystemWatcher silently stops watching
+    // targets that were removed or replaced (editors saving through a
+    // rename), and it is registered again once the probe succeeds.
+    auto on_changed = [this](QString const& path)
+    {
+        if(m_watched.remove(path)) { m_watcher->removePath(path); }
+        m_probe->probe(path);
+    };
+    QObject::connect(m_watcher, &QFileSystemWatcher::fileChanged, on_changed);
+    QObject::connect(m_watcher, &QFileSystemWatcher::directoryChanged, on_changed);
 }
 
 // Constant => Returns the number of columns
@@ -39,32 +61,15 @@ FileBookmarkItemModel::is_column_editable(int column) const
 QString
 FileBookmarkItemModel::display_item_row(FileBookmarkItem const& item, int column) const
 {
-    // Check whether URI string is file or an URL, FTP ...
-    auto is_uri_file = [](QString const& uri_str)
-    {
-        return not( uri_str.startsWith("http://")
-                   || uri_str.startsWith("https://")
-                   || uri_str.startsWith("ftp://"));
-    };
+    // Note: Only cached metadata is used here, this function is called
+    // on every repaint and must not access the filesystem.
+    static auto& latency = qxstl::metrics::histogram(
+        "applauncher_display_item_row_seconds", "Time of display_item_row()");
+    qxstl::metrics::ScopedTimer timer{latency};
 
-    QString file_name = item.uri_path;
-    QString file_path;
-    QString item_type = "URL";
-
-    if(is_uri_file(item.uri_path))
-    {
-        auto info = QFileInfo{item.uri_path};
-        file_name = info.fileName();
-        file_path = info.absolutePath();
-
-        if(QFileInfo(item.uri_path).isFile())
-            item_type = "FILE";
-        else
-            item_type = "DIR";
-    }
-    if(column == 0) return item_type;
-    if(column == 1) return file_name;
-    if(column == 2) return file_path;
+    if(column == 0) return item.meta.item_type;
+    if(column == 1) return item.file_name();
+    if(column == 2) return item.file_path();
     if(column == 3) return item.brief;
 
     return QString("<EMPTY>");
@@ -75,7 +80,7 @@ FileBookmarkItemModel::set_element(int column, QVariant value, FileBookmarkItem&
 {
 #if 0
     if(column == 0){
-        item.uri_path = value.toString();
+        item.set_uri_path(value.toString());
         return true;
     }
     if(column == 1){
@@ -93,3 +98,90 @@ FileBookmarkItemModel::set_element(int column, QVariant value, FileBookmarkItem&
 
     return false;
 }
+
+void
+FileBookmarkItemModel::on_item_added(FileBookmarkItem& item)
+{
+    // Items decoded from a store keep the type known when it was saved
+    // until the probe answers.
+    if(item.meta.item_type.isEmpty()) { item.resolve_names(); }
+    if(!item.is_file_uri()) { return; }
+    QString path = item.uri_path();
+    this->watch_path(path);
+    m_probe->probe(path);
+}
+
+void
+FileBookmarkItemModel::on_item_removed(FileBookmarkItem const& item)
+{
+    if(item.is_file_uri()) { this->unwatch_path(item.uri_path()); }
+}
+
+void
+FileBookmarkItemModel::watch_path(QString const& path)
+{
+    m_watch_count[path]++;
+}
+
+void
+FileBookmarkItemModel::unwatch_path(QString const& path)
+{
+    auto it = m_watch_count.find(path);
+    if(it == m_watch_count.end()) { return; }
+    if(--it.value() > 0) { return; }
+    m_watch_count.erase(it);
+    if(m_watched.remove(path)) { m_watcher->removePath(path); }
+}
+
+void
+FileBookmarkItemModel::on_probe_results(FileProbeService::ResultMap const& results)
+{
+    // Items are matched by the node of their path, paths of the items are
+    // not rebuilt. Paths of items removed since the probe are not known,
+    // they are not interned again.
+    QHash<FileBookmarkItem::PathId, FileProbeResult const*> by_path;
+    for(auto it = results.begin(); it != results.end(); ++it)
+    {
+        auto id = FileBookmarkItem::paths().find(it.key());
+        if(id != 0) { by_path.insert(id, &it.value()); }
+    }
+
+    std::vector<int> positions;
+    if(this->has_source())
+    {
+        // Items of a store are not probed until decoded, only the rows
+        // already displayed may match. The others are not decoded.
+        for(int s = 0; s < this->count(); s++)
+        {
+            auto it = by_path.constFind(this->item(s).path_id());
+            if(it == by_path.constEnd()) { continue; }
+            this->modify_item(s, [&](FileBookmarkItem& item){ item.apply_probe(*it.value()); });
+            positions.push_back(s);
+        }
+    }
+    else
+    {
+        // Only the column of paths is scanned, matching items are rebuilt.
+        // Items hidden by a search are updated too, they are not probed
+        // again when the search ends.
+        using Layout = qxstl::model::ColumnLayout<FileBookmarkItem>;
+        auto const& path_column = this->storage().column<Layout::Path>();
+        for(size_t s = 0; s < path_column.size(); s++)
+        {
+            auto it = by_path.constFind(path_column[s]);
+            if(it == by_path.constEnd()) { continue; }
+            this->modify_item(static_cast<int>(s), [&](FileBookmarkItem& item){ item.apply_probe(*it.value()); });
+            positions.push_back(static_cast<int>(s));
+        }
+    }
+    this->refresh_items(positions);
+
+    // Only watch targets known to be reachable.
+    for(auto it = results.begin(); it != results.end(); ++it)
+    {
+        auto const& path = it.key();
+        if(it.value().status != FileProbeResult::Status::Ok) { continue; }
+        if(!m_watch_count.contains(path) || m_watched.contains(path)) { continue; }
+        if(m_watcher->addPath(path)) { m_watched.insert(path); }
+    }
+}
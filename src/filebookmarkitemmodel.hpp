@@ -2,9 +2,101 @@
 #define FILEBOOKMARKITEMMODEL_HPP
 
 #include "FileBookmarkItem.hpp"
+#include "fileprobeservice.hpp"
 #include <qxstl/RecordTableModel.hpp>
 
-class FileBookmarkItemModel: public qxstl::model::RecordTableModel<FileBookmarkItem>
+namespace qxstl::model
+{
+
+/** Columns of the bookmarks in FileBookmarkItemModel. Paths are nodes of
+ *  FileBookmarkItem::paths(), the probe status and the type are packed as
+ *  bytes and the URL flag as bits.
+ */
+template<>
+struct ColumnLayout<FileBookmarkItem>
+{
+    using PathId = FileBookmarkItem::PathId;
+
+    // Index of each field in Columns
+    enum Field { Path, IsUrl, Brief, Description, Status, Type, Canonical };
+
+    using Columns = std::tuple< std::vector<PathId>
+                              , std::vector<bool>
+                              , std::vector<QString>
+                              , std::vector<QString>
+                              , std::vector<quint8>
+                              , std::vector<quint8>
+                              , std::vector<PathId> >;
+
+    static void append(Columns& columns, FileBookmarkItem const& item)
+    {
+        std::get<Path>(columns).push_back(item.path_id());
+        std::get<IsUrl>(columns).push_back(!item.is_file_uri());
+        std::get<Brief>(columns).push_back(item.brief);
+        std::get<Description>(columns).push_back(item.description);
+        std::get<Status>(columns).push_back(static_cast<quint8>(item.meta.status));
+        std::get<Type>(columns).push_back(type_code(item.meta.item_type));
+        std::get<Canonical>(columns).push_back(item.meta.canonical_path);
+    }
+
+    static FileBookmarkItem load(Columns const& columns, std::size_t pos)
+    {
+        FileBookmarkItem item;
+        item.set_path_id(std::get<Path>(columns)[pos], std::get<IsUrl>(columns)[pos]);
+        item.brief       = std::get<Brief>(columns)[pos];
+        item.description = std::get<Description>(columns)[pos];
+        item.meta.status = static_cast<FileBookmarkMeta::Status>(std::get<Status>(columns)[pos]);
+        item.meta.item_type      = type_name(std::get<Type>(columns)[pos]);
+        item.meta.canonical_path = std::get<Canonical>(columns)[pos];
+        return item;
+    }
+
+    static void store(Columns& columns, std::size_t pos, FileBookmarkItem const& item)
+    {
+        std::get<Path>(columns)[pos]        = item.path_id();
+        std::get<IsUrl>(columns)[pos]       = !item.is_file_uri();
+        std::get<Brief>(columns)[pos]       = item.brief;
+        std::get<Description>(columns)[pos] = item.description;
+        std::get<Status>(columns)[pos]      = static_cast<quint8>(item.meta.status);
+        std::get<Type>(columns)[pos]        = type_code(item.meta.item_type);
+        std::get<Canonical>(columns)[pos]   = item.meta.canonical_path;
+    }
+
+    // Types are the literals of FileBookmarkItem::apply_probe(), 0 is the
+    // type of an item not resolved yet.
+    static QString type_name(quint8 code)
+    {
+        switch(code)
+        {
+        case 1: return QStringLiteral("FILE");
+        case 2: return QStringLiteral("DIR");
+        case 3: return QStringLiteral("URL");
+        case 4: return QStringLiteral("MISSING");
+        case 5: return QStringLiteral("UNREACHABLE");
+        case 6: return QStringLiteral("PENDING");
+        }
+        return QString{};
+    }
+
+    static quint8 type_code(QString const& type)
+    {
+        for(quint8 code = 1; code <= 6; code++)
+        {
+            if(type == type_name(code)) { return code; }
+        }
+        return 0;
+    }
+};
+
+}
+
+/** Class FileBookmarkItemModel displays the bookmarks of the Desktop
+ *  Bookmarks tab. Items are kept column by column, see ColumnLayout above,
+ *  so at() returns a copy and changes go through modify().
+ *************************************************************************/
+class FileBookmarkItemModel
+    : public qxstl::model::RecordTableModel< FileBookmarkItem
+                                           , qxstl::model::ColumnStorage<FileBookmarkItem> >
 {
 public:
 
@@ -27,6 +119,30 @@ public:
     QString display_item_row(FileBookmarkItem const& item, int column) const override;
 
     bool set_element(int column, QVariant value, FileBookmarkItem& item);
+
+protected:
+
+    void on_item_added(FileBookmarkItem& item) override;
+    void on_item_removed(FileBookmarkItem const& item) override;
+
+private:
+
+    // Resolves bookmark targets without blocking the GUI thread
+    std::unique_ptr<FileProbeService> m_probe;
+
+    // Watch bookmark targets for invalidating the cached metadata
+    QFileSystemWatcher* m_watcher;
+    // Number of bookmarks referencing each local path
+    QHash<QString, int> m_watch_count;
+    // Paths actually registered in the watcher, only reachable paths are
+    // registered since adding a watch also accesses the filesystem.
+    QSet<QString>       m_watched;
+
+    void watch_path(QString const& path);
+    void unwatch_path(QString const& path);
+
+    /// Update the metadata of all items pointing to the probed paths.
+    void on_probe_results(FileProbeService::ResultMap const& results);
 };
 
 
@@ -0,0 +1,291 @@
+#include <algorithm>
+#include <iostream>
+
+#include <qxstl/metrics.hpp>
+
+#include "fileprobeservice.hpp"
+
+namespace
+{
+    // Consecutive timeouts that open the circuit breaker of a mount point.
+    constexpr int breaker_threshold   = 3;
+    // Time during which an open breaker rejects probes.
+    constexpr int breaker_cooldown_ms = 30000;
+    // Results are coalesced during this time before being delivered.
+    constexpr int flush_delay_ms      = 50;
+    // Probes of a mount point running at once
+    constexpr int mount_concurrency   = 2;
+
+    // Decode octal escapes, such as '\040' for space, used by /proc/self/mounts
+    QString decode_mount_field(QByteArray const& field)
+    {
+        QByteArray out;
+        out.reserve(field.size());
+        for(int i = 0; i < field.size(); i++)
+        {
+            if(field[i] == '\\' && i + 3 < field.size())
+            {
+                bool ok = false;
+                int code = field.mid(i + 1, 3).toInt(&ok, 8);
+                if(ok)
+                {
+                    out.append(static_cast<char>(code));
+                    i += 3;
+                    continue;
+                }
+            }
+            out.append(field[i]);
+        }
+        return QString::fromLocal8Bit(out);
+    }
+}
+
+FileProbeService::FileProbeService(Callback callback)
+    : m_pool{new QThreadPool}
+    , m_callback{std::move(callback)}
+    , m_deadline_ms{2000}
+    , m_flush_scheduled{false}
+{
+    // Note: The thread pool is never deleted on purpose. A thread blocked
+    // in stat() on a hung mount point cannot be joined, and QThreadPool's
+    // destructor would wait for it, freezing the application on exit.
+    m_pool->setMaxThreadCount(8);
+
+    m_sweep_timer = new QTimer(m_receiver.context());
+    m_sweep_timer->setInterval(std::max(m_deadline_ms / 4, 10));
+    QObject::connect(m_sweep_timer, &QTimer::timeout,
+                     [this]{ this->check_deadlines(); });
+
+    this->load_mount_table();
+}
+
+FileProbeService::~FileProbeService()
+{
+    // Results posted by worker threads from now on are discarded by
+    // the receiver.
+}
+
+void
+FileProbeService::set_deadline(int milliseconds)
+{
+    m_deadline_ms = milliseconds;
+    m_sweep_timer->setInterval(std::max(m_deadline_ms / 4, 10));
+}
+
+void
+FileProbeService::probe(QString const& path)
+{
+    // Coalesce with the probe already running, even when it has timed out,
+    // as its thread may still be blocked on the filesystem.
+    if(m_inflight.contains(path)) { return; }
+
+    qint64   now     = QDateTime::currentMSecsSinceEpoch();
+    QString  mount   = this->mount_point(path);
+    Breaker& breaker = m_breakers[mount];
+
+    if(breaker.open_until != 0)
+    {
+        if(now < breaker.open_until || breaker.trial)
+        {
+            static auto& rejected = qxstl::metrics::counter(
+                "applauncher_probe_rejected_total",
+                "Probes answered Unreachable by an open circuit breaker");
+            rejected.add();
+            FileProbeResult result;
+            result.status = FileProbeResult::Status::Unreachable;
+            this->deliver(path, result);
+            return;
+        }
+        // Cool-down elapsed: let a single trial probe through.
+        breaker.trial = true;
+        breaker.open->store(false);
+    }
+
+    m_inflight.insert(path, InFlight{mount, now, false, false});
+    if(!m_sweep_timer->isActive()) { m_sweep_timer->start(); }
+
+    if(breaker.running < mount_concurrency)
+    {
+        this->start_probe(path, breaker);
+        return;
+    }
+    m_inflight[path].queued = true;
+    breaker.waiting.enqueue(path);
+}
+
+void
+FileProbeService::start_probe(QString const& path, Breaker& breaker)
+{
+    breaker.running++;
+    m_inflight[path].queued = false;
+
+    auto sender = m_receiver.sender();
+    auto open   = breaker.open;
+    qxstl::concurrent::run(m_pool, [this, sender, path, open]
+    {
+        // The breaker opened while the probe waited for a thread.
+        if(open->load())
+        {
+            FileProbeResult result;
+            result.status = FileProbeResult::Status::Unreachable;
+            sender.post([this, path, result]{ this->on_probe_finished(path, result, false); });
+            return;
+        }
+        static auto& latency = qxstl::metrics::histogram(
+            "applauncher_probe_seconds", "Time of a filesystem probe");
+        FileProbeResult result;
+        {
+            qxstl::metrics::ScopedTimer timer{latency};
+            QFileInfo info{path};
+            if(info.exists())
+            {
+                result.status         = FileProbeResult::Status::Ok;
+                result.is_file        = info.isFile();
+                result.canonical_path = info.canonicalFilePath();
+            }
+            else
+            {
+                result.status = FileProbeResult::Status::Missing;
+            }
+        }
+
+        // Note: 'this' is only dereferenced on the receiver thread, and
+        // only while the service is alive.
+        sender.post([this, path, result]{ this->on_probe_finished(path, result, true); });
+    });
+}
+
+void
+FileProbeService::start_waiting(QString const& mount)
+{
+    Breaker& breaker = m_breakers[mount];
+    while(breaker.running < mount_concurrency && !breaker.waiting.isEmpty())
+    {
+        this->start_probe(breaker.waiting.dequeue(), breaker);
+    }
+}
+
+void
+FileProbeService::drop_waiting(Breaker& breaker)
+{
+    FileProbeResult result;
+    result.status = FileProbeResult::Status::Unreachable;
+    while(!breaker.waiting.isEmpty())
+    {
+        QString path = breaker.waiting.dequeue();
+        m_inflight.remove(path);
+        this->deliver(path, result);
+    }
+}
+
+QString
+FileProbeService::mount_point(QString const& path) const
+{
+    QString abs_path = QDir::cleanPath(QDir::current().absoluteFilePath(path));
+    for(auto const& mount: m_mounts)
+    {
+        if(mount == "/" || abs_path == mount || abs_path.startsWith(mount + "/"))
+            return mount;
+    }
+    return QDir::rootPath();
+}
+
+void
+FileProbeService::load_mount_table()
+{
+    // Reading the mount table does not touch any mounted filesystem,
+    // unlike QStorageInfo, which calls statvfs() on every volume.
+    QFile file("/proc/self/mounts");
+    if(file.open(QIODevice::ReadOnly))
+    {
+        for(auto const& line: file.readAll().split('\n'))
+        {
+            auto fields = line.split(' ');
+            if(fields.size() < 2) { continue; }
+            m_mounts << decode_mount_field(fields[1]);
+        }
+    }
+    if(m_mounts.isEmpty()) { m_mounts << QDir::rootPath(); }
+
+    std::sort(m_mounts.begin(), m_mounts.end(),
+              [](QString const& a, QString const& b){ return a.size() > b.size(); });
+}
+
+void
+FileProbeService::on_probe_finished(QString const& path, FileProbeResult const& result,
+                                    bool probed)
+{
+    auto it = m_inflight.find(path);
+    if(it == m_inflight.end()) { return; }
+
+    QString  mount   = it->mount;
+    Breaker& breaker = m_breakers[mount];
+    breaker.running--;
+    // A late answer still proves that the mount point is alive, but only
+    // an answer within the deadline closes the breaker.
+    if(probed && !it->timed_out)
+    {
+        breaker.consecutive_timeouts = 0;
+        breaker.open_until           = 0;
+        breaker.trial                = false;
+        breaker.open->store(false);
+    }
+    m_inflight.erase(it);
+
+    this->deliver(path, result);
+    this->start_waiting(mount);
+    if(m_inflight.isEmpty()) { m_sweep_timer->stop(); }
+}
+
+void
+FileProbeService::check_deadlines()
+{
+    qint64 now = QDateTime::currentMSecsSinceEpoch();
+    // Mount points whose breaker opened, their queues are dropped after
+    // the scan, which must not erase entries.
+    QStringList opened;
+    for(auto it = m_inflight.begin(); it != m_inflight.end(); ++it)
+    {
+        if(it->timed_out || now - it->started < m_deadline_ms) { continue; }
+        it->timed_out = true;
+
+        Breaker& breaker = m_breakers[it->mount];
+        breaker.consecutive_timeouts++;
+        if(breaker.trial || breaker.consecutive_timeouts >= breaker_threshold)
+        {
+            if(breaker.open_until == 0 || breaker.trial)
+            {
+                std::cerr << " [WARN] Mount point not responding, probes suspended: "
+                          << it->mount.toStdString() << std::endl;
+            }
+            breaker.open_until = now + breaker_cooldown_ms;
+            breaker.trial      = false;
+            breaker.open->store(true);
+            opened << it->mount;
+        }
+
+        FileProbeResult result;
+        result.status = FileProbeResult::Status::Unreachable;
+        this->deliver(it.key(), result);
+    }
+    for(auto const& mount: opened){ this->drop_waiting(m_breakers[mount]); }
+    if(m_inflight.isEmpty()) { m_sweep_timer->stop(); }
+}
+
+void
+FileProbeService::deliver(QString const& path, FileProbeResult const& result)
+{
+    m_results.insert(path, result);
+    if(m_flush_scheduled) { return; }
+    m_flush_scheduled = true;
+    QTimer::singleShot(flush_delay_ms, m_receiver.context(), [this]{ this->flush_results(); });
+}
+
+void
+FileProbeService::flush_results()
+{
+    m_flush_scheduled = false;
+    ResultMap results;
+    std::swap(results, m_results);
+    if(m_callback) { m_callback(results); }
+}
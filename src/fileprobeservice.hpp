@@ -0,0 +1,132 @@
+#ifndef FILEPROBESERVICE_HPP
+#define FILEPROBESERVICE_HPP
+
+#include <atomic>
+#include <functional>
+#include <memory>
+
+#include <QtCore>
+
+#include <qxstl/concurrent.hpp>
+
+/** Answer of a filesystem probe. */
+struct FileProbeResult
+{
+    enum class Status
+    {
+        // The probe did not answer yet.
+        Pending,
+        // The target exists.
+        Ok,
+        // The target does not exist.
+        Missing,
+        // The probe missed its deadline or the mount point is failing.
+        Unreachable
+    };
+
+    Status  status = Status::Pending;
+    bool    is_file = false;
+    QString canonical_path;
+};
+
+/** Class FileProbeService runs stat() and existence checks on a background
+ *  thread pool, so that a hung network mount (NFS, SMB ...) cannot freeze
+ *  the GUI thread.
+ *
+ *  + Every probe has a deadline. When it expires, the path is reported as
+ *    unreachable; if the probe answers later, the late answer is reported
+ *    as well.
+ *
+ *  + Mount points have a circuit breaker. After several consecutive
+ *    timeouts, probes to paths on that mount point are answered as
+ *    unreachable right away, without touching the filesystem, until a
+ *    cool-down period elapses. Then a single probe is let through for
+ *    checking whether the mount point recovered.
+ *
+ *  + At most two probes per mount point run at once, the others wait in a
+ *    queue of the mount point. A hung mount point thus blocks two threads
+ *    of the pool, not all of them. Waiting probes are answered as
+ *    unreachable when the breaker opens, and a probe that reaches a
+ *    thread after that does not touch the filesystem.
+ *
+ *  Results are delivered in batches on the thread owning the service.
+ *************************************************************************/
+class FileProbeService
+{
+public:
+    using ResultMap = QHash<QString, FileProbeResult>;
+    using Callback  = std::function<void (ResultMap const& results)>;
+
+    explicit FileProbeService(Callback callback);
+    ~FileProbeService();
+
+    FileProbeService(FileProbeService const&) = delete;
+    FileProbeService& operator=(FileProbeService const&) = delete;
+
+    /// Maximum time a probe may take before the path is deemed unreachable.
+    void set_deadline(int milliseconds);
+
+    /// Request the status of a path. Requests for a path that is already
+    /// being probed are coalesced.
+    void probe(QString const& path);
+
+    /// Return the mount point containing the path, it does not access
+    /// the filesystem.
+    QString mount_point(QString const& path) const;
+
+private:
+    struct Breaker
+    {
+        int    consecutive_timeouts = 0;
+        // Time, in ms since epoch, until which the breaker stays open.
+        qint64 open_until = 0;
+        // Set when a trial probe was let through the open breaker.
+        bool   trial = false;
+        // Read by the worker threads before touching the filesystem
+        std::shared_ptr<std::atomic<bool>> open = std::make_shared<std::atomic<bool>>(false);
+        // Probes submitted to the pool, including those that timed out
+        // and may still be blocked on the filesystem.
+        int    running = 0;
+        // Probes waiting for a running one to finish
+        QQueue<QString> waiting;
+    };
+
+    struct InFlight
+    {
+        QString mount;
+        // Time, in ms since epoch, when the probe was requested.
+        qint64  started = 0;
+        bool    timed_out = false;
+        // Set while the probe waits in the queue of its mount point
+        bool    queued = false;
+    };
+
+    // Receives results posted by the worker threads
+    qxstl::concurrent::Receiver m_receiver;
+    QThreadPool*             m_pool;
+    QTimer*                  m_sweep_timer;
+    Callback                 m_callback;
+    int                      m_deadline_ms;
+
+    // Mount points sorted from the longest to the shortest path.
+    QStringList              m_mounts;
+    QHash<QString, InFlight> m_inflight;
+    QHash<QString, Breaker>  m_breakers;
+    ResultMap                m_results;
+    bool                     m_flush_scheduled;
+
+    void load_mount_table();
+    void start_probe(QString const& path, Breaker& breaker);
+    /// Submit the probes waiting for a free slot of the mount point.
+    void start_waiting(QString const& mount);
+    /// Answer the probes waiting on a mount point whose breaker opened.
+    void drop_waiting(Breaker& breaker);
+    /// @param probed - False if the filesystem was not accessed because
+    ///                 the breaker opened meanwhile
+    void on_probe_finished(QString const& path, FileProbeResult const& result, bool probed);
+    void check_deadlines();
+    void deliver(QString const& path, FileProbeResult const& result);
+    void flush_results();
+};
+
+#endif // FILEPROBESERVICE_HPP
@@ -0,0 +1,311 @@
+#include <algorithm>
+#include <cstring>
+
+#include "fuzzymatcher.hpp"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#  define FUZZYMATCHER_X86_SIMD 1
+#  include <immintrin.h>
+#endif
+
+namespace
+{
+    // Scoring constants, same magnitudes as fzf
+    constexpr int score_match        = 16;
+    constexpr int score_gap_start    = -3;
+    constexpr int score_gap_extend   = -1;
+    constexpr int bonus_boundary     = 8;
+    constexpr int bonus_camel        = 7;
+    constexpr int bonus_consecutive  = 4;
+    // The bonus of the first pattern character counts twice
+    constexpr int bonus_first_factor = 2;
+
+    enum class CharClass { NonWord, Lower, Upper, Number };
+
+    inline char to_lower(char c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+    }
+
+    inline CharClass char_class(char c)
+    {
+        if(c >= 'a' && c <= 'z') { return CharClass::Lower;  }
+        if(c >= 'A' && c <= 'Z') { return CharClass::Upper;  }
+        if(c >= '0' && c <= '9') { return CharClass::Number; }
+        // Bytes of multi-byte UTF-8 sequences are treated as letters
+        if(static_cast<unsigned char>(c) >= 0x80) { return CharClass::Lower; }
+        return CharClass::NonWord;
+    }
+
+    inline int position_bonus(CharClass prev, CharClass cur)
+    {
+        if(prev == CharClass::NonWord && cur != CharClass::NonWord)
+            return bonus_boundary;
+        if(prev == CharClass::Lower && cur == CharClass::Upper)
+            return bonus_camel;
+        if(prev != CharClass::Number && cur == CharClass::Number)
+            return bonus_camel;
+        return 0;
+    }
+
+    // Bit of the character set mask for a lower-cased byte
+    inline uint64_t char_bit(char c)
+    {
+        auto u = static_cast<unsigned char>(c);
+        if(u >= 'a' && u <= 'z') { return uint64_t{1} << (u - 'a'); }
+        if(u >= '0' && u <= '9') { return uint64_t{1} << (26 + u - '0'); }
+        return uint64_t{1} << (36 + u % 28);
+    }
+
+    uint64_t char_mask(const char* first, const char* last)
+    {
+        uint64_t mask = 0;
+        for(; first != last; ++first){ mask |= char_bit(*first); }
+        return mask;
+    }
+
+    //---------- Byte search kernels of the prefilter -----------------//
+
+    const char* find_scalar(const char* first, const char* last, char ch)
+    {
+        for(; first != last; ++first){ if(*first == ch) { return first; } }
+        return last;
+    }
+
+#if FUZZYMATCHER_X86_SIMD
+
+    __attribute__((target("sse4.2")))
+    const char* find_sse42(const char* first, const char* last, char ch)
+    {
+        const __m128i needle = _mm_set1_epi8(ch);
+        while(last - first >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(first));
+            // Index of the first byte of chunk equal to any byte of needle,
+            // 16 when there is none.
+            int i = _mm_cmpestri(needle, 1, chunk, 16,
+                                 _SIDD_UBYTE_OPS | _SIDD_CMP_EQUAL_ANY
+                                 | _SIDD_LEAST_SIGNIFICANT);
+            if(i < 16) { return first + i; }
+            first += 16;
+        }
+        return find_scalar(first, last, ch);
+    }
+
+    __attribute__((target("avx2")))
+    const char* find_avx2(const char* first, const char* last, char ch)
+    {
+        const __m256i needle = _mm256_set1_epi8(ch);
+        while(last - first >= 32)
+        {
+            __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(first));
+            auto mask = static_cast<uint32_t>(
+                _mm256_movemask_epi8(_mm256_cmpeq_epi8(chunk, needle)));
+            if(mask != 0) { return first + __builtin_ctz(mask); }
+            first += 32;
+        }
+        return find_scalar(first, last, ch);
+    }
+
+#endif
+}
+
+FuzzyMatcher::FuzzyMatcher()
+{
+    this->set_isa(detected_isa());
+}
+
+FuzzyMatcher::Isa
+FuzzyMatcher::detected_isa()
+{
+#if FUZZYMATCHER_X86_SIMD
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2"))   { return Isa::AVX2;  }
+    if(__builtin_cpu_supports("sse4.2")) { return Isa::SSE42; }
+#endif
+    return Isa::Scalar;
+}
+
+void
+FuzzyMatcher::set_isa(Isa isa)
+{
+    m_isa  = std::min(isa, detected_isa());
+    m_find = &find_scalar;
+#if FUZZYMATCHER_X86_SIMD
+    if(m_isa == Isa::AVX2)  { m_find = &find_avx2;  }
+    if(m_isa == Isa::SSE42) { m_find = &find_sse42; }
+#endif
+}
+
+FuzzyMatcher::Isa
+FuzzyMatcher::isa() const
+{
+    return m_isa;
+}
+
+void
+FuzzyMatcher::set_candidates(std::vector<std::string> const& candidates)
+{
+    m_text.clear();
+    m_lower.clear();
+    m_offsets.assign(1, 0);
+    m_masks.clear();
+    m_masks.reserve(candidates.size());
+    for(auto const& c: candidates)
+    {
+        m_text += c;
+        m_offsets.push_back(static_cast<uint32_t>(m_text.size()));
+    }
+    m_lower.resize(m_text.size());
+    std::transform(m_text.begin(), m_text.end(), m_lower.begin(), to_lower);
+    for(size_t i = 0; i + 1 < m_offsets.size(); i++)
+    {
+        const char* p = m_lower.data();
+        m_masks.push_back(char_mask(p + m_offsets[i], p + m_offsets[i + 1]));
+    }
+}
+
+int
+FuzzyMatcher::size() const
+{
+    return static_cast<int>(m_masks.size());
+}
+
+bool
+FuzzyMatcher::is_subsequence(std::string const& lower_pattern, int candidate) const
+{
+    const char* first = m_lower.data() + m_offsets[candidate];
+    const char* last  = m_lower.data() + m_offsets[candidate + 1];
+    for(char ch: lower_pattern)
+    {
+        first = m_find(first, last, ch);
+        if(first == last) { return false; }
+        ++first;
+    }
+    return true;
+}
+
+std::vector<int>
+FuzzyMatcher::prefilter(std::string const& pattern) const
+{
+    std::string lower(pattern.size(), '\0');
+    std::transform(pattern.begin(), pattern.end(), lower.begin(), to_lower);
+    uint64_t mask = char_mask(lower.data(), lower.data() + lower.size());
+
+    std::vector<int> result;
+    int n = this->size();
+    for(int i = 0; i < n; i++)
+    {
+        if((m_masks[i] & mask) != mask) { continue; }
+        if(this->is_subsequence(lower, i)) { result.push_back(i); }
+    }
+    return result;
+}
+
+std::vector<FuzzyMatcher::Match>
+FuzzyMatcher::match(std::string const& pattern, size_t limit) const
+{
+    std::string lower(pattern.size(), '\0');
+    std::transform(pattern.begin(), pattern.end(), lower.begin(), to_lower);
+
+    std::vector<Match> matches;
+    for(int i: this->prefilter(pattern))
+    {
+        size_t offset = m_offsets[i];
+        size_t size   = m_offsets[i + 1] - offset;
+        int s = score_range(lower, m_text.data() + offset, m_lower.data() + offset, size);
+        if(s >= 0 || lower.empty()) { matches.push_back(Match{i, s}); }
+    }
+
+    // Best score first, then the shortest candidate, then insertion order.
+    auto better = [this](Match const& a, Match const& b)
+    {
+        if(a.score != b.score) { return a.score > b.score; }
+        auto len_a = m_offsets[a.index + 1] - m_offsets[a.index];
+        auto len_b = m_offsets[b.index + 1] - m_offsets[b.index];
+        if(len_a != len_b) { return len_a < len_b; }
+        return a.index < b.index;
+    };
+    size_t k = std::min(limit, matches.size());
+    std::partial_sort(matches.begin(), matches.begin() + k, matches.end(), better);
+    matches.resize(k);
+    return matches;
+}
+
+int
+FuzzyMatcher::score(std::string const& pattern, std::string const& candidate)
+{
+    std::string lower_pattern(pattern.size(), '\0');
+    std::transform(pattern.begin(), pattern.end(), lower_pattern.begin(), to_lower);
+    std::string lower(candidate.size(), '\0');
+    std::transform(candidate.begin(), candidate.end(), lower.begin(), to_lower);
+    return score_range(lower_pattern, candidate.data(), lower.data(), candidate.size());
+}
+
+/** Score the shortest window of the candidate matching the pattern.
+ *  The window is found like in fzf's v1 algorithm: a forward scan finds the
+ *  end of the first occurrence, and a backward scan from there finds the
+ *  latest possible start.
+ */
+int
+FuzzyMatcher::score_range(std::string const& lower_pattern,
+                          const char* text, const char* lower, size_t size)
+{
+    size_t m = lower_pattern.size();
+    if(m == 0) { return 0; }
+
+    size_t pidx = 0, end = 0;
+    for(size_t i = 0; i < size; i++)
+    {
+        if(lower[i] != lower_pattern[pidx]) { continue; }
+        if(++pidx == m) { end = i + 1; break; }
+    }
+    if(pidx != m) { return -1; }
+
+    size_t start = end;
+    pidx = m;
+    while(pidx > 0)
+    {
+        --start;
+        if(lower[start] == lower_pattern[pidx - 1]) { --pidx; }
+    }
+
+    int  score       = 0;
+    int  consecutive = 0;
+    int  first_bonus = 0;
+    bool in_gap      = false;
+    auto prev_class  = start > 0 ? char_class(text[start - 1]) : CharClass::NonWord;
+    pidx = 0;
+    for(size_t i = start; i < end; i++)
+    {
+        auto cls = char_class(text[i]);
+        if(pidx < m && lower[i] == lower_pattern[pidx])
+        {
+            int bonus = position_bonus(prev_class, cls);
+            if(consecutive == 0)
+            {
+                first_bonus = bonus;
+            }
+            else
+            {
+                // A boundary inside a chunk of consecutive matches starts
+                // a new chunk.
+                if(bonus >= bonus_boundary && bonus > first_bonus) { first_bonus = bonus; }
+                bonus = std::max({bonus, first_bonus, bonus_consecutive});
+            }
+            score += score_match + (pidx == 0 ? bonus * bonus_first_factor : bonus);
+            in_gap = false;
+            consecutive++;
+            pidx++;
+        }
+        else
+        {
+            score += in_gap ? score_gap_extend : score_gap_start;
+            in_gap = true;
+            consecutive = 0;
+            first_bonus = 0;
+        }
+        prev_class = cls;
+    }
+    return std::max(score, 0);
+}
@@ -0,0 +1,80 @@
+#ifndef FUZZYMATCHER_HPP
+#define FUZZYMATCHER_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/** Class FuzzyMatcher ranks candidate strings against a pattern typed by
+ *  the user, like fzf: the pattern characters must appear in the candidate
+ *  in the same order, but not necessarily contiguously. Matching is
+ *  case-insensitive for ASCII characters.
+ *
+ *  Scoring rewards matches at word boundaries ("/usr/bin/[g]it"), at
+ *  camelCase humps ("make[T]arget") and consecutive matches, and penalizes
+ *  gaps between matched characters.
+ *
+ *  Candidates that do not contain the pattern as a subsequence are
+ *  discarded by a prefilter before scoring. The prefilter checks a
+ *  character-set mask and then locates the pattern characters with
+ *  SSE4.2 or AVX2 instructions, chosen at runtime according to the CPU,
+ *  with a portable scalar fallback.
+ *************************************************************************/
+class FuzzyMatcher
+{
+public:
+
+    /// Instruction sets used by the prefilter.
+    enum class Isa { Scalar, SSE42, AVX2 };
+
+    struct Match
+    {
+        // Position of the candidate passed to set_candidates()
+        int index;
+        int score;
+    };
+
+    FuzzyMatcher();
+
+    /// Replace the candidates, strings are UTF-8 encoded.
+    void set_candidates(std::vector<std::string> const& candidates);
+
+    int size() const;
+
+    /// Return the best matches, sorted by descending score.
+    std::vector<Match> match(std::string const& pattern, size_t limit) const;
+
+    /// Return only the candidates passing the prefilter, without scoring.
+    std::vector<int> prefilter(std::string const& pattern) const;
+
+    /// Score a single candidate, return a negative value if it does not match.
+    static int score(std::string const& pattern, std::string const& candidate);
+
+    /// Best instruction set supported by the CPU.
+    static Isa detected_isa();
+
+    /// Select the instruction set of the prefilter, for benchmarks. It is
+    /// clamped to the one supported by the CPU.
+    void set_isa(Isa isa);
+
+    Isa isa() const;
+
+private:
+    using FindFunc = const char* (*)(const char* first, const char* last, char ch);
+
+    // Candidates stored contiguously, original and lower-cased text.
+    std::string              m_text;
+    std::string              m_lower;
+    std::vector<uint32_t>    m_offsets;
+    // Bitmask of the character classes present in each candidate
+    std::vector<uint64_t>    m_masks;
+    Isa                      m_isa;
+    FindFunc                 m_find;
+
+    bool is_subsequence(std::string const& lower_pattern, int candidate) const;
+
+    static int score_range(std::string const& lower_pattern,
+                           const char* text, const char* lower, size_t size);
+};
+
+#endif // FUZZYMATCHER_HPP
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <iostream>
+
+#include <qxstl/serialization.hpp>
+
+#include "bookmarkstore.hpp"
+#include "headlesscli.hpp"
+#include "launchengine.hpp"
+#include "launchersnapshot.hpp"
+#include "persistenceservice.hpp"
+#include "settingsjournal.hpp"
+#include "usagelog.hpp"
+
+namespace
+{
+    /// Program opening a file or URL with the application chosen by the
+    /// desktop, and its arguments before the target.
+    QStringList desktop_opener()
+    {
+#if defined(Q_OS_MACOS)
+        return {"open"};
+#elif defined(Q_OS_WIN)
+        return {"cmd", "/c", "start", ""};
+#else
+        return {"xdg-open"};
+#endif
+    }
+}
+
+HeadlessCli::HeadlessCli(QString settings_file)
+    : m_settings_file{std::move(settings_file)}
+{
+}
+
+QString
+HeadlessCli::sibling_file(QString const& suffix) const
+{
+    QFileInfo info{m_settings_file};
+    return info.absolutePath() + "/" + info.completeBaseName() + suffix;
+}
+
+bool
+HeadlessCli::load()
+{
+    PersistenceService::SnapshotInfo info;
+    LauncherSnapshot launcher;
+    // Not used, the bookmarks are listed in insertion order.
+    BookmarkOrder order;
+    if(QFile::exists(m_settings_file))
+    {
+        qxstl::serialization::SchemaFileReader reader(m_settings_file);
+        if(!reader.is_schema())
+        {
+            std::cerr << " [ERROR] Settings file has a former format, start the"
+                      << " launcher once to convert it." << std::endl;
+            return false;
+        }
+        if(reader.version() > PersistenceService::settings_format_version)
+        {
+            std::cerr << " [ERROR] Settings file written by a newer version "
+                      << reader.version() << std::endl;
+            return false;
+        }
+        if(!reader(launcher) || (reader.version() >= 2 && !reader(order)) || !reader(info))
+        {
+            std::cerr << " [ERROR] Settings file is corrupt, version "
+                      << reader.version() << std::endl;
+            return false;
+        }
+    }
+    QStringList registry = launcher.app_registry;
+
+    qint64 bookmark_generation = info.journal_generation;
+    if(auto store = BookmarkStore::open(this->sibling_file(".qbk")))
+    {
+        bookmark_generation = store->generation();
+        m_bookmarks.reserve(static_cast<size_t>(store->size()));
+        for(int i = 0; i < store->size(); i++) { m_bookmarks.push_back(store->item(i)); }
+    }
+
+    // Same rules as AppMainWindow::apply_journal_record()
+    using Type = JournalRecord::Type;
+    auto apply = [&](JournalRecord const& change, qint64 generation)
+    {
+        auto const& v = change.values;
+        if(change.is_bookmark())
+        {
+            if(generation < bookmark_generation) { return; }
+            int n = static_cast<int>(m_bookmarks.size());
+            if(change.type == Type::BookmarkInsert && v.size() == 3)
+            {
+                m_bookmarks.emplace_back(v[0], v[1], v[2]);
+                return;
+            }
+            if(change.row < 0 || change.row >= n) { return; }
+            auto it = m_bookmarks.begin() + change.row;
+            if(change.type == Type::BookmarkRemove) { m_bookmarks.erase(it); }
+            // Only the brief column is editable, see FileBookmarkItemModel
+            if(change.type == Type::BookmarkSetField && v.size() == 1 && change.column == 3)
+            {
+                it->brief = v[0];
+            }
+            return;
+        }
+        if(generation < info.journal_generation) { return; }
+        int n = registry.size();
+        if(change.type == Type::RegistryInsert && v.size() == 1
+           && change.row >= 0 && change.row <= n)
+        {
+            registry.insert(change.row, v[0]);
+            return;
+        }
+        if(change.row < 0 || change.row >= n) { return; }
+        if(change.type == Type::RegistryRemove) { registry.removeAt(change.row); }
+        if(change.type == Type::RegistrySet && v.size() == 1) { registry[change.row] = v[0]; }
+    };
+    SettingsJournal::read(this->sibling_file(".qjournal"),
+                          std::min(info.journal_generation, bookmark_generation), apply);
+
+    m_commands.reserve(static_cast<size_t>(registry.size()));
+    for(auto const& text: registry) { m_commands.push_back(ParsedCommand::split(text)); }
+    return true;
+}
+
+int
+HeadlessCli::list(std::ostream& out) const
+{
+    for(size_t r = 0; r < m_commands.size(); r++)
+    {
+        out << "command\t" << r << "\t" << m_commands[r].text.toStdString() << "\n";
+    }
+    for(size_t r = 0; r < m_bookmarks.size(); r++)
+    {
+        auto const& b = m_bookmarks[r];
+        out << "bookmark\t" << r << "\t" << b.uri_path().toStdString()
+            << "\t" << b.brief.toStdString() << "\n";
+    }
+    out.flush();
+    return 0;
+}
+
+int
+HeadlessCli::run(QString const& name) const
+{
+    int row = ParsedCommand::find(m_commands, name);
+    if(row < 0)
+    {
+        std::cerr << " [ERROR] No registry entry " << name.toStdString() << std::endl;
+        return 1;
+    }
+    ParsedCommand command = m_commands[static_cast<size_t>(row)];
+    command.resolve();
+    LaunchRecord record = LaunchEngine::spawn_now(command);
+    if(record.state == LaunchRecord::State::Failed)
+    {
+        std::cerr << " [ERROR] Cannot run " << command.text.toStdString() << ": "
+                  << record.error.toStdString() << std::endl;
+        return 1;
+    }
+    UsageLog::append(this->sibling_file(".qusage"), UsageLog::Kind::Command, command.text);
+    return 0;
+}
+
+int
+HeadlessCli::open_bookmark(QString const& pattern) const
+{
+    auto contains = [&](QString const& s){ return s.contains(pattern, Qt::CaseInsensitive); };
+    for(auto const& b: m_bookmarks)
+    {
+        if(!contains(b.uri_path()) && !contains(b.brief) && !contains(b.description)) { continue; }
+        ParsedCommand command = ParsedCommand::from_argv(desktop_opener() << b.uri_path());
+        command.resolve();
+        LaunchRecord record = LaunchEngine::spawn_now(command);
+        if(record.state == LaunchRecord::State::Failed)
+        {
+            std::cerr << " [ERROR] Cannot open " << b.uri_path().toStdString() << ": "
+                      << record.error.toStdString() << std::endl;
+            return 1;
+        }
+        UsageLog::append(this->sibling_file(".qusage"), UsageLog::Kind::Bookmark, b.uri_path());
+        return 0;
+    }
+    std::cerr << " [ERROR] No bookmark matches " << pattern.toStdString() << std::endl;
+    return 1;
+}
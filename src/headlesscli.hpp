@@ -0,0 +1,64 @@
+#ifndef HEADLESSCLI_HPP
+#define HEADLESSCLI_HPP
+
+#include <iosfwd>
+#include <memory>
+#include <vector>
+
+#include <QtCore>
+
+#include "FileBookmarkItem.hpp"
+#include "parsedcommand.hpp"
+
+/** Class HeadlessCli runs the command line modes meant for scripts, such
+ *  as shell aliases and dmenu/rofi menus:
+ *
+ *    --list                   print the registry and the bookmarks
+ *    --run <name>             run a registry entry, see ParsedCommand::find()
+ *    --open-bookmark <text>   open the first bookmark containing the text
+ *
+ *  They only need a QCoreApplication. The state is read straight from the
+ *  files written by the GUI: the settings file through the schema reader,
+ *  the bookmark store, and the journal of changes made since, which is
+ *  read without being modified, so that a running instance is not
+ *  disturbed. No form, widget or search index is ever loaded.
+ *************************************************************************/
+class HeadlessCli
+{
+public:
+    explicit HeadlessCli(QString settings_file);
+
+    /// Read the state, return false with a message on stderr if the
+    /// settings file cannot be read.
+    bool load();
+
+    /** Print one line per registry entry, then one line per bookmark,
+     *  fields separated by tabs:
+     *
+     *    command   <row>  <text>
+     *    bookmark  <row>  <path>  <brief>
+     */
+    int list(std::ostream& out) const;
+
+    /// Spawn a registry entry, return 0 if it started.
+    int run(QString const& name) const;
+
+    /// Open a bookmark with the default application of the desktop,
+    /// return 0 if one matched and the opener started.
+    int open_bookmark(QString const& pattern) const;
+
+    std::vector<ParsedCommand> const&    commands()  const { return m_commands; }
+    std::vector<FileBookmarkItem> const& bookmarks() const { return m_bookmarks; }
+
+private:
+    QString                       m_settings_file;
+    // Split, not resolved: only the entry that is run is looked up in $PATH
+    std::vector<ParsedCommand>    m_commands;
+    // In insertion order, the order of the journal rows
+    std::vector<FileBookmarkItem> m_bookmarks;
+
+    /// Name of a file next to the settings file, see AppMainWindow.
+    QString sibling_file(QString const& suffix) const;
+};
+
+#endif // HEADLESSCLI_HPP
@@ -0,0 +1,378 @@
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <iostream>
+#include <vector>
+
+#include <qxstl/metrics.hpp>
+
+#include "launchengine.hpp"
+
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <unistd.h>
+extern char** environ;
+#endif
+
+#ifdef Q_OS_LINUX
+#include <sys/syscall.h>  // SYS_pidfd_open
+#endif
+
+// posix_spawn_file_actions_addchdir_np() sets the working directory of
+// the child. Without it, commands with a directory go through QProcess.
+#if defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 29))
+#  define LAUNCHENGINE_HAS_ADDCHDIR 1
+#else
+#  define LAUNCHENGINE_HAS_ADDCHDIR 0
+#endif
+
+namespace
+{
+    // Interval of waitpid() polling when pidfd is not available
+    constexpr int poll_interval_ms = 500;
+
+    /// Return a pidfd of the child, or -1 if the kernel does not support it.
+    int open_pidfd(qint64 pid)
+    {
+#if defined(Q_OS_LINUX) && defined(SYS_pidfd_open)
+        return static_cast<int>(::syscall(SYS_pidfd_open, static_cast<pid_t>(pid), 0));
+#else
+        Q_UNUSED(pid)
+        return -1;
+#endif
+    }
+
+#ifdef Q_OS_UNIX
+    /// posix_spawn() the resolved program, return 0 or an errno value.
+    int spawn_posix(ParsedCommand const& command, qint64& pid_out)
+    {
+        // The arguments are already NUL separated, they are pointed to in a
+        // single encoded buffer.
+        QByteArray         bytes = QFile::encodeName(command.args);
+        std::vector<char*> argv;
+        if(!bytes.isEmpty()) { argv.push_back(bytes.data()); }
+        for(int i = 0; i < bytes.size(); i++)
+        {
+            if(bytes[i] == '\0') { argv.push_back(bytes.data() + i + 1); }
+        }
+        argv.push_back(nullptr);
+
+        // Overrides replace the variables of the same name.
+        std::vector<QByteArray> env_bytes;
+        std::vector<char*>      envp;
+        for(auto const& e: command.env){ env_bytes.push_back(e.toLocal8Bit()); }
+        for(char** e = environ; *e != nullptr; ++e)
+        {
+            const char* eq = std::strchr(*e, '=');
+            if(eq == nullptr) { continue; }
+            QByteArray name(*e, static_cast<int>(eq - *e) + 1);
+            bool overridden = std::any_of(env_bytes.begin(), env_bytes.end(),
+                                          [&](QByteArray const& o){ return o.startsWith(name); });
+            if(!overridden) { envp.push_back(*e); }
+        }
+        for(auto& e: env_bytes){ envp.push_back(e.data()); }
+        envp.push_back(nullptr);
+
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+#if LAUNCHENGINE_HAS_ADDCHDIR
+        QByteArray cwd = QFile::encodeName(command.cwd);
+        if(!cwd.isEmpty()) { posix_spawn_file_actions_addchdir_np(&actions, cwd.constData()); }
+#endif
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        // The child must not inherit the signal mask and the ignored signals
+        // of the worker thread.
+        sigset_t mask, defaults;
+        sigemptyset(&mask);
+        sigemptyset(&defaults);
+        sigaddset(&defaults, SIGPIPE);
+        sigaddset(&defaults, SIGCHLD);
+        short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+#ifdef POSIX_SPAWN_SETSID
+        // Detached like startDetached(): closing the terminal of the launcher
+        // does not hang up the command.
+        flags |= POSIX_SPAWN_SETSID;
+#endif
+        posix_spawnattr_setsigmask(&attr, &mask);
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+        posix_spawnattr_setflags(&attr, flags);
+
+        // The program is already resolved, no $PATH lookup.
+        QByteArray program = QFile::encodeName(command.program);
+        pid_t pid = -1;
+        int rc = ::posix_spawn(&pid, program.constData(), &actions, &attr, argv.data(), envp.data());
+        posix_spawnattr_destroy(&attr);
+        posix_spawn_file_actions_destroy(&actions);
+        pid_out = pid;
+        return rc;
+    }
+#endif
+}
+
+QString
+LaunchRecord::status_text() const
+{
+    switch(state)
+    {
+    case State::Starting: return "starting";
+    case State::Running:  return "running";
+    case State::Failed:   return "failed: " + error;
+    case State::Exited:
+        return signaled ? QString("signal %1").arg(exit_code)
+                        : QString("exit %1").arg(exit_code);
+    }
+    return QString{};
+}
+
+LaunchEngine::LaunchEngine(Callback callback)
+    : m_pool{new QThreadPool}
+    , m_callback{std::move(callback)}
+    , m_next_id{0}
+{
+    // Note: The thread pool is never deleted on purpose, as in
+    // FileProbeService: a worker blocked in exec on a hung mount point
+    // cannot be joined.
+    m_pool->setMaxThreadCount(4);
+
+    m_poll_timer = new QTimer(m_receiver.context());
+    m_poll_timer->setInterval(poll_interval_ms);
+    QObject::connect(m_poll_timer, &QTimer::timeout, [this]{ this->poll_children(); });
+}
+
+LaunchEngine::~LaunchEngine()
+{
+    // Notifiers are children of the receiver context, deleted with it.
+    for(auto const& child: m_children)
+    {
+#ifdef Q_OS_UNIX
+        if(child.pidfd >= 0) { ::close(child.pidfd); }
+#endif
+    }
+}
+
+QStringList
+LaunchEngine::split_command(QString const& command)
+{
+    QStringList args;
+    QString     arg;
+    int  quotes   = 0;
+    bool in_quote = false;
+    for(QChar ch: command)
+    {
+        if(ch == '"')
+        {
+            // Three consecutive quotes are a literal quote.
+            if(++quotes == 3) { quotes = 0; arg += ch; }
+            continue;
+        }
+        if(quotes == 1) { in_quote = !in_quote; }
+        quotes = 0;
+        if(!in_quote && ch.isSpace())
+        {
+            if(!arg.isEmpty()) { args << arg; arg.clear(); }
+        }
+        else
+        {
+            arg += ch;
+        }
+    }
+    if(!arg.isEmpty()) { args << arg; }
+    return args;
+}
+
+int
+LaunchEngine::launch(QString const& command)
+{
+    // Only split here, the binary is looked up by the worker thread: a
+    // hung mount in $PATH must not block the caller.
+    return this->launch(ParsedCommand::split(command));
+}
+
+int
+LaunchEngine::launch(ParsedCommand command)
+{
+    LaunchRecord record;
+    record.id      = m_next_id++;
+    record.command = command.text;
+    record.started = QDateTime::currentDateTime();
+    m_callback(record);
+
+    auto sender = m_receiver.sender();
+    qxstl::concurrent::run(m_pool, [this, sender, record, command]() mutable
+    {
+        // A stat() of the binary, it only walks $PATH again if it changed
+        // or was never resolved.
+        command.revalidate();
+        LaunchRecord result = spawn(record, command);
+        // Note: 'this' is only dereferenced on the receiver thread, and
+        // only while the engine is alive.
+        sender.post([this, result]{ this->on_spawned(result); });
+    });
+    return record.id;
+}
+
+LaunchRecord
+LaunchEngine::spawn_now(ParsedCommand const& command)
+{
+    LaunchRecord record;
+    record.command = command.text;
+    record.started = QDateTime::currentDateTime();
+    return spawn(record, command);
+}
+
+LaunchRecord
+LaunchEngine::spawn(LaunchRecord record, ParsedCommand const& command)
+{
+    static auto& latency = qxstl::metrics::histogram(
+        "applauncher_spawn_seconds", "Time of spawning a command");
+    static auto& failures = qxstl::metrics::counter(
+        "applauncher_spawn_failures_total", "Commands that failed to start");
+
+    if(!command.is_valid())
+    {
+        record.state = LaunchRecord::State::Failed;
+        record.error = command.error();
+        failures.add();
+        return record;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+#ifdef Q_OS_UNIX
+    if(LAUNCHENGINE_HAS_ADDCHDIR || command.cwd.isEmpty())
+    {
+        qint64 pid = -1;
+        int rc = spawn_posix(command, pid);
+        if(rc == 0)
+        {
+            record.state = LaunchRecord::State::Running;
+            record.pid   = pid;
+        }
+        else
+        {
+            record.state = LaunchRecord::State::Failed;
+            record.error = QString::fromLocal8Bit(std::strerror(rc));
+        }
+    }
+    else
+#endif
+    {
+        QProcess process;
+        process.setProgram(command.program);
+        process.setArguments(command.argv().mid(1));
+        process.setWorkingDirectory(command.cwd);
+        auto env = QProcessEnvironment::systemEnvironment();
+        for(auto const& e: command.env){ env.insert(e.section('=', 0, 0), e.section('=', 1)); }
+        process.setProcessEnvironment(env);
+        qint64 pid = -1;
+        // The process is a grandchild, its exit cannot be tracked.
+        record.detached = true;
+        if(process.startDetached(&pid))
+        {
+            record.state = LaunchRecord::State::Running;
+            record.pid   = pid;
+        }
+        else
+        {
+            record.state = LaunchRecord::State::Failed;
+            record.error = process.errorString();
+        }
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+    latency.observe_ns(static_cast<quint64>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count()));
+    record.spawn_us = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+    if(record.state == LaunchRecord::State::Failed) { failures.add(); }
+    return record;
+}
+
+void
+LaunchEngine::on_spawned(LaunchRecord record)
+{
+    if(record.state == LaunchRecord::State::Running)
+    {
+        std::cout << " [INFO] Launched " << record.command.toStdString()
+                  << " pid = " << record.pid << " in " << record.spawn_us << " us"
+                  << std::endl;
+    }
+    m_callback(record);
+#ifdef Q_OS_UNIX
+    if(record.state != LaunchRecord::State::Running || record.detached) { return; }
+
+    Child child;
+    child.record = record;
+    // A pidfd can be opened until the child is reaped, even if it already
+    // exited, and only this engine reaps it.
+    child.pidfd = open_pidfd(record.pid);
+    qint64 pid  = record.pid;
+    if(child.pidfd >= 0)
+    {
+        child.notifier = new QSocketNotifier(child.pidfd, QSocketNotifier::Read,
+                                             m_receiver.context());
+        QObject::connect(child.notifier, &QSocketNotifier::activated,
+                         [this, pid]{ this->reap(pid); });
+    }
+    else if(!m_poll_timer->isActive())
+    {
+        m_poll_timer->start();
+    }
+    m_children.insert(pid, child);
+#endif
+}
+
+void
+LaunchEngine::reap(qint64 pid)
+{
+#ifdef Q_OS_UNIX
+    auto it = m_children.find(pid);
+    if(it == m_children.end()) { return; }
+
+    int status = 0;
+    pid_t r = ::waitpid(static_cast<pid_t>(pid), &status, WNOHANG);
+    if(r == 0) { return; }
+
+    Child child = it.value();
+    m_children.erase(it);
+    if(child.notifier != nullptr)
+    {
+        child.notifier->setEnabled(false);
+        // It may be the sender of the signal being handled.
+        child.notifier->deleteLater();
+    }
+    if(child.pidfd >= 0) { ::close(child.pidfd); }
+
+    LaunchRecord& record = child.record;
+    record.state = LaunchRecord::State::Exited;
+    if(r < 0)
+    {
+        // Reaped by someone else, the status is lost.
+        record.exit_code = -1;
+    }
+    else if(WIFSIGNALED(status))
+    {
+        record.signaled  = true;
+        record.exit_code = WTERMSIG(status);
+    }
+    else
+    {
+        record.exit_code = WEXITSTATUS(status);
+    }
+    m_callback(record);
+#else
+    Q_UNUSED(pid)
+#endif
+}
+
+void
+LaunchEngine::poll_children()
+{
+    bool polled = false;
+    for(qint64 pid: m_children.keys())
+    {
+        if(m_children.value(pid).pidfd < 0) { this->reap(pid); polled = true; }
+    }
+    if(!polled) { m_poll_timer->stop(); }
+}
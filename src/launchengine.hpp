@@ -0,0 +1,129 @@
+#ifndef LAUNCHENGINE_HPP
+#define LAUNCHENGINE_HPP
+
+#include <functional>
+#include <memory>
+
+#include <QtCore>
+
+#include <qxstl/concurrent.hpp>
+
+#include "parsedcommand.hpp"
+
+/** A command started by the LaunchEngine, and what became of it. */
+struct LaunchRecord
+{
+    enum class State
+    {
+        // Waiting for a worker thread to spawn it.
+        Starting,
+        // Spawned, the process did not exit yet.
+        Running,
+        // The process exited, see exit_code and signaled.
+        Exited,
+        // The process could not be spawned, see error.
+        Failed
+    };
+
+    int       id        = 0;
+    QString   command;
+    State     state     = State::Starting;
+    qint64    pid       = -1;
+    QDateTime started;
+    // Time taken by the spawn call, in microseconds
+    qint64    spawn_us  = 0;
+    // Exit status, or the signal number when signaled
+    int       exit_code = 0;
+    bool      signaled  = false;
+    // Started through QProcess, the exit is not tracked
+    bool      detached  = false;
+    QString   error;
+
+    /// True if the command failed to start or exited with an error.
+    bool is_failure() const
+    {
+        return state == State::Failed
+               || (state == State::Exited && (signaled || exit_code != 0));
+    }
+
+    /// Short description of the state, such as "exit 0" or "signal 9".
+    QString status_text() const;
+};
+
+/** Class LaunchEngine starts commands without blocking the GUI thread,
+ *  and tracks the processes until they exit.
+ *
+ *  + Commands are spawned on a worker thread with posix_spawn() of the
+ *    binary resolved by ParsedCommand, which uses vfork semantics: the
+ *    parent address space is not copied. An exec blocked on a cold network
+ *    mount only blocks the worker. Without posix_spawn_file_actions_addchdir_np
+ *    (glibc < 2.29), commands with a working directory use QProcess and
+ *    their exit is not tracked.
+ *
+ *  + Children are reaped when they exit. On Linux 5.3 and later, a pidfd
+ *    of each child is watched by the event loop. Elsewhere the children
+ *    are polled with waitpid(WNOHANG). Reaping only targets the spawned
+ *    pids, it never steals the children of QProcess.
+ *
+ *  + Every change of a launch is reported on the thread owning the engine.
+ *
+ *  On Windows, commands are started with QProcess::startDetached() on the
+ *  worker thread, and their exit is not tracked.
+ *************************************************************************/
+class LaunchEngine
+{
+public:
+    using Callback = std::function<void (LaunchRecord const& record)>;
+
+    explicit LaunchEngine(Callback callback);
+
+    /// Running children are left running, they are not waited for.
+    ~LaunchEngine();
+
+    LaunchEngine(LaunchEngine const&) = delete;
+    LaunchEngine& operator=(LaunchEngine const&) = delete;
+
+    /// Parse and start a command line, return the id of the launch. The
+    /// callback first receives it in the Starting state. The binary is
+    /// resolved on the worker thread.
+    int launch(QString const& command);
+
+    /// Start a command parsed ahead of time. Its binary is resolved again
+    /// only if it is stale.
+    int launch(ParsedCommand command);
+
+    /// Spawn a command on the calling thread without tracking it, for a
+    /// process that exits right after, see HeadlessCli.
+    static LaunchRecord spawn_now(ParsedCommand const& command);
+
+    /// Split a command line into arguments like QProcess: arguments are
+    /// separated by spaces, double quotes group them, and a quote is
+    /// escaped by tripling it.
+    static QStringList split_command(QString const& command);
+
+private:
+    struct Child
+    {
+        LaunchRecord     record;
+        int              pidfd    = -1;
+        QSocketNotifier* notifier = nullptr;
+    };
+
+    // Receives spawn results posted by the worker threads
+    qxstl::concurrent::Receiver m_receiver;
+    QThreadPool*           m_pool;
+    // Polls children without a pidfd
+    QTimer*                m_poll_timer;
+    Callback               m_callback;
+    int                    m_next_id;
+    QHash<qint64, Child>   m_children;
+
+    void on_spawned(LaunchRecord record);
+    void reap(qint64 pid);
+    void poll_children();
+
+    /// Spawn the process, it runs on a worker thread.
+    static LaunchRecord spawn(LaunchRecord record, ParsedCommand const& command);
+};
+
+#endif // LAUNCHENGINE_HPP
@@ -0,0 +1,18 @@
+#ifndef LAUNCHERSNAPSHOT_HPP
+#define LAUNCHERSNAPSHOT_HPP
+
+#include <QtCore>
+
+#include <qxstl/serialization.hpp>
+
+/// Copy of the launcher tab state saved to the settings file. It does not
+/// depend on widgets, so that HeadlessCli can read it.
+struct LauncherSnapshot
+{
+    QStringList app_registry;
+
+    static constexpr auto schema = std::make_tuple(
+        qxstl::serialization::field(1, &LauncherSnapshot::app_registry));
+};
+
+#endif // LAUNCHERSNAPSHOT_HPP
@@ -0,0 +1,76 @@
+#include "launchtablemodel.hpp"
+
+LaunchTableModel::LaunchTableModel(QWidget* parent)
+    : qxstl::model::RecordTableModel<LaunchRecord>(parent)
+    , m_first_id{0}
+{
+}
+
+void
+LaunchTableModel::update(LaunchRecord const& record)
+{
+    int position = record.id - m_first_id;
+    if(position < 0) { return; }
+    if(position < this->item_count())
+    {
+        int row = this->row_of(position);
+        if(row < 0) { return; }
+        this->at(row) = record;
+        this->refresh_row(row);
+        return;
+    }
+    this->add_item(record);
+    if(this->item_count() > max_rows)
+    {
+        this->remove_item(this->row_of(0));
+        m_first_id++;
+    }
+}
+
+int
+LaunchTableModel::column_count() const
+{
+    return 5;
+}
+
+QString
+LaunchTableModel::column_name(int column) const
+{
+    if(column == 0) { return "Command"; }
+    if(column == 1) { return "PID";     }
+    if(column == 2) { return "Started"; }
+    if(column == 3) { return "Spawn";   }
+    if(column == 4) { return "Status";  }
+    return QString{};
+}
+
+bool
+LaunchTableModel::is_column_editable(int column) const
+{
+    Q_UNUSED(column)
+    return false;
+}
+
+QString
+LaunchTableModel::display_item_row(LaunchRecord const& item, int column) const
+{
+    if(column == 0) { return item.command; }
+    if(column == 1) { return item.pid < 0 ? QString{} : QString::number(item.pid); }
+    if(column == 2) { return item.started.toString("hh:mm:ss.zzz"); }
+    if(column == 3)
+    {
+        if(item.state == LaunchRecord::State::Starting) { return QString{}; }
+        return QString("%1 ms").arg(item.spawn_us / 1000.0, 0, 'f', 2);
+    }
+    if(column == 4) { return item.status_text(); }
+    return QString{};
+}
+
+bool
+LaunchTableModel::set_element(int column, QVariant value, LaunchRecord& item)
+{
+    Q_UNUSED(column)
+    Q_UNUSED(value)
+    Q_UNUSED(item)
+    return false;
+}
@@ -0,0 +1,36 @@
+#ifndef LAUNCHTABLEMODEL_HPP
+#define LAUNCHTABLEMODEL_HPP
+
+#include <qxstl/RecordTableModel.hpp>
+
+#include "launchengine.hpp"
+
+/** Table of the latest launches: command, PID, start time, spawn latency
+ *  and exit status. Only the latest launches are kept, see max_rows.
+ */
+class LaunchTableModel: public qxstl::model::RecordTableModel<LaunchRecord>
+{
+public:
+    static constexpr int max_rows = 500;
+
+    explicit LaunchTableModel(QWidget* parent);
+
+    /// Insert a new launch or update a known one.
+    void update(LaunchRecord const& record);
+
+    int column_count() const override;
+
+    QString column_name(int column) const override;
+
+    bool is_column_editable(int column) const override;
+
+    QString display_item_row(LaunchRecord const& item, int column) const override;
+
+    bool set_element(int column, QVariant value, LaunchRecord& item) override;
+
+private:
+    // Id of the item at position 0, launch ids are consecutive.
+    int m_first_id;
+};
+
+#endif // LAUNCHTABLEMODEL_HPP
@@ -1,26 +1,183 @@
 /**  Brief: Application Main Window
  *   Author: Caio Rodrigues - caiorss [at] rodrigues [at] gmail [dot] com
  *
+ *   Options:
+ *     --trace-startup <file>  Write startup phases as a Chrome trace,
+ *                             also enabled by APPLAUNCHER_TRACE=<file>.
+ *     --metrics-dump          Dump metrics on SIGUSR1 (Unix).
+ *     --metrics-port <port>   Serve metrics on http://127.0.0.1:<port>
+ *     --metrics-socket <name> Serve metrics on a local socket.
+ *     --add-bookmark <path>   Bookmark a file or URL.
+ *
+ *   Only one instance runs per user: a later one forwards its request
+ *   (showing the window by default) to the running one and exits.
+ *
+ *   Script modes, they exit without creating any widget:
+ *     --list                  Print the registry and the bookmarks.
+ *     --run <entry>           Run a registry entry, given its index, its
+ *                             text or the name of its program.
+ *     --open-bookmark <text>  Open the first bookmark containing the text.
  *
  ************************************************************/
 #include <iostream>
+#include <cstring>
+#include <optional>
 
 #include <QApplication>
+#include <qxstl/trace.hpp>
 #include "appmainwindow.hpp"
+#include "headlesscli.hpp"
+#include "metricsendpoint.hpp"
+#include "singleinstance.hpp"
+
+/// Reports the time from the start of the process until the first paint
+/// of the window, the startup time perceived by the user. The startup
+/// trace ends there.
+class FirstPaintProbe: public QObject
+{
+    QElapsedTimer timer;
+public:
+    FirstPaintProbe() { timer.start(); }
+
+    bool eventFilter(QObject* watched, QEvent* event) override
+    {
+        if(event->type() == QEvent::Paint)
+        {
+            std::cout << " [INFO] Time to window shown: " << timer.elapsed()
+                      << " ms" << std::endl;
+            watched->removeEventFilter(this);
+            qxstl::trace::instant("first_paint");
+            qxstl::trace::finish();
+        }
+        return false;
+    }
+};
+
+// Options are read before QApplication is constructed, so that its
+// construction can be traced.
+static bool has_option(int argc, char** argv, const char* name)
+{
+    for(int i = 1; i < argc; i++)
+    {
+        if(std::strcmp(argv[i], name) == 0) { return true; }
+    }
+    return false;
+}
+
+static QString option_value(int argc, char** argv, const char* name)
+{
+    for(int i = 1; i + 1 < argc; i++)
+    {
+        if(std::strcmp(argv[i], name) == 0)
+            return QString::fromLocal8Bit(argv[i + 1]);
+    }
+    return QString{};
+}
 
+/// Script modes of HeadlessCli, they only need a QCoreApplication.
+static int run_headless(bool list, QString const& run_entry, QString const& bookmark_pattern)
+{
+    if(!list && !run_entry.isEmpty())
+    {
+        // A running instance knows the latest registry, and tracks the launch.
+        auto role = SingleInstance::forward({InstanceRequest::Action::Run, run_entry}, 1000);
+        if(role == SingleInstance::Role::Forwarded) { return 0; }
+        if(role == SingleInstance::Role::Failed)
+        {
+            std::cerr << " [ERROR] The running instance cannot run "
+                      << run_entry.toStdString() << std::endl;
+            return 1;
+        }
+    }
+    HeadlessCli cli(AppMainWindow::get_settings_file());
+    if(!cli.load())  { return 1; }
+    if(list)         { return cli.list(std::cout); }
+    if(!run_entry.isEmpty()) { return cli.run(run_entry); }
+    return cli.open_bookmark(bookmark_pattern);
+}
 
 int main(int argc, char** argv)
 {
+    FirstPaintProbe first_paint;
+    QString trace_file = option_value(argc, argv, "--trace-startup");
+    if(trace_file.isEmpty())
+        trace_file = QString::fromLocal8Bit(qgetenv("APPLAUNCHER_TRACE"));
+    if(!trace_file.isEmpty()) { qxstl::trace::start(trace_file); }
+
+    bool    list          = has_option(argc, argv, "--list");
+    QString run_entry     = option_value(argc, argv, "--run");
+    QString open_bookmark = option_value(argc, argv, "--open-bookmark");
+    if(list || !run_entry.isEmpty() || !open_bookmark.isEmpty())
+    {
+        QCoreApplication core(argc, argv);
+        core.setApplicationName("qapplauncher");
+        return run_headless(list, run_entry, open_bookmark);
+    }
+
+    InstanceRequest request;
+    QString bookmark = option_value(argc, argv, "--add-bookmark");
+    if(!bookmark.isEmpty())
+    {
+        // The running instance may have another working directory.
+        QFileInfo info{bookmark};
+        request.action   = InstanceRequest::Action::AddBookmark;
+        request.argument = info.exists() ? info.absoluteFilePath() : bookmark;
+    }
+
+    // Decided before any widget code runs, so that a forwarding process
+    // exits within milliseconds.
+    SingleInstance instance;
+    {
+        qxstl::trace::Span span{"SingleInstance"};
+        QCoreApplication core(argc, argv);
+        auto role = instance.claim(request);
+        if(role != SingleInstance::Role::Primary)
+        {
+            qxstl::trace::finish();
+            return role == SingleInstance::Role::Forwarded ? 0 : 1;
+        }
+    }
+
     std::cout << " [INFO] Starting Application" << std::endl;
 
-    QApplication app(argc, argv);
-    app.setApplicationName("qapplauncher");   
+    // Constructed in place, so that its construction can be traced.
+    std::optional<QApplication> app;
+    {
+        qxstl::trace::Span span{"QApplication"};
+        app.emplace(argc, argv);
+    }
+    app->setApplicationName("qapplauncher");   
+
+    MetricsEndpoint metrics;
+    if(has_option(argc, argv, "--metrics-dump")) { metrics.install_dump_signal(); }
+    QString metrics_port = option_value(argc, argv, "--metrics-port");
+    if(!metrics_port.isEmpty())
+    {
+        bool ok = false;
+        quint16 port = metrics_port.toUShort(&ok);
+        if(!ok || port == 0)
+        {
+            std::cerr << " [ERROR] Invalid --metrics-port " << metrics_port.toStdString()
+                      << ", expected a port number from 1 to 65535" << std::endl;
+            return 1;
+        }
+        metrics.listen_tcp(port);
+    }
+    QString metrics_socket = option_value(argc, argv, "--metrics-socket");
+    if(!metrics_socket.isEmpty()) { metrics.listen_local(metrics_socket); }
 
     AppMainWindow maingui;
+    maingui.installEventFilter(&first_paint);
     maingui.setWindowIcon(QIcon(":/assets/appicon.png"));
-    maingui.showNormal();
+    instance.listen([&maingui](InstanceRequest const& r){ return maingui.handle_request(r); });
+    if(request.action != InstanceRequest::Action::Show) { maingui.handle_request(request); }
+    {
+        qxstl::trace::Span span{"show"};
+        maingui.showNormal();
+    }
 
-
-    return app.exec();
+    int status = app->exec();
+    // The window may have never been painted, minimized to the tray.
+    qxstl::trace::finish();
+    return status;
 }
-
@@ -0,0 +1,145 @@
+#include <iostream>
+
+#include <qxstl/metrics.hpp>
+
+#include "metricsendpoint.hpp"
+
+#ifdef Q_OS_UNIX
+#include <csignal>
+#include <sys/socket.h>  // socketpair()
+#include <unistd.h>      // read(), write()
+#endif
+
+namespace
+{
+    // Requests larger than this are not HTTP GET requests of a scraper.
+    constexpr int max_request_size = 8192;
+
+#ifdef Q_OS_UNIX
+    // Written by the signal handler, read by the event loop.
+    int signal_fds[2] = {-1, -1};
+
+    void on_dump_signal(int)
+    {
+        char byte = 1;
+        // Only async-signal-safe calls here
+        ssize_t n = ::write(signal_fds[0], &byte, 1);
+        (void) n;
+    }
+#endif
+}
+
+MetricsEndpoint::MetricsEndpoint()
+{
+}
+
+MetricsEndpoint::~MetricsEndpoint()
+{
+}
+
+bool
+MetricsEndpoint::install_dump_signal()
+{
+#ifdef Q_OS_UNIX
+    if(signal_fds[0] >= 0) { return false; }
+    if(::socketpair(AF_UNIX, SOCK_STREAM, 0, signal_fds) != 0) { return false; }
+
+    m_signal_notifier = std::make_unique<QSocketNotifier>(signal_fds[1], QSocketNotifier::Read);
+    QObject::connect(m_signal_notifier.get(), &QSocketNotifier::activated, []
+                     {
+                         char byte;
+                         ssize_t n = ::read(signal_fds[1], &byte, 1);
+                         (void) n;
+                         std::cout << qxstl::metrics::Registry::global().prometheus_text()
+                                          .toStdString() << std::flush;
+                     });
+
+    struct sigaction action = {};
+    action.sa_handler = on_dump_signal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if(::sigaction(SIGUSR1, &action, nullptr) != 0) { return false; }
+    std::cout << " [INFO] Metrics: kill -USR1 " << QCoreApplication::applicationPid()
+              << " dumps the metrics" << std::endl;
+    return true;
+#else
+    std::cerr << " [ERROR] Metrics: the dump signal is only available on Unix" << std::endl;
+    return false;
+#endif
+}
+
+bool
+MetricsEndpoint::listen_tcp(quint16 port)
+{
+    m_tcp = std::make_unique<QTcpServer>();
+    if(!m_tcp->listen(QHostAddress::LocalHost, port))
+    {
+        std::cerr << " [ERROR] Metrics: cannot listen on port " << port << ": "
+                  << m_tcp->errorString().toStdString() << std::endl;
+        m_tcp.reset();
+        return false;
+    }
+    QObject::connect(m_tcp.get(), &QTcpServer::newConnection, [this]
+                     {
+                         while(QTcpSocket* socket = m_tcp->nextPendingConnection())
+                         {
+                             this->serve_http(socket);
+                         }
+                     });
+    std::cout << " [INFO] Metrics: http://127.0.0.1:" << m_tcp->serverPort()
+              << "/metrics" << std::endl;
+    return true;
+}
+
+void
+MetricsEndpoint::serve_http(QTcpSocket* socket)
+{
+    QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+    QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket]
+    {
+        // Any path is answered with the metrics, once the request header
+        // is complete.
+        if(!socket->peek(max_request_size).contains("\r\n\r\n"))
+        {
+            if(socket->bytesAvailable() >= max_request_size) { socket->abort(); }
+            return;
+        }
+        socket->readAll();
+        QByteArray body = qxstl::metrics::Registry::global().prometheus_text();
+        socket->write("HTTP/1.0 200 OK\r\n"
+                      "Content-Type: text/plain; version=0.0.4\r\n"
+                      "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                      "Connection: close\r\n\r\n");
+        socket->write(body);
+        socket->disconnectFromHost();
+    });
+}
+
+bool
+MetricsEndpoint::listen_local(QString const& name)
+{
+    m_local = std::make_unique<QLocalServer>();
+    m_local->setSocketOptions(QLocalServer::UserAccessOption);
+    // A socket file left by a crashed instance would make listen() fail.
+    QLocalServer::removeServer(name);
+    if(!m_local->listen(name))
+    {
+        std::cerr << " [ERROR] Metrics: cannot listen on " << name.toStdString() << ": "
+                  << m_local->errorString().toStdString() << std::endl;
+        m_local.reset();
+        return false;
+    }
+    QObject::connect(m_local.get(), &QLocalServer::newConnection, [this]
+                     {
+                         while(QLocalSocket* socket = m_local->nextPendingConnection())
+                         {
+                             QObject::connect(socket, &QLocalSocket::disconnected,
+                                              socket, &QObject::deleteLater);
+                             socket->write(qxstl::metrics::Registry::global().prometheus_text());
+                             socket->disconnectFromServer();
+                         }
+                     });
+    std::cout << " [INFO] Metrics: local socket " << m_local->fullServerName().toStdString()
+              << std::endl;
+    return true;
+}
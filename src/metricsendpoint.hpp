@@ -0,0 +1,50 @@
+#ifndef METRICSENDPOINT_HPP
+#define METRICSENDPOINT_HPP
+
+#include <memory>
+
+#include <QtCore>
+#include <QtNetwork>
+
+/** Class MetricsEndpoint exposes the metrics of the global registry, see
+ *  qxstl/metrics.hpp, in the Prometheus text format:
+ *
+ *  + On Unix, SIGUSR1 dumps them to the standard output. The signal
+ *    handler only writes to a pipe, the dump runs in the event loop.
+ *
+ *  + A loopback TCP port answers HTTP GET requests, so that the launcher
+ *    can be scraped by Prometheus or queried with curl.
+ *
+ *  + A local socket (Unix domain socket, or named pipe on Windows)
+ *    answers each connection with the metrics and closes it.
+ *
+ *  All of them are off until enabled.
+ *************************************************************************/
+class MetricsEndpoint
+{
+public:
+    MetricsEndpoint();
+    ~MetricsEndpoint();
+
+    MetricsEndpoint(MetricsEndpoint const&) = delete;
+    MetricsEndpoint& operator=(MetricsEndpoint const&) = delete;
+
+    /// Dump the metrics when the process receives SIGUSR1. Only one
+    /// endpoint of the process may install it.
+    bool install_dump_signal();
+
+    /// Serve the metrics over HTTP on 127.0.0.1:port.
+    bool listen_tcp(quint16 port);
+
+    /// Serve the metrics on a local socket.
+    bool listen_local(QString const& name);
+
+private:
+    std::unique_ptr<QTcpServer>      m_tcp;
+    std::unique_ptr<QLocalServer>    m_local;
+    std::unique_ptr<QSocketNotifier> m_signal_notifier;
+
+    void serve_http(QTcpSocket* socket);
+};
+
+#endif // METRICSENDPOINT_HPP
@@ -0,0 +1,213 @@
+#include <algorithm>
+
+#include "parsedcommand.hpp"
+#include "launchengine.hpp"
+
+namespace
+{
+    qint64 mtime_of(QString const& file)
+    {
+        return QFileInfo{file}.lastModified().toMSecsSinceEpoch();
+    }
+
+    /// Value of $PATH. While it does not change, every command of a thread
+    /// shares the same copy instead of holding one of its own.
+    QByteArray path_variable()
+    {
+        thread_local QByteArray last;
+        QByteArray value = qgetenv("PATH");
+        if(value != last) { last = value; }
+        return last;
+    }
+
+    bool is_env_assignment(QString const& arg)
+    {
+        int eq = arg.indexOf('=');
+        if(eq <= 0) { return false; }
+        for(int i = 0; i < eq; i++)
+        {
+            QChar ch = arg[i];
+            if(!(ch.isLetterOrNumber() || ch == '_') || (i == 0 && ch.isDigit())) { return false; }
+        }
+        return true;
+    }
+
+    /// Arguments of a command line after its directory and environment
+    /// prefix, which are returned in cwd and env if they are not null.
+    QStringList split_prefix(QString const& text, QString* cwd, QStringList* env)
+    {
+        QStringList args = LaunchEngine::split_command(text);
+        if(args.size() >= 3 && args[0] == "cd" && args[2] == "&&")
+        {
+            if(cwd)
+            {
+                *cwd = QDir::fromNativeSeparators(args[1]);
+                if(cwd->startsWith("~")) { cwd->replace(0, 1, QDir::homePath()); }
+            }
+            args = args.mid(3);
+        }
+        while(!args.isEmpty() && is_env_assignment(args.first()))
+        {
+            QString assignment = args.takeFirst();
+            if(env) { *env << assignment; }
+        }
+        return args;
+    }
+}
+
+ParsedCommand
+ParsedCommand::parse(QString const& text)
+{
+    ParsedCommand cmd = split(text);
+    cmd.resolve();
+    return cmd;
+}
+
+ParsedCommand
+ParsedCommand::split(QString const& text)
+{
+    ParsedCommand cmd;
+    cmd.text = text;
+    cmd.args = split_prefix(text, &cmd.cwd, &cmd.env).join(QChar::Null);
+    return cmd;
+}
+
+ParsedCommand
+ParsedCommand::from_argv(QStringList const& argv)
+{
+    QStringList quoted;
+    for(QString arg: argv)
+    {
+        bool needs_quotes = arg.isEmpty() || arg.contains('"')
+                            || std::any_of(arg.begin(), arg.end(), [](QChar ch){ return ch.isSpace(); });
+        if(!needs_quotes) { quoted << arg; continue; }
+        // A literal quote is tripled, see LaunchEngine::split_command().
+        arg.replace("\"", "\"\"\"");
+        quoted << "\"" + arg + "\"";
+    }
+    return split(quoted.join(' '));
+}
+
+QStringList
+ParsedCommand::argv() const
+{
+    if(args.isEmpty()) { return QStringList{}; }
+    return args.split(QChar::Null);
+}
+
+QString
+ParsedCommand::program_name() const
+{
+    return args.section(QChar::Null, 0, 0);
+}
+
+QString
+ParsedCommand::error() const
+{
+    switch(error_code)
+    {
+    case Error::None:        return QString{};
+    case Error::Empty:       return QStringLiteral("empty command");
+    case Error::NotFound:    return "not found: " + this->program_name();
+    case Error::NoDirectory: return "no such directory: " + cwd;
+    }
+    return QString{};
+}
+
+int
+ParsedCommand::find(std::vector<ParsedCommand> const& commands, QString const& name)
+{
+    return find(static_cast<int>(commands.size()),
+                [&](int r) -> ParsedCommand const& { return commands[static_cast<size_t>(r)]; },
+                name);
+}
+
+int
+ParsedCommand::find(int size, std::function<ParsedCommand const& (int)> const& at,
+                    QString const& name)
+{
+    bool is_index = false;
+    int  row      = name.toInt(&is_index);
+    if(is_index) { return row >= 0 && row < size ? row : -1; }
+    for(int r = 0; r < size; r++)
+    {
+        if(at(r).text == name) { return r; }
+    }
+    for(int r = 0; r < size; r++)
+    {
+        // The resolved program has the file name of argv[0].
+        auto const& command = at(r);
+        QString program = command.is_valid() ? command.program : command.program_name();
+        if(!program.isEmpty() && QFileInfo{program}.fileName() == name) { return r; }
+    }
+    return -1;
+}
+
+bool
+ParsedCommand::resolve(ProgramCache* cache)
+{
+    program.clear();
+    program_mtime = 0;
+    path_env      = path_variable();
+    if(args.isEmpty())
+    {
+        error_code = Error::Empty;
+        return false;
+    }
+
+    QString name = this->program_name();
+    bool is_path = name.contains('/') || QDir::isAbsolutePath(name);
+    // Names are looked up in $PATH, paths relative to the directory.
+    QString key  = is_path ? QDir{cwd.isEmpty() ? QDir::currentPath() : cwd}.absoluteFilePath(name)
+                           : name;
+    auto cached  = cache ? cache->constFind(key) : ProgramCache::const_iterator{};
+    if(cache && cached != cache->constEnd())
+    {
+        program       = cached->first;
+        program_mtime = cached->second;
+    }
+    else
+    {
+        if(is_path)
+        {
+            QFileInfo info{key};
+            if(info.isFile() && info.isExecutable()) { program = info.absoluteFilePath(); }
+        }
+        else
+        {
+            program = QStandardPaths::findExecutable(name);
+        }
+        if(!program.isEmpty()) { program_mtime = mtime_of(program); }
+        if(cache) { cache->insert(key, {program, program_mtime}); }
+    }
+    if(program.isEmpty())
+    {
+        error_code = Error::NotFound;
+        return false;
+    }
+    if(!cwd.isEmpty() && !QFileInfo{cwd}.isDir())
+    {
+        program.clear();
+        program_mtime = 0;
+        error_code = Error::NoDirectory;
+        return false;
+    }
+    error_code = Error::None;
+    return true;
+}
+
+bool
+ParsedCommand::is_stale() const
+{
+    if(path_env != path_variable()) { return true; }
+    // A missing program may have been installed since.
+    if(program.isEmpty()) { return true; }
+    return mtime_of(program) != program_mtime;
+}
+
+bool
+ParsedCommand::revalidate()
+{
+    if(this->is_stale()) { this->resolve(); }
+    return this->is_valid();
+}
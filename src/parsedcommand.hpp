@@ -0,0 +1,100 @@
+#ifndef PARSEDCOMMAND_HPP
+#define PARSEDCOMMAND_HPP
+
+#include <functional>
+#include <vector>
+
+#include <QtCore>
+
+/** A command line of the registry, parsed and resolved ahead of time, so
+ *  that launching it neither tokenizes the text nor walks $PATH.
+ *
+ *  Syntax, a subset of the shell:
+ *
+ *    [cd <dir> &&] [NAME=value ...] program [arguments ...]
+ *
+ *  Arguments are split like QProcess does: double quotes group them, and
+ *  a quote is escaped by tripling it.
+ *
+ *  The resolved program is invalidated when $PATH or the modification
+ *  time of the binary change, see is_stale().
+ *
+ *  The text is tokenized once: the arguments are kept in a single string,
+ *  separated by NUL characters, which no argument can contain. The error
+ *  message is derived from the error code. The program and $PATH are
+ *  shared by the commands resolved together.
+ */
+struct ParsedCommand
+{
+    /// Binaries already looked up, by name or path, with their
+    /// modification time, see resolve().
+    using ProgramCache = QHash<QString, QPair<QString, qint64>>;
+
+    /// Why the command cannot be launched
+    enum class Error: quint8 { None, Empty, NotFound, NoDirectory };
+
+    // Text as typed by the user
+    QString     text;
+    // Arguments, the program first, separated by NUL characters
+    QString     args;
+    // Working directory, empty for the current one
+    QString     cwd;
+    // Environment overrides, NAME=value
+    QStringList env;
+
+    // Absolute path of the binary, empty when it was not found
+    QString     program;
+    // Modification time of the binary, ms since epoch
+    qint64      program_mtime = 0;
+    // Value of $PATH when the program was resolved
+    QByteArray  path_env;
+    Error       error_code = Error::None;
+
+    /// Parse and resolve a command line.
+    static ParsedCommand parse(QString const& text);
+
+    /// Parse the command line running argv, quoting the arguments, without
+    /// resolving the program.
+    static ParsedCommand from_argv(QStringList const& argv);
+
+    /// Arguments, the program first.
+    QStringList argv() const;
+
+    /// First argument, the program as typed.
+    QString program_name() const;
+
+    /// Why the command cannot be launched, empty if it can.
+    QString error() const;
+
+    /// Parse a command line without resolving the program, it does not
+    /// touch the filesystem.
+    static ParsedCommand split(QString const& text);
+
+    /** Find a registry entry by name, return its row or -1. The name is
+     *  tried as a row index, then as the exact text of an entry, then as
+     *  the file name of its program, such that "emacs" finds
+     *  "cd ~ && emacs -nw".
+     */
+    static int find(std::vector<ParsedCommand> const& commands, QString const& name);
+
+    /// Same as above, over the positions 0 to size - 1 of any container.
+    static int find(int size, std::function<ParsedCommand const& (int)> const& at,
+                    QString const& name);
+
+    /** Find the binary of argv[0], return false and set error_code if it is
+     *  missing or not executable. Commands resolved together can share a
+     *  cache, so that each binary is looked up once for the whole registry.
+     */
+    bool resolve(ProgramCache* cache = nullptr);
+
+    /// True if $PATH or the binary changed since resolve(). It costs a
+    /// stat() of the binary.
+    bool is_stale() const;
+
+    /// Resolve again if stale, return is_valid().
+    bool revalidate();
+
+    bool is_valid() const { return !program.isEmpty(); }
+};
+
+#endif // PARSEDCOMMAND_HPP
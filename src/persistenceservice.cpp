@@ -0,0 +1,184 @@
+#include <iostream>
+
+#include <qxstl/concurrent.hpp>
+#include <qxstl/metrics.hpp>
+
+#include "persistenceservice.hpp"
+
+PersistenceService::PersistenceService(QString file_name, SnapshotFactory factory)
+    : m_file_name{file_name}
+    , m_factory{std::move(factory)}
+    , m_compaction_threshold{1024 * 1024}
+    , m_debounce_ms{200}
+    , m_max_delay_ms{2000}
+    , m_dirty{false}
+    , m_batch_depth{0}
+{
+    m_pool.setMaxThreadCount(1);
+    m_timer.setSingleShot(true);
+    QObject::connect(&m_timer, &QTimer::timeout, [this]{ this->write_snapshot(); });
+
+    m_sync_timer.setSingleShot(true);
+    // fsync() may take long on a busy disk, it runs on the writer thread.
+    QObject::connect(&m_sync_timer, &QTimer::timeout, [this]
+                     {
+                         if(!m_journal) { return; }
+                         auto journal = m_journal.get();
+                         qxstl::concurrent::run(&m_pool, [journal]{ journal->sync(); });
+                     });
+}
+
+PersistenceService::~PersistenceService()
+{
+    this->flush();
+}
+
+void
+PersistenceService::set_debounce_delay(int milliseconds)
+{
+    m_debounce_ms = milliseconds;
+}
+
+QString
+PersistenceService::file_name() const
+{
+    return m_file_name;
+}
+
+void
+PersistenceService::open_journal(QString base_name, qint64 snapshot_generation,
+                                 SettingsJournal::ApplyFunc const& apply)
+{
+    m_journal = std::make_unique<SettingsJournal>(base_name);
+    m_journal->open(snapshot_generation, apply);
+}
+
+void
+PersistenceService::set_compaction_threshold(qint64 bytes)
+{
+    m_compaction_threshold = bytes;
+}
+
+void
+PersistenceService::append(JournalRecord const& record)
+{
+    if(!m_journal)
+    {
+        this->mark_dirty();
+        return;
+    }
+    if(m_batch_depth > 0)
+    {
+        m_batch.push_back(record);
+        return;
+    }
+    m_journal->append(record);
+    this->journal_appended();
+}
+
+void
+PersistenceService::begin_batch()
+{
+    m_batch_depth++;
+}
+
+void
+PersistenceService::end_batch()
+{
+    if(m_batch_depth == 0 || --m_batch_depth > 0) { return; }
+    if(!m_journal || m_batch.empty()) { return; }
+    m_journal->append(m_batch);
+    m_batch.clear();
+    this->journal_appended();
+}
+
+void
+PersistenceService::journal_appended()
+{
+    if(m_journal->size() >= m_compaction_threshold)
+    {
+        // The write is asynchronous, records appended meanwhile go to the
+        // next generation.
+        m_dirty = true;
+        m_timer.stop();
+        this->write_snapshot();
+        return;
+    }
+    m_sync_timer.start(m_debounce_ms);
+}
+
+void
+PersistenceService::mark_dirty()
+{
+    if(!m_dirty)
+    {
+        m_dirty = true;
+        m_dirty_since.start();
+    }
+    // A continuous stream of changes must not postpone the write forever.
+    if(m_dirty_since.elapsed() >= m_max_delay_ms)
+    {
+        m_timer.stop();
+        this->write_snapshot();
+        return;
+    }
+    m_timer.start(m_debounce_ms);
+}
+
+void
+PersistenceService::flush()
+{
+    m_timer.stop();
+    m_sync_timer.stop();
+    if(m_journal && m_journal->has_records()) { m_dirty = true; }
+    if(m_dirty) { this->write_snapshot(); }
+    m_pool.waitForDone();
+}
+
+void
+PersistenceService::write_snapshot()
+{
+    if(!m_dirty) { return; }
+    m_dirty = false;
+
+    Snapshot snapshot = m_factory();
+    QString  file_name = m_file_name;
+    // Changes made from now on go to a new generation of the journal,
+    // the older ones are deleted once the snapshot is on the disk.
+    SnapshotInfo info;
+    QString journal_name;
+    SettingsJournal* journal = m_journal.get();
+    if(journal)
+    {
+        info.journal_generation = journal->rotate();
+        journal_name = journal->base_name();
+    }
+    qxstl::concurrent::run(&m_pool, [snapshot, file_name, info, journal_name, journal]() mutable
+    {
+        // Close the generation left by rotate(), in case the snapshot fails.
+        if(journal) { journal->sync(); }
+        static auto& latency = qxstl::metrics::histogram(
+            "applauncher_settings_write_seconds", "Time of writing the settings snapshot");
+        qxstl::metrics::ScopedTimer write_timer{latency};
+        QElapsedTimer timer;
+        timer.start();
+        try
+        {
+            qxstl::serialization::SchemaFileWriter writer(file_name, settings_format_version);
+            snapshot(writer, info.journal_generation);
+            writer(info);
+            writer.commit();
+            if(!journal_name.isEmpty())
+            {
+                SettingsJournal::remove_older_than(journal_name, info.journal_generation);
+            }
+            std::cout << " [INFO] Settings saved in " << timer.elapsed()
+                      << " ms" << std::endl;
+        }
+        catch(std::exception const& ex)
+        {
+            std::cerr << " [ERROR] Unable to save settings to "
+                      << file_name.toStdString() << ": " << ex.what() << std::endl;
+        }
+    });
+}
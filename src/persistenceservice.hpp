@@ -0,0 +1,133 @@
+#ifndef PERSISTENCESERVICE_HPP
+#define PERSISTENCESERVICE_HPP
+
+#include <functional>
+#include <vector>
+#include <memory>
+
+#include <QtCore>
+
+#include <qxstl/serialization.hpp>
+
+#include "settingsjournal.hpp"
+
+/** Class PersistenceService saves the application state to the settings
+ *  file without blocking the GUI thread.
+ *
+ *  + Changes only mark the state as dirty. Bursts of changes, such as a
+ *    drop of hundreds of files, are coalesced into a single write once no
+ *    change happened for a short delay, or after a maximum delay.
+ *
+ *  + The state is captured on the GUI thread as a snapshot, a copy of the
+ *    data that is cheap thanks to implicit sharing, and it is serialized on
+ *    a worker thread.
+ *
+ *  + The file is replaced atomically, see SchemaFileWriter. Records are
+ *    written with their compile-time schema, settings_format_version
+ *    tells which ones the file contains.
+ *
+ *  + When a journal is opened, changes are appended to it as records
+ *    instead, and the snapshot is only rewritten when the journal grows
+ *    past a threshold (compaction) or on flush(). The journal is synced
+ *    to the disk on the worker thread too.
+ *************************************************************************/
+class PersistenceService
+{
+public:
+    using SchemaWriter = qxstl::serialization::SchemaWriter;
+    /// Serializes a copy of the state, it runs on a worker thread. The
+    /// generation is the one stored in SnapshotInfo.
+    using Snapshot        = std::function<void (SchemaWriter& writer, qint64 generation)>;
+    /// Captures the state, it runs on the GUI thread.
+    using SnapshotFactory = std::function<Snapshot ()>;
+
+    /// Version of the records of the settings file, written in its header.
+    /// Version 2 adds the bookmark order after the launcher records.
+    static constexpr quint32 settings_format_version = 2;
+
+    /// Written after the snapshot, it tells which journal generations
+    /// the snapshot already contains.
+    struct SnapshotInfo
+    {
+        qint64 journal_generation = 0;
+
+        static constexpr auto schema = std::make_tuple(
+            qxstl::serialization::field(1, &SnapshotInfo::journal_generation));
+
+        /// Legacy format, still read by FileReader.
+        template<typename Visitor>
+        void accept(Visitor& visitor)
+        {
+            visitor.visit("journal_generation", journal_generation);
+        }
+    };
+
+    PersistenceService(QString file_name, SnapshotFactory factory);
+
+    /// Write pending changes and wait for them to reach the disk.
+    ~PersistenceService();
+
+    PersistenceService(PersistenceService const&) = delete;
+    PersistenceService& operator=(PersistenceService const&) = delete;
+
+    /// Time without changes before the state is written.
+    void set_debounce_delay(int milliseconds);
+
+    /// Schedule a write of the state.
+    void mark_dirty();
+
+    /** Replay the journal written since the snapshot was taken, then
+     *  record changes passed to append() in it.
+     *  @param base_name           - Prefix of the journal files
+     *  @param snapshot_generation - SnapshotInfo read from the settings file
+     *  @param apply               - Applies a replayed record to the state
+     */
+    void open_journal(QString base_name, qint64 snapshot_generation,
+                      SettingsJournal::ApplyFunc const& apply);
+
+    /// Size of the journal that triggers a compaction.
+    void set_compaction_threshold(qint64 bytes);
+
+    /// Record a change, or schedule a write of the state if no journal
+    /// is open.
+    void append(JournalRecord const& record);
+
+    /** Records appended until end_batch() are written to the journal at
+     *  once, or schedule a single write of the state if no journal is open.
+     *  Batches can be nested.
+     */
+    void begin_batch();
+    void end_batch();
+
+    /// Barrier: write pending changes now and wait until all writes are
+    /// committed to the disk. The journal is compacted into the snapshot.
+    /// It must be called before quitting.
+    void flush();
+
+    QString file_name() const;
+
+private:
+    QString          m_file_name;
+    SnapshotFactory  m_factory;
+    // A single thread, so that writes are committed in order
+    QThreadPool      m_pool;
+    QTimer           m_timer;
+    // Syncs the journal to the disk shortly after a burst of records
+    QTimer           m_sync_timer;
+    std::unique_ptr<SettingsJournal> m_journal;
+    qint64           m_compaction_threshold;
+    QElapsedTimer    m_dirty_since;
+    int              m_debounce_ms;
+    int              m_max_delay_ms;
+    bool             m_dirty;
+    // Records of the current batch, see begin_batch()
+    int              m_batch_depth;
+    std::vector<JournalRecord> m_batch;
+
+    /// Compact the journal if it is too large, or schedule its sync.
+    void journal_appended();
+
+    void write_snapshot();
+};
+
+#endif // PERSISTENCESERVICE_HPP
@@ -0,0 +1,306 @@
+#include <algorithm>
+#include <array>
+#include <iostream>
+#include <stdexcept>
+
+#include "settingsjournal.hpp"
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>  // fsync()
+#endif
+
+namespace
+{
+    constexpr quint32 journal_magic   = 0x514A524E; // "QJRN"
+    constexpr quint32 journal_version = 1;
+    // magic, version and generation
+    constexpr qint64  header_size     = 16;
+    // size and checksum of a record
+    constexpr qint64  frame_size      = 8;
+
+    // CRC-32 (IEEE 802.3), the checksum used by zip and PNG
+    constexpr std::array<quint32, 256> make_crc_table()
+    {
+        std::array<quint32, 256> table{};
+        for(quint32 i = 0; i < 256; i++)
+        {
+            quint32 c = i;
+            for(int k = 0; k < 8; k++)
+                c = (c & 1) ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+        return table;
+    }
+
+    constexpr auto crc_table = make_crc_table();
+
+    quint32 crc32(const char* data, qint64 size)
+    {
+        quint32 c = 0xFFFFFFFFu;
+        for(qint64 i = 0; i < size; i++)
+            c = crc_table[(c ^ static_cast<quint8>(data[i])) & 0xFF] ^ (c >> 8);
+        return c ^ 0xFFFFFFFFu;
+    }
+
+    QByteArray encode(JournalRecord const& record)
+    {
+        QByteArray payload;
+        QDataStream ss{&payload, QIODevice::WriteOnly};
+        ss.setVersion(QDataStream::Qt_5_0);
+        ss << static_cast<quint8>(record.type) << record.row << record.column
+           << record.values;
+
+        QByteArray frame;
+        QDataStream fs{&frame, QIODevice::WriteOnly};
+        fs << static_cast<quint32>(payload.size())
+           << crc32(payload.constData(), payload.size());
+        return frame + payload;
+    }
+
+    bool decode(QByteArray const& payload, JournalRecord& record)
+    {
+        QDataStream ss{payload};
+        ss.setVersion(QDataStream::Qt_5_0);
+        quint8 type = 0;
+        ss >> type >> record.row >> record.column >> record.values;
+        if(type < 1 || type > static_cast<quint8>(JournalRecord::Type::BookmarkOrder)) { return false; }
+        record.type = static_cast<JournalRecord::Type>(type);
+        return ss.status() == QDataStream::Ok && ss.atEnd();
+    }
+}
+
+SettingsJournal::SettingsJournal(QString base_name)
+    : m_base_name{base_name}
+    , m_file{std::make_unique<QFile>()}
+    , m_generation{0}
+{
+}
+
+SettingsJournal::~SettingsJournal()
+{
+    this->sync();
+}
+
+QString
+SettingsJournal::base_name() const
+{
+    return m_base_name;
+}
+
+QString
+SettingsJournal::file_name(qint64 generation) const
+{
+    return m_base_name + "." + QString::number(generation);
+}
+
+qint64
+SettingsJournal::generation() const
+{
+    return m_generation;
+}
+
+qint64
+SettingsJournal::size() const
+{
+    QMutexLocker lock{&m_mutex};
+    return m_file->isOpen() ? m_file->size() : 0;
+}
+
+bool
+SettingsJournal::has_records() const
+{
+    return this->size() > header_size;
+}
+
+std::vector<qint64>
+SettingsJournal::list_generations(QString const& base_name)
+{
+    QFileInfo info{base_name};
+    QDir dir = info.absoluteDir();
+    QString prefix = info.fileName() + ".";
+
+    std::vector<qint64> result;
+    for(auto const& entry: dir.entryList({prefix + "*"}, QDir::Files))
+    {
+        bool ok = false;
+        qint64 gen = entry.mid(prefix.size()).toLongLong(&ok);
+        if(ok && gen >= 0) { result.push_back(gen); }
+    }
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+int
+SettingsJournal::open(qint64 snapshot_generation, ApplyFunc const& apply)
+{
+    int count = 0;
+    qint64 latest = -1;
+    for(qint64 gen: list_generations(m_base_name))
+    {
+        // Changes of older generations are already in the snapshot.
+        if(gen < snapshot_generation) { continue; }
+        if(this->replay(gen, apply, count)) { latest = gen; }
+    }
+    if(count > 0)
+    {
+        std::cout << " [INFO] Journal: replayed " << count << " changes" << std::endl;
+    }
+
+    if(latest < 0)
+    {
+        this->create(snapshot_generation);
+        return count;
+    }
+    m_generation = latest;
+    m_file->setFileName(this->file_name(latest));
+    if(!m_file->open(QIODevice::WriteOnly | QIODevice::Append))
+    {
+        throw std::runtime_error(" [ERROR] Cannot open journal file.");
+    }
+    return count;
+}
+
+int
+SettingsJournal::read(QString const& base_name, qint64 snapshot_generation,
+                      ApplyFunc const& apply)
+{
+    SettingsJournal journal{base_name};
+    int count = 0;
+    for(qint64 gen: list_generations(base_name))
+    {
+        if(gen >= snapshot_generation) { journal.replay(gen, apply, count, false); }
+    }
+    return count;
+}
+
+bool
+SettingsJournal::replay(qint64 generation, ApplyFunc const& apply, int& count, bool repair)
+{
+    QString file_name = this->file_name(generation);
+    QFile file{file_name};
+    if(!file.open(repair ? QIODevice::ReadWrite : QIODevice::ReadOnly)) { return false; }
+    // Generations are bounded by the compaction threshold.
+    QByteArray data = file.readAll();
+
+    QDataStream hs{data};
+    quint32 magic = 0, version = 0;
+    qint64  header_generation = 0;
+    hs >> magic >> version >> header_generation;
+    if(hs.status() != QDataStream::Ok || magic != journal_magic
+       || version != journal_version || header_generation != generation)
+    {
+        std::cerr << " [ERROR] Journal: ignoring invalid file "
+                  << file_name.toStdString() << std::endl;
+        return false;
+    }
+
+    qint64 pos = header_size;
+    while(data.size() - pos >= frame_size)
+    {
+        QDataStream fs{data.mid(static_cast<int>(pos), frame_size)};
+        quint32 size = 0, checksum = 0;
+        fs >> size >> checksum;
+        if(size > data.size() - pos - frame_size) { break; }
+
+        const char* payload = data.constData() + pos + frame_size;
+        if(crc32(payload, size) != checksum) { break; }
+        JournalRecord record;
+        if(!decode(QByteArray::fromRawData(payload, static_cast<int>(size)), record)) { break; }
+
+        apply(record, generation);
+        count++;
+        pos += frame_size + size;
+    }
+
+    // Anything after the last valid record was torn by a crash, or is
+    // being appended by the owner of the journal.
+    if(repair && pos < data.size())
+    {
+        std::cout << " [INFO] Journal: truncating " << (data.size() - pos)
+                  << " invalid bytes of " << file_name.toStdString() << std::endl;
+        file.resize(pos);
+    }
+    return true;
+}
+
+void
+SettingsJournal::create(qint64 generation)
+{
+    if(m_file->isOpen()) { m_file->close(); }
+    m_generation = generation;
+    m_file->setFileName(this->file_name(generation));
+    if(!m_file->open(QIODevice::WriteOnly | QIODevice::Truncate))
+    {
+        throw std::runtime_error(" [ERROR] Cannot create journal file.");
+    }
+    QDataStream ss{m_file.get()};
+    ss << journal_magic << journal_version << generation;
+    m_file->flush();
+}
+
+void
+SettingsJournal::append(JournalRecord const& record)
+{
+    QByteArray frame = encode(record);
+    QMutexLocker lock{&m_mutex};
+    if(m_file->write(frame) != frame.size() || !m_file->flush())
+    {
+        std::cerr << " [ERROR] Journal: cannot append to "
+                  << m_file->fileName().toStdString() << std::endl;
+    }
+}
+
+void
+SettingsJournal::append(std::vector<JournalRecord> const& records)
+{
+    if(records.empty()) { return; }
+    QByteArray frames;
+    for(auto const& record: records){ frames += encode(record); }
+    QMutexLocker lock{&m_mutex};
+    if(m_file->write(frames) != frames.size() || !m_file->flush())
+    {
+        std::cerr << " [ERROR] Journal: cannot append to "
+                  << m_file->fileName().toStdString() << std::endl;
+    }
+}
+
+void
+SettingsJournal::sync()
+{
+    // Records are flushed to the OS by append(), the descriptor stays
+    // open until the next sync(), so fsync() runs without the lock and
+    // does not block appends.
+    std::vector<std::unique_ptr<QFile>> closed;
+    int handle = -1;
+    {
+        QMutexLocker lock{&m_mutex};
+        std::swap(closed, m_closed);
+        if(m_file->isOpen()) { handle = m_file->handle(); }
+    }
+#ifdef Q_OS_UNIX
+    for(auto const& file: closed){ ::fsync(file->handle()); }
+    if(handle >= 0) { ::fsync(handle); }
+#else
+    Q_UNUSED(handle)
+#endif
+}
+
+qint64
+SettingsJournal::rotate()
+{
+    QMutexLocker lock{&m_mutex};
+    m_closed.push_back(std::move(m_file));
+    m_file = std::make_unique<QFile>();
+    this->create(m_generation + 1);
+    return m_generation;
+}
+
+void
+SettingsJournal::remove_older_than(QString const& base_name, qint64 generation)
+{
+    for(qint64 gen: list_generations(base_name))
+    {
+        if(gen >= generation) { break; }
+        QFile::remove(base_name + "." + QString::number(gen));
+    }
+}
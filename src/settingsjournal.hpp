@@ -0,0 +1,140 @@
+#ifndef SETTINGSJOURNAL_HPP
+#define SETTINGSJOURNAL_HPP
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <QtCore>
+
+/** A change of the application state. Bookmark rows are positions in
+ *  insertion order (see RecordTableModel::begin()), registry rows are rows
+ *  of the command list.
+ */
+struct JournalRecord
+{
+    enum class Type: quint8
+    {
+        // values = {uri_path, brief, description}, appended at the end
+        BookmarkInsert   = 1,
+        BookmarkRemove   = 2,
+        // values = {new value of the column}
+        BookmarkSetField = 3,
+        // values = {command}
+        RegistryInsert   = 4,
+        RegistryRemove   = 5,
+        RegistrySet      = 6,
+        // values = {key} of the row in the order set by the user, or all
+        // keys indexed by position when row is -1
+        BookmarkOrder    = 7
+    };
+
+    Type        type;
+    qint32      row    = 0;
+    qint32      column = 0;
+    QStringList values;
+
+    bool is_bookmark() const
+    {
+        return type == Type::BookmarkInsert || type == Type::BookmarkRemove
+               || type == Type::BookmarkSetField || type == Type::BookmarkOrder;
+    }
+};
+
+/** Class SettingsJournal is an append-only log of the changes made since
+ *  the last snapshot of the settings file, so that a small change costs a
+ *  small write instead of a rewrite of the whole file.
+ *
+ *  + The journal is split into generations, one file per generation named
+ *    <base>.<generation>. A snapshot records the generation that was
+ *    started when it was taken, it contains all changes of older ones.
+ *
+ *  + Each record is framed by its size and a CRC-32 of its content. A
+ *    record torn by a crash is detected on replay and cut off, together
+ *    with anything following it.
+ *
+ *  + append() and rotate() only write to the OS cache, sync() forces the
+ *    data to the disk and may run on another thread, see PersistenceService.
+ *
+ *  File layout (QDataStream encoding, big-endian):
+ *
+ *    header: quint32 magic, quint32 version, qint64 generation
+ *    record: quint32 size, quint32 crc32, payload[size]
+ *    payload: quint8 type, qint32 row, qint32 column, QStringList values
+ *************************************************************************/
+class SettingsJournal
+{
+public:
+    /// Applies a replayed record, given the generation it belongs to.
+    using ApplyFunc = std::function<void (JournalRecord const& record, qint64 generation)>;
+
+    explicit SettingsJournal(QString base_name);
+    ~SettingsJournal();
+
+    SettingsJournal(SettingsJournal const&) = delete;
+    SettingsJournal& operator=(SettingsJournal const&) = delete;
+
+    /** Replay the records of all generations not older than the snapshot
+     *  generation, then open the latest generation for appending.
+     *  Return the number of records replayed.
+     */
+    int open(qint64 snapshot_generation, ApplyFunc const& apply);
+
+    /** Replay the records like open(), without repairing or opening any
+     *  file for writing, so that it is safe while another process owns
+     *  the journal. Return the number of records replayed.
+     */
+    static int read(QString const& base_name, qint64 snapshot_generation,
+                    ApplyFunc const& apply);
+
+    /// Append a record, it reaches the OS cache before returning.
+    void append(JournalRecord const& record);
+
+    /// Append records with a single write, such as the insertions of a
+    /// drop of many files.
+    void append(std::vector<JournalRecord> const& records);
+
+    /// Force the records appended so far to the disk, and close the
+    /// generations left by rotate(). It is safe to call from one thread
+    /// while another one appends.
+    void sync();
+
+    /// Start the next generation and return its number. The previous one
+    /// is synced and closed by the next sync().
+    qint64 rotate();
+
+    qint64 generation() const;
+
+    /// Size of the current generation in bytes, including the header.
+    qint64 size() const;
+
+    /// True if records were appended to the current generation.
+    bool has_records() const;
+
+    QString base_name() const;
+
+    /// Delete files of generations older than the given one. It is safe
+    /// to call from any thread, the current generation is never older.
+    static void remove_older_than(QString const& base_name, qint64 generation);
+
+private:
+    QString m_base_name;
+    // Guards the files against sync() running on another thread
+    mutable QMutex         m_mutex;
+    std::unique_ptr<QFile> m_file;
+    // Generations closed by rotate(), not synced yet
+    std::vector<std::unique_ptr<QFile>> m_closed;
+    qint64  m_generation;
+
+    QString file_name(qint64 generation) const;
+    void    create(qint64 generation);
+
+    /// Sorted generations found on disk
+    static std::vector<qint64> list_generations(QString const& base_name);
+
+    /// Replay a file and truncate its invalid tail if repair is set,
+    /// return false if the header is unreadable.
+    bool replay(qint64 generation, ApplyFunc const& apply, int& count, bool repair = true);
+};
+
+#endif // SETTINGSJOURNAL_HPP
@@ -0,0 +1,159 @@
+#include <iostream>
+
+#include "singleinstance.hpp"
+
+namespace
+{
+    // "QXLI", first word of a request
+    constexpr quint32 request_magic = 0x51584C49;
+
+    // Connecting to a listening socket is immediate, the timeout only
+    // matters if the running instance is stuck.
+    constexpr int connect_timeout_ms = 200;
+
+    // Interval between attempts while another instance is starting up
+    constexpr int retry_interval_ms = 20;
+
+    // A request is a few hundred bytes, more is not a launcher talking.
+    constexpr qint64 max_request_size = 64 * 1024;
+}
+
+SingleInstance::SingleInstance() = default;
+
+SingleInstance::~SingleInstance() = default;
+
+QString
+SingleInstance::runtime_dir()
+{
+    // XDG_RUNTIME_DIR, or a directory of the user that Qt creates with
+    // mode 0700. Not the shared temporary directory, where another user
+    // could create the socket or the lock first.
+    QString dir = QStandardPaths::writableLocation(QStandardPaths::RuntimeLocation);
+    if(dir.isEmpty()) { dir = QDir::tempPath(); }
+    return dir;
+}
+
+QString
+SingleInstance::server_name()
+{
+#ifdef Q_OS_WIN
+    // Named pipes live in their own namespace, they are not files.
+    QString user = QString::fromLocal8Bit(qgetenv("USERNAME"));
+    return "qapplauncher-" + user;
+#else
+    return QDir{runtime_dir()}.filePath("qapplauncher.socket");
+#endif
+}
+
+SingleInstance::Role
+SingleInstance::forward(InstanceRequest const& request, int timeout_ms)
+{
+    QLocalSocket socket;
+    socket.connectToServer(server_name());
+    if(!socket.waitForConnected(connect_timeout_ms)) { return Role::Primary; }
+
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << request_magic << static_cast<quint8>(request.action) << request.argument;
+    socket.write(data);
+    if(!socket.waitForBytesWritten(timeout_ms)) { return Role::Failed; }
+
+    while(socket.bytesAvailable() < 1)
+    {
+        if(!socket.waitForReadyRead(timeout_ms)) { return Role::Failed; }
+    }
+    char status = 1;
+    socket.getChar(&status);
+    return status == 0 ? Role::Forwarded : Role::Failed;
+}
+
+SingleInstance::Role
+SingleInstance::claim(InstanceRequest const& request, int timeout_ms)
+{
+    QElapsedTimer timer;
+    timer.start();
+    Role role = forward(request, timeout_ms);
+    if(role != Role::Primary) { return role; }
+
+    m_lock = std::make_unique<QLockFile>(QDir{runtime_dir()}.filePath("qapplauncher.lock"));
+    // Only a lock of a dead process is stale, however old it is.
+    m_lock->setStaleLockTime(0);
+    while(!m_lock->tryLock(0))
+    {
+        if(m_lock->error() != QLockFile::LockFailedError || timer.elapsed() > timeout_ms)
+        {
+            std::cerr << " [ERROR] The running instance does not answer" << std::endl;
+            m_lock.reset();
+            return Role::Failed;
+        }
+        // The owner is starting up and not listening yet.
+        QThread::msleep(retry_interval_ms);
+        role = forward(request, timeout_ms);
+        if(role != Role::Primary) { m_lock.reset(); return role; }
+    }
+    return Role::Primary;
+}
+
+bool
+SingleInstance::listen(Handler handler)
+{
+    if(!m_lock || !m_lock->isLocked()) { return false; }
+    m_handler = std::move(handler);
+    m_server  = std::make_unique<QLocalServer>();
+    m_server->setSocketOptions(QLocalServer::UserAccessOption);
+    // The socket file of a crashed instance, the lock is held by this one.
+    QLocalServer::removeServer(server_name());
+    if(!m_server->listen(server_name()))
+    {
+        std::cerr << " [ERROR] Single instance: cannot listen on "
+                  << server_name().toStdString() << ": "
+                  << m_server->errorString().toStdString() << std::endl;
+        m_server.reset();
+        return false;
+    }
+    QObject::connect(m_server.get(), &QLocalServer::newConnection, [this]
+                     {
+                         while(QLocalSocket* socket = m_server->nextPendingConnection())
+                         {
+                             this->serve(socket);
+                         }
+                     });
+    return true;
+}
+
+void
+SingleInstance::serve(QLocalSocket* socket)
+{
+    QObject::connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    QObject::connect(socket, &QLocalSocket::readyRead, socket, [this, socket]
+    {
+        if(socket->bytesAvailable() > max_request_size)
+        {
+            socket->abort();
+            return;
+        }
+        QDataStream in(socket);
+        in.setVersion(QDataStream::Qt_5_0);
+        in.startTransaction();
+        quint32 magic  = 0;
+        quint8  action = 0;
+        QString argument;
+        in >> magic >> action >> argument;
+        // Wait for the rest of the request.
+        if(!in.commitTransaction()) { return; }
+
+        bool ok = false;
+        if(magic == request_magic && action >= 1 && action <= 3)
+        {
+            InstanceRequest request;
+            request.action   = static_cast<InstanceRequest::Action>(action);
+            request.argument = argument;
+            std::cout << " [INFO] Forwarded request " << int(action) << " "
+                      << argument.toStdString() << std::endl;
+            ok = m_handler(request);
+        }
+        socket->putChar(ok ? 0 : 1);
+        socket->disconnectFromServer();
+    });
+}
@@ -0,0 +1,99 @@
+#ifndef SINGLEINSTANCE_HPP
+#define SINGLEINSTANCE_HPP
+
+#include <functional>
+#include <memory>
+
+#include <QtCore>
+#include <QtNetwork>
+
+/** What a process started while another instance runs asks it to do. */
+struct InstanceRequest
+{
+    enum class Action: quint8
+    {
+        // Show and raise the window
+        Show        = 1,
+        // Run a registry entry, argument = name, see ParsedCommand::find()
+        Run         = 2,
+        // Bookmark a file, argument = path or URL
+        AddBookmark = 3
+    };
+
+    Action  action = Action::Show;
+    QString argument;
+};
+
+/** Class SingleInstance keeps a single launcher running per user, so that
+ *  two instances never write the same settings file.
+ *
+ *  + The first process takes a lock file and listens on a local socket
+ *    (Unix domain socket, or named pipe on Windows). Both are in the
+ *    runtime directory of the user, see runtime_dir().
+ *
+ *  + A process started later forwards its request through the socket,
+ *    waits for an acknowledgement and exits. It only needs a
+ *    QCoreApplication, no widget is ever created.
+ *
+ *  + A lock file left by a crashed instance is stale, since its process
+ *    is gone, and is taken over together with the socket.
+ *
+ *  Wire format (QDataStream, big-endian):
+ *
+ *    request: quint32 magic, quint8 action, QString argument
+ *    reply:   quint8 status, 0 if the request was handled
+ *************************************************************************/
+class SingleInstance
+{
+public:
+    /// Handles a forwarded request on the GUI thread, returns false if it
+    /// failed.
+    using Handler = std::function<bool (InstanceRequest const& request)>;
+
+    enum class Role
+    {
+        // This process is the running instance, call listen()
+        Primary,
+        // The request was handled by the running instance
+        Forwarded,
+        // The running instance did not answer
+        Failed
+    };
+
+    SingleInstance();
+    ~SingleInstance();
+
+    SingleInstance(SingleInstance const&) = delete;
+    SingleInstance& operator=(SingleInstance const&) = delete;
+
+    /** Forward the request to the running instance, or become the running
+     *  instance if there is none. A QCoreApplication must exist.
+     *
+     *  If another process holds the lock but is not listening yet, it is
+     *  still starting up: the request is retried until timeout_ms.
+     */
+    Role claim(InstanceRequest const& request, int timeout_ms = 5000);
+
+    /// Accept requests of later processes, it requires the Primary role.
+    bool listen(Handler handler);
+
+    /// Send the request and wait for the reply, without claiming anything.
+    /// Return Primary if no instance accepted the connection.
+    static Role forward(InstanceRequest const& request, int timeout_ms);
+
+    /// Name of the local socket, one per user: its full path, except on
+    /// Windows.
+    static QString server_name();
+
+    /// Private directory of the user holding the socket and the lock.
+    static QString runtime_dir();
+
+private:
+    std::unique_ptr<QLockFile>    m_lock;
+    std::unique_ptr<QLocalServer> m_server;
+    Handler                       m_handler;
+
+    void serve(QLocalSocket* socket);
+};
+
+#endif // SINGLEINSTANCE_HPP
@@ -1,10 +1,67 @@
+#include <algorithm>
+#include <cmath>
 #include <iostream>
+#include <unordered_map>
 
 #include "tab_applicationlauncher.hpp"
 #include <qxstl/event.hpp>
 
 namespace qx = qxstl::event;
 
+namespace
+{
+    /** Turns model notifications into journal records, rows of the records
+     *  are positions in insertion order. Resolving an entry again does not
+     *  change its text and is not recorded. */
+    class RegistryRecorder: public qxstl::model::RecordObserver<ParsedCommand>
+    {
+        using Type = JournalRecord::Type;
+
+        std::function<void (JournalRecord const&)> m_record;
+        std::function<void ()>                     m_reset;
+        // Saved text of each entry, indexed by position
+        std::vector<QString>                       m_texts;
+
+    public:
+        RegistryRecorder(std::function<void (JournalRecord const&)> record,
+                         std::function<void ()> reset)
+            : m_record{std::move(record)}, m_reset{std::move(reset)}
+        { }
+
+        void item_inserted(int position, ParsedCommand const& item) override
+        {
+            m_texts.push_back(item.text);
+            m_record({Type::RegistryInsert, position, 0, {item.text}});
+        }
+
+        void item_updated(int position, ParsedCommand const& item) override
+        {
+            auto& saved = m_texts.at(static_cast<size_t>(position));
+            if(saved == item.text) { return; }
+            saved = item.text;
+            m_record({Type::RegistrySet, position, 0, {item.text}});
+        }
+
+        void items_removed(std::vector<int> const& positions) override
+        {
+            // From the last to the first, so that each position is valid
+            // when the record is replayed.
+            for(auto it = positions.rbegin(); it != positions.rend(); ++it)
+            {
+                m_texts.erase(m_texts.begin() + *it);
+                m_record({Type::RegistryRemove, *it, 0, {}});
+            }
+        }
+
+        void items_reset() override
+        {
+            // Not expressible as records, the whole state is saved.
+            m_texts.clear();
+            m_reset();
+        }
+    };
+}
+
 Tab_ApplicationLauncher::Tab_ApplicationLauncher(
       QWidget* parent
     , FormLoader* loader
@@ -15,12 +72,78 @@ Tab_ApplicationLauncher::Tab_ApplicationLauncher(
 
     // Load controls named in the form "user_interface.ui"
     cmd_input         = loader->find_child<QComboBox>("cmd_input");
-    app_registry      = loader->find_child<QListWidget>("cmd_registry");
+    registry_view     = loader->find_child<QListView>("cmd_registry");
     chb_editable      = loader->find_child<QCheckBox>("chb_editable");
     chb_always_on_top = loader->find_child<QCheckBox>("chb_always_on_top");
 
+    // Rows have the same height, so that the view lays out and scrolls
+    // a large registry without measuring every row.
+    app_registry = new CommandItemModel(parent);
+    registry_view->setModel(app_registry);
+    registry_view->setUniformItemSizes(true);
+    registry_view->setLayoutMode(QListView::Batched);
+    registry_view->setBatchSize(256);
+    registry_view->setSelectionMode(QAbstractItemView::SingleSelection);
+    registry_view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+
     // Combobox and list view share the same model
-    cmd_input->setModel(app_registry->model());
+    cmd_input->setModel(app_registry);
+    // Typed commands are added by the button "Add" only.
+    cmd_input->setInsertPolicy(QComboBox::NoInsert);
+
+    // Replace the default prefix completion with ranked fuzzy matches
+    completion_model = new QStringListModel(parent);
+    auto completer = new QCompleter(completion_model, parent);
+    completer->setCompletionMode(QCompleter::UnfilteredPopupCompletion);
+    completer->setMaxVisibleItems(15);
+    cmd_input->setCompleter(completer);
+
+    // Launches are listed in a tab of their own
+    launch_model = new LaunchTableModel(parent);
+    auto launch_view = new QTableView;
+    launch_view->setModel(launch_model);
+    launch_view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    launch_view->horizontalHeader()->setStretchLastSection(true);
+    loader->find_child<QTabWidget>("tabWidget")->addTab(launch_view, "Launches");
+    launch_engine = std::make_unique<LaunchEngine>(
+        [this](LaunchRecord const& launch){ this->on_launch_update(launch); });
+
+    // Candidates of the matcher are positions in insertion order, which
+    // sorting the view does not change.
+    auto mark_dirty = [this]{ this->candidates_dirty = true; };
+    QObject::connect(app_registry, &QAbstractItemModel::rowsInserted, mark_dirty);
+    QObject::connect(app_registry, &QAbstractItemModel::rowsRemoved,  mark_dirty);
+    QObject::connect(app_registry, &QAbstractItemModel::dataChanged,  mark_dirty);
+    QObject::connect(app_registry, &QAbstractItemModel::modelReset,   mark_dirty);
+
+    // Persist every change of the registry
+    recorder = std::make_unique<RegistryRecorder>(
+        [this](JournalRecord const& change){ this->record(change); },
+        [this]{ this->save_settings_callback(); });
+    app_registry->add_observer(recorder.get());
+
+    // Binaries appearing or vanishing in $PATH change what entries resolve to
+    path_watcher = new QFileSystemWatcher(parent);
+#if QT_VERSION >= QT_VERSION_CHECK(5, 14, 0)
+    auto const skip_empty = Qt::SkipEmptyParts;
+#else
+    auto const skip_empty = QString::SkipEmptyParts;
+#endif
+    auto path_dirs = QString::fromLocal8Bit(qgetenv("PATH"))
+                         .split(QDir::listSeparator(), skip_empty);
+    for(auto const& dir: path_dirs)
+    {
+        if(QFileInfo{dir}.isDir()) { path_watcher->addPath(dir); }
+    }
+    path_timer = new QTimer(parent);
+    path_timer->setSingleShot(true);
+    path_timer->setInterval(1000);
+    QObject::connect(path_timer, &QTimer::timeout, [this]{ this->resolve_commands(); });
+    QObject::connect(path_watcher, &QFileSystemWatcher::directoryChanged,
+                     [this]{ this->path_timer->start(); });
+
+    QObject::connect(cmd_input->lineEdit(), &QLineEdit::textEdited,
+                     [this](QString const& text){ this->update_completions(text); });
 
 
 
@@ -44,12 +167,8 @@ Tab_ApplicationLauncher::Tab_ApplicationLauncher(
                               {
                                   auto text = self.cmd_input->currentText();
                                   if(text.isEmpty()) { return; }
-                                  auto item = new QListWidgetItem();
-                                  item->setText(text);
-                                  // self.app_registry->insertItem(0, item);
-                                  self.app_registry->addItem(item);
+                                  self.app_registry->add_command(text);
                                   // self.cmd_input->clear();
-                                  self.save_settings_callback();
                                   //self.save_settings();
                               });
     // qtutils::on_clicked(btn_add,);
@@ -64,60 +183,90 @@ Tab_ApplicationLauncher::Tab_ApplicationLauncher(
 
     // qx::set_shortcut(cmd_input, Qt::Key_Return, std::bind(&Tab_ApplicationLauncher::run_combobox_command, this));
 
-    // Launch application double clicked application from registry (QListWidget)
-    loader->on_double_clicked<QListWidget>("cmd_registry", [&self = *this]
+    // Launch application double clicked application from registry (QListView)
+    loader->on_double_clicked<QListView>("cmd_registry", [&self = *this]
                                {
                                    if(self.chb_editable->isChecked())
                                    {
-                                       auto item = self.app_registry->currentItem();
-                                       if(item == nullptr) { return; }
-                                       // Set item as editable
-                                       item->setFlags( item->flags() | Qt::ItemIsEditable);
-                                       self.save_settings_callback();
+                                       auto index = self.registry_view->currentIndex();
+                                       if(!index.isValid()) { return; }
+                                       // Edit the entry instead of running it
+                                       self.registry_view->edit(index);
                                        return;
                                    }
                                    self.run_selected_item();
-                                   // auto command = items.first()->text();
                                });
 
+    QObject::connect(loader->find_child<QPushButton>("btn_sort_by_use"), &QPushButton::toggled,
+                     [this](bool checked){ this->sort_by_use(checked); });
+
     loader->on_button_clicked("btn_remove",
                               [&self = *this]
                               {
-                                  QListWidgetItem* pItem = self.app_registry->currentItem();
-                                  if(pItem == nullptr) { return; }
-                                  self.app_registry->removeItemWidget(pItem);
-                                  delete pItem;
-                                  self.save_settings_callback();
+                                  auto index = self.registry_view->currentIndex();
+                                  if(!index.isValid()) { return; }
+                                  self.app_registry->remove_item(index.row());
                               });
 
 } // --- End of Tab_ApplicationLauncher CTOR -------//
 
-void Tab_ApplicationLauncher::run_selected_item()
+Tab_ApplicationLauncher::~Tab_ApplicationLauncher()
 {
-    auto& self = *this;
-    auto items = self.app_registry->selectedItems();
-    if(items.isEmpty()) { return; }
-    auto command = items.first()->text();
-
-    bool status = QProcess::startDetached(command);
+    // The model is owned by the parent widget and outlives this object.
+    app_registry->remove_observer(recorder.get());
+}
 
-    std::cout << " [INFO] Run command " << command.toStdString()
-              << " status = " << (status ? "OK" : "FAILURE")
-              << std::endl;
+void Tab_ApplicationLauncher::run_selected_item()
+{
+    auto index = registry_view->currentIndex();
+    if(!index.isValid()) { return; }
+    launch_engine->launch(app_registry->at(index.row()));
 }
 
 void Tab_ApplicationLauncher::run_combobox_command()
 {
     auto command = cmd_input->currentText();
-    bool status = QProcess::startDetached(command);
-    std::cout << " [INFO] Run command " << command.toStdString()
-              << " status = " << (status ? "OK" : "FAILURE")
-              << std::endl;
+    if(command.trimmed().isEmpty()) { return; }
+    launch_engine->launch(command);
+}
+
+bool Tab_ApplicationLauncher::run_entry(QString const& name)
+{
+    int position = app_registry->find(name);
+    if(position < 0) { return false; }
+    launch_engine->launch(app_registry->item(position));
+    return true;
+}
+
+void Tab_ApplicationLauncher::on_launch_update(LaunchRecord const& launch)
+{
+    launch_model->update(launch);
+    // Reported once per launch, failures to start are not counted.
+    if(usage_log && launch.state == LaunchRecord::State::Running)
+    {
+        usage_log->record(UsageLog::Kind::Command, launch.command);
+        // Move the entry up if the view is ranked
+        int position = app_registry->is_ranked() ? app_registry->find(launch.command) : -1;
+        int row      = position < 0 ? -1 : app_registry->row_of(position);
+        if(row >= 0) { app_registry->refresh_row(row); }
+    }
+    if(!launch.is_failure()) { return; }
+    auto message = QString("Command failed: %1 (%2)").arg(launch.command, launch.status_text());
+    if(auto window = qobject_cast<QMainWindow*>(parent))
+    {
+        window->statusBar()->showMessage(message, 10000);
+    }
+}
+
+void Tab_ApplicationLauncher::resolve_commands()
+{
+    int broken = app_registry->resolve_all();
+    std::cout << " [INFO] $PATH changed, " << broken << " broken commands" << std::endl;
 }
 
 void  Tab_ApplicationLauncher::add_item(QString command)
 {
-    this->app_registry->addItem(command);
+    this->app_registry->add_command(command);
 }
 
 int Tab_ApplicationLauncher::count()
@@ -125,10 +274,142 @@ int Tab_ApplicationLauncher::count()
     return this->app_registry->count();
 }
 
-/// Return pointer to element at nth row
-QListWidgetItem*
+LauncherSnapshot Tab_ApplicationLauncher::snapshot() const
+{
+    LauncherSnapshot snap;
+    snap.app_registry = app_registry->texts();
+    return snap;
+}
+
+void Tab_ApplicationLauncher::restore(LauncherSnapshot const& snap)
+{
+    this->app_registry->assign_texts(snap.app_registry);
+}
+
+void Tab_ApplicationLauncher::record(JournalRecord const& change)
+{
+    if(journal_callback) { journal_callback(change); }
+    else                 { save_settings_callback(); }
+}
+
+void Tab_ApplicationLauncher::set_journal(std::function<void (JournalRecord const&)> callback)
+{
+    this->journal_callback = std::move(callback);
+}
+
+void Tab_ApplicationLauncher::apply(JournalRecord const& change)
+{
+    using Type = JournalRecord::Type;
+    // Rows of the records are positions in insertion order.
+    int n = app_registry->item_count();
+    if(change.type == Type::RegistryInsert && change.values.size() == 1
+       && change.row >= 0 && change.row <= n)
+    {
+        if(change.row == n)
+        {
+            app_registry->add_command(change.values[0]);
+            return;
+        }
+        // Entries are only appended since the registry is a model, former
+        // journals may still insert in the middle.
+        auto texts = app_registry->texts();
+        texts.insert(change.row, change.values[0]);
+        app_registry->assign_texts(texts);
+        return;
+    }
+    if(change.row < 0 || change.row >= n) { return; }
+    int row = app_registry->row_of(change.row);
+    if(row < 0) { return; }
+    if(change.type == Type::RegistryRemove)
+    {
+        app_registry->remove_item(row);
+    }
+    if(change.type == Type::RegistrySet && change.values.size() == 1)
+    {
+        app_registry->setData(app_registry->index(row, 0), change.values[0]);
+    }
+}
+
+void Tab_ApplicationLauncher::set_usage_log(UsageLog* log)
+{
+    this->usage_log = log;
+}
+
+void Tab_ApplicationLauncher::sort_by_use(bool enabled)
+{
+    if(!enabled || usage_log == nullptr)
+    {
+        app_registry->sort(-1);
+        return;
+    }
+    auto log = usage_log;
+    app_registry->sort_by_rank([log](ParsedCommand const& command)
+                               {
+                                   return log->rank(UsageLog::Kind::Command, command.text);
+                               });
+}
+
+QStringList Tab_ApplicationLauncher::most_used(int count) const
+{
+    QStringList result;
+    if(usage_log == nullptr || count <= 0) { return result; }
+    std::unordered_map<UsageLog::Key, int> positions;
+    for(int s = 0; s < app_registry->item_count(); s++)
+        positions.emplace(UsageLog::key_of(UsageLog::Kind::Command, app_registry->item(s).text), s);
+    // Commands removed from the registry may still rank, more are taken.
+    auto top = usage_log->index(UsageLog::Kind::Command).top(static_cast<size_t>(count) * 2 + 8);
+    for(auto const& entry: top)
+    {
+        auto it = positions.find(entry.first);
+        if(it == positions.end()) { continue; }
+        result << app_registry->item(it->second).text;
+        if(result.size() == count) { break; }
+    }
+    return result;
+}
+
+void Tab_ApplicationLauncher::update_completions(QString const& text)
+{
+    if(candidates_dirty)
+    {
+        std::vector<std::string> candidates;
+        candidates.reserve(static_cast<size_t>(app_registry->item_count()));
+        for(auto const& command: *app_registry)
+            candidates.push_back(command.text.toStdString());
+        matcher.set_candidates(candidates);
+        candidates_dirty = false;
+    }
+
+    QStringList results;
+    if(!text.isEmpty())
+    {
+        // Frequently used commands get a bonus comparable to matching at a
+        // word boundary, so that they win among matches of similar quality.
+        auto matches = matcher.match(text.toStdString(), 200);
+        std::vector<std::pair<int, int>> ranked;
+        for(auto const& m: matches)
+        {
+            int bonus = 0;
+            if(usage_log)
+            {
+                double uses = usage_log->score(UsageLog::Kind::Command,
+                                               app_registry->item(m.index).text);
+                bonus = static_cast<int>(8 * std::log2(1 + uses));
+            }
+            ranked.emplace_back(m.score + bonus, m.index);
+        }
+        std::stable_sort(ranked.begin(), ranked.end(),
+                         [](auto const& a, auto const& b){ return a.first > b.first; });
+        for(size_t i = 0; i < ranked.size() && i < 50; i++)
+            results << app_registry->item(ranked[i].second).text;
+    }
+    completion_model->setStringList(results);
+}
+
+/// Return the command displayed at nth row
+ParsedCommand const&
 Tab_ApplicationLauncher::at(int row)
 {
-    return this->app_registry->item(row);
+    return this->app_registry->at(row);
 }
 
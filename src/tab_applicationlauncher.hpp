@@ -4,27 +4,30 @@
 #include <qxstl/FormLoader.hpp>
 #include <qxstl/serialization.hpp>
 
+#include "commanditemmodel.hpp"
+#include "fuzzymatcher.hpp"
+#include "launchengine.hpp"
+#include "launchersnapshot.hpp"
+#include "launchtablemodel.hpp"
+#include "parsedcommand.hpp"
+#include "settingsjournal.hpp"
+#include "usagelog.hpp"
+
 
 namespace qxstl::serialization
 {
     template<>
-    inline QVariant value_writer(QListWidget& ref)
+    inline QVariant value_writer(CommandItemModel& ref)
     {
-        QStringList list;
-        for(int i = 0; i < ref.count(); ++i)
-        {
-            list << ref.item(i)->text();
-        }
-        return list;
+        // Insertion order, not the order displayed by the view
+        return ref.texts();
     }
 
     template<>
-    inline void value_reader(QListWidget& ref, QVariant value)
+    inline void value_reader(CommandItemModel& ref, QVariant value)
     {
-        QStringList lst = value.toStringList();
-        for(int i = 0; i < lst.count(); i++){
-            ref.addItem(lst.at(i));
-        }
+        // Insert all entries at once, firing a single model signal.
+        ref.assign_texts(value.toStringList());
     }
 
 }
@@ -41,32 +44,98 @@ class Tab_ApplicationLauncher
     QComboBox*   cmd_input;
     QCheckBox*   chb_editable;
     QCheckBox*   chb_always_on_top;
-    QListWidget* app_registry;
+    QListView*   registry_view;
+    // Parsed commands, shared by registry_view and cmd_input
+    CommandItemModel* app_registry;
+    // Records changes of app_registry, see set_journal()
+    std::unique_ptr<qxstl::model::RecordObserver<ParsedCommand>> recorder;
+
+    // Watches the $PATH directories, binaries may be installed or removed
+    QFileSystemWatcher*        path_watcher;
+    // Coalesces bursts of changes, such as a package upgrade
+    QTimer*                    path_timer;
+
+    // Fuzzy completion of commands typed in cmd_input
+    FuzzyMatcher      matcher;
+    QStringListModel* completion_model;
+    // Set when the registry changed since candidates were last loaded
+    bool              candidates_dirty = true;
 
     std::function<void ()> save_settings_callback;
+    // Records changes of the registry, see set_journal()
+    std::function<void (JournalRecord const&)> journal_callback;
+
+    // Starts commands off the GUI thread and tracks them until they exit
+    std::unique_ptr<LaunchEngine> launch_engine;
+    LaunchTableModel*             launch_model;
+
+    // Counts launches for ranking, see set_usage_log()
+    UsageLog*                     usage_log = nullptr;
+
+    /// Persist a change, through the journal if there is one.
+    void record(JournalRecord const& change);
+
+    /// Show a launch in the table, and failures in the status bar.
+    void on_launch_update(LaunchRecord const& launch);
+
+    /// Resolve all commands again after a change of the $PATH directories.
+    void resolve_commands();
 public:
 
     Tab_ApplicationLauncher(QWidget* parent, FormLoader* loader,
                             std::function<void ()> save_settings_callback);
 
-    /// Run item selected in the QListWidget (ApplicationRegistry)
+    ~Tab_ApplicationLauncher();
+
+    Tab_ApplicationLauncher(Tab_ApplicationLauncher const&) = delete;
+    Tab_ApplicationLauncher& operator=(Tab_ApplicationLauncher const&) = delete;
+
+    /// Run item selected in the registry view
     void run_selected_item();
 
     /// Run command entered by user in combobox
     void run_combobox_command();
 
-    /// Add new command to command registry widget
+    /// Run a registry entry found by ParsedCommand::find(), return false
+    /// if there is none.
+    bool run_entry(QString const& name);
+
+    /// Add new command to command registry
     void add_item(QString command);
 
-    /// Return number of elements in the command registry list widget
+    /// Return number of elements in the command registry
     int count();
 
-    /// Return pointer to element at nth row
-    QListWidgetItem*
-    at(int row);
+    /// Return the command displayed at nth row
+    ParsedCommand const& at(int row);
 
     void save_settings();
 
+    /// Copy the state that is saved to the settings file
+    LauncherSnapshot snapshot() const;
+
+    /// Restore the state read from the settings file.
+    void restore(LauncherSnapshot const& snap);
+
+    /// Send changes to the journal instead of saving the whole state.
+    void set_journal(std::function<void (JournalRecord const&)> callback);
+
+    /// Record launches in the log, and rank completions by its scores.
+    void set_usage_log(UsageLog* log);
+
+    /// Show the most used commands first, or in insertion order. Only
+    /// the view is reordered, the saved order does not change.
+    void sort_by_use(bool enabled);
+
+    /// The most used commands of the registry, best first.
+    QStringList most_used(int count) const;
+
+    /// Apply a registry change replayed from the journal.
+    void apply(JournalRecord const& change);
+
+    /// Show commands of the registry that fuzzy-match the text, best first.
+    void update_completions(QString const& text);
+
 #if 1
     template<typename Visitor>
     void accept(Visitor& visitor)
@@ -1,8 +1,95 @@
 #include "tab_desktopbookmarks.hpp"
 
+namespace
+{
+    /** Turns model notifications into journal records. Only the fields
+     *  saved in the settings file are recorded, updates of the metadata
+     *  resolved from the filesystem are ignored. */
+    class BookmarkRecorder: public qxstl::model::RecordObserver<FileBookmarkItem>
+    {
+        using Type = JournalRecord::Type;
+
+        FileBookmarkItemModel const*               m_model;
+        std::function<void (JournalRecord const&)> m_record;
+        std::function<void ()>                     m_reset;
+        // Saved value of the brief column, indexed by position
+        std::vector<QString>                       m_briefs;
+
+    public:
+        BookmarkRecorder(FileBookmarkItemModel const* model,
+                         std::function<void (JournalRecord const&)> record,
+                         std::function<void ()> reset)
+            : m_model{model}, m_record{std::move(record)}, m_reset{std::move(reset)}
+        { }
+
+        void item_inserted(int position, FileBookmarkItem const& item) override
+        {
+            m_briefs.push_back(item.brief);
+            m_record({Type::BookmarkInsert, position, 0,
+                      {item.uri_path(), item.brief, item.description}});
+        }
+
+        void item_updated(int position, FileBookmarkItem const& item) override
+        {
+            auto& saved = m_briefs.at(static_cast<size_t>(position));
+            if(saved == item.brief) { return; }
+            saved = item.brief;
+            m_record({Type::BookmarkSetField, position, 3, {item.brief}});
+        }
+
+        void items_removed(std::vector<int> const& positions) override
+        {
+            // From the last to the first, so that each position is valid
+            // when the record is replayed.
+            for(auto it = positions.rbegin(); it != positions.rend(); ++it)
+            {
+                m_briefs.erase(m_briefs.begin() + *it);
+                m_record({Type::BookmarkRemove, *it, 0, {}});
+            }
+        }
+
+        void items_reset() override
+        {
+            // Not expressible as records, the whole state is saved.
+            m_briefs.clear();
+            m_reset();
+        }
+
+        void items_attached(int count) override
+        {
+            // Items of a store are already saved, their fields are known
+            // once they are decoded, before any change.
+            m_briefs.assign(static_cast<size_t>(count), QString{});
+        }
+
+        void item_loaded(int position, FileBookmarkItem const& item) override
+        {
+            m_briefs.at(static_cast<size_t>(position)) = item.brief;
+        }
+
+        void order_changed(std::vector<int> const& positions) override
+        {
+            // Keys are written with all their digits, so that the replayed
+            // order is the same.
+            auto const& keys = m_model->manual_order();
+            auto key = [&](int s){ return QString::number(keys[static_cast<size_t>(s)], 'g', 17); };
+            if(positions.empty())
+            {
+                QStringList values;
+                values.reserve(static_cast<int>(keys.size()));
+                for(int s = 0; s < static_cast<int>(keys.size()); s++){ values << key(s); }
+                m_record({Type::BookmarkOrder, -1, 0, values});
+                return;
+            }
+            for(int s: positions){ m_record({Type::BookmarkOrder, s, 0, {key(s)}}); }
+        }
+    };
+}
 
-Tab_DesktopBookmarks::Tab_DesktopBookmarks(QWidget* parent, FormLoader* loader):
-    parent(parent), loader{loader}
+
+Tab_DesktopBookmarks::Tab_DesktopBookmarks(
+    QWidget* parent, FormLoader* loader, std::function<void ()> callback):
+    parent(parent), loader{loader}, save_settings_callback{callback}
 {
     //========= Tab - File Bookmark =================//
 
@@ -11,9 +98,13 @@ Tab_DesktopBookmarks::Tab_DesktopBookmarks(QWidget* parent, FormLoader* loader):
     tview_disp = loader->find_child<QTableView>("tview_disp");
     tview_disp->horizontalHeader()->setStretchLastSection(true);
     tview_disp->verticalHeader()->hide();
-    tview_disp->setSelectionMode(QTableView::SingleSelection);
+    tview_disp->setSelectionMode(QTableView::ExtendedSelection);
     tview_disp->setSelectionBehavior(QTableView::SelectRows);
+    // Selected rows are dragged between rows, see RecordTableModel::dropMimeData().
+    // The overwrite mode of tables would clear the dragged cells.
     tview_disp->setDragDropMode(QTableView::InternalMove);
+    tview_disp->setDragDropOverwriteMode(false);
+    tview_disp->setDropIndicatorShown(true);
     tview_disp->setShowGrid(false);
     tview_disp->setSortingEnabled(true);
     tview_disp->setWhatsThis("List containing desktop file/directories bookmarks");
@@ -21,6 +112,38 @@ Tab_DesktopBookmarks::Tab_DesktopBookmarks(QWidget* parent, FormLoader* loader):
 
     tview_model = new FileBookmarkItemModel(parent);
     tview_disp->setModel(tview_model);
+    // Show items in insertion order until the user clicks at a header.
+    tview_disp->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+
+    // Filter the table on every keystroke
+    search = std::make_unique<BookmarkSearch>(tview_model);
+    entry_search = loader->find_child<QLineEdit>("entry_search");
+    QObject::connect(entry_search, &QLineEdit::textChanged,
+                     [this](QString const& text)
+                     {
+                         this->search->search(text);
+                         this->update_order();
+                     });
+
+    // Most used first, clicking at a header sorts by the column instead
+    chb_by_use = loader->find_child<QCheckBox>("chb_bookmarks_by_use");
+    QObject::connect(chb_by_use, &QCheckBox::toggled, [this]{ this->update_order(); });
+    QObject::connect(tview_disp->horizontalHeader(), &QHeaderView::sortIndicatorChanged,
+                     [this](int section, Qt::SortOrder)
+                     {
+                         if(section >= 0) { chb_by_use->setChecked(false); }
+                     });
+    // Rows moved by the user replace the sort order, without sorting again.
+    auto on_rows_moved = [this]
+    {
+        if(!tview_model->is_manual_order()) { return; }
+        QSignalBlocker block_header{tview_disp->horizontalHeader()};
+        QSignalBlocker block_check{chb_by_use};
+        tview_disp->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+        chb_by_use->setChecked(false);
+    };
+    QObject::connect(tview_model, &QAbstractItemModel::rowsMoved, on_rows_moved);
+    QObject::connect(tview_model, &QAbstractItemModel::layoutChanged, on_rows_moved);
 
     // Only works after the model is set
     // Hide path column
@@ -45,6 +168,13 @@ Tab_DesktopBookmarks::Tab_DesktopBookmarks(QWidget* parent, FormLoader* loader):
     mapper->addMapping(entry_brief, 3, "text");
     mapper->toFirst();
 
+    // Persist insertions, removals and edits of the brief.
+    recorder = std::make_unique<BookmarkRecorder>(
+        tview_model,
+        [this](JournalRecord const& change){ this->record(change); },
+        [this]{ this->save_settings_callback(); });
+    tview_model->add_observer(recorder.get());
+
     // Event triggered when the selection of current row is changed.
     QObject::connect(tview_disp->selectionModel(),
                      &QItemSelectionModel::currentRowChanged,
@@ -102,12 +232,40 @@ Tab_DesktopBookmarks::Tab_DesktopBookmarks(QWidget* parent, FormLoader* loader):
 
 } //----- End of Tab_DesktopBookmarks constructor ----------//
 
+Tab_DesktopBookmarks::~Tab_DesktopBookmarks()
+{
+    // The model is owned by the parent widget and outlives this object.
+    tview_model->remove_observer(recorder.get());
+}
+
 
 void Tab_DesktopBookmarks::add_model_entry(QString uri_path, QString brief, QString description)
 {
     this->tview_model->add_item({uri_path, brief, description});
 }
 
+int Tab_DesktopBookmarks::add_model_entries(std::vector<FileBookmarkItem> items)
+{
+    // Paths are compared by their node in the trie, only the column of
+    // paths of the model is scanned.
+    tview_model->materialize();
+    using Layout = qxstl::model::ColumnLayout<FileBookmarkItem>;
+    auto const& paths = tview_model->storage().column<Layout::Path>();
+    QSet<FileBookmarkItem::PathId> existing;
+    existing.reserve(static_cast<int>(paths.size()));
+    for(auto id: paths){ existing.insert(id); }
+
+    items.erase(std::remove_if(items.begin(), items.end(),
+                               [&](FileBookmarkItem const& item)
+                               {
+                                   return existing.contains(item.path_id());
+                               }),
+                items.end());
+    tview_model->add_items(std::make_move_iterator(items.begin()),
+                           std::make_move_iterator(items.end()));
+    return static_cast<int>(items.size());
+}
+
 // Returns true if this table is visible to the user
 bool Tab_DesktopBookmarks::is_visible()
 {
@@ -115,7 +273,7 @@ bool Tab_DesktopBookmarks::is_visible()
 }
 
 // Return item at Nth row of model
-FileBookmarkItem&
+FileBookmarkItem
 Tab_DesktopBookmarks::at(int row)
 {
     return this->tview_model->at(row);
@@ -136,8 +294,13 @@ void Tab_DesktopBookmarks::open_selected_bookmark_file()
 
     auto item  = tview_model->at(index.row());
 
-    auto file = item.uri_path;
+    auto file = item.uri_path();
     std::cout << " [INFO] Open file " << file.toStdString() << "\n";
+    if(usage_log)
+    {
+        usage_log->record(UsageLog::Kind::Bookmark, file);
+        if(tview_model->is_ranked()) { tview_model->refresh_row(index.row()); }
+    }
     // Linux-only for a while
 
     auto url = [&]
@@ -155,11 +318,14 @@ void Tab_DesktopBookmarks::remove_selected_bookmark_file()
 
     // QSTL_WARNING_FUNCTION_NOT_IMPLEMENTED();
     auto& self = *this;
-    auto index = self.tview_disp->currentIndex();
+    // All selected rows are removed at once
+    std::vector<int> rows;
+    for(auto const& index: self.tview_disp->selectionModel()->selectedRows())
+        rows.push_back(index.row());
     // Abort on error
-    if(!index.isValid()) { return; }
+    if(rows.empty()) { return; }
     // QListWidgetItem* pItem = self.tview_disp->currentItem();
-    self.tview_model->remove_item(index.row());
+    self.tview_model->remove_items(std::move(rows));
 
     // self.save_settings();
 }
@@ -172,3 +338,144 @@ void Tab_DesktopBookmarks::add_bookmark_file()
     this->tview_model->add_item({file, "", ""});
     // self.save_settings();
 }
+
+BookmarksSnapshot Tab_DesktopBookmarks::snapshot() const
+{
+    BookmarksSnapshot snap;
+    // Not decoded yet: the store is copied as is, or decoded by the writer
+    // thread with the changes made since.
+    auto source = tview_model->source();
+    if(store && source == store)
+    {
+        snap.store = store;
+        return snap;
+    }
+    if(source)
+    {
+        snap.source = std::move(source);
+        return snap;
+    }
+    snap.order.keys = tview_model->manual_order();
+    snap.items.reserve(static_cast<size_t>(tview_model->item_count()));
+    // Storage order, like the serialization of the model
+    for(auto const& item: *tview_model)
+    {
+        snap.items.push_back(item);
+    }
+    return snap;
+}
+
+bool Tab_DesktopBookmarks::load_store(QString const& file_name, qint64& generation)
+{
+    QElapsedTimer timer;
+    timer.start();
+    auto mapped = BookmarkStore::open(file_name);
+    if(!mapped) { return false; }
+    store = mapped;
+    generation = mapped->generation();
+    tview_model->attach(mapped);
+    std::cout << " [INFO] Bookmark store mapped: " << mapped->size()
+              << " rows in " << timer.elapsed() << " ms" << std::endl;
+    return true;
+}
+
+void Tab_DesktopBookmarks::record(JournalRecord const& change)
+{
+    if(journal_callback) { journal_callback(change); }
+    else                 { save_settings_callback(); }
+}
+
+void Tab_DesktopBookmarks::set_journal(std::function<void (JournalRecord const&)> callback)
+{
+    this->journal_callback = std::move(callback);
+}
+
+void Tab_DesktopBookmarks::apply(JournalRecord const& change)
+{
+    using Type = JournalRecord::Type;
+    auto const& v = change.values;
+    if(change.type == Type::BookmarkInsert && v.size() == 3)
+    {
+        this->tview_model->add_item({v[0], v[1], v[2]});
+        return;
+    }
+    if(change.type == Type::BookmarkOrder && change.row == -1)
+    {
+        std::vector<double> keys;
+        keys.reserve(static_cast<size_t>(v.size()));
+        for(auto const& key: v){ keys.push_back(key.toDouble()); }
+        this->tview_model->set_manual_order(std::move(keys));
+        return;
+    }
+    if(change.row < 0 || change.row >= tview_model->item_count()) { return; }
+    if(change.type == Type::BookmarkOrder && v.size() == 1)
+    {
+        this->tview_model->set_manual_key(change.row, v[0].toDouble());
+        return;
+    }
+    // By position: items of a store that were not fetched yet are changed
+    // without decoding the others.
+    if(change.type == Type::BookmarkRemove)
+    {
+        this->tview_model->remove_item_at(change.row);
+    }
+    if(change.type == Type::BookmarkSetField && v.size() == 1)
+    {
+        this->tview_model->set_item_data(change.row, change.column, v[0]);
+    }
+}
+
+void Tab_DesktopBookmarks::restore_order(BookmarkOrder order)
+{
+    if(order.keys.empty()) { return; }
+    if(!this->tview_model->set_manual_order(std::move(order.keys)))
+    {
+        std::cerr << " [ERROR] Bookmark order does not match the bookmarks, ignored"
+                  << std::endl;
+    }
+}
+
+void Tab_DesktopBookmarks::set_usage_log(UsageLog* log)
+{
+    this->usage_log = log;
+    this->update_order();
+}
+
+void Tab_DesktopBookmarks::update_order()
+{
+    if(usage_log == nullptr) { return; }
+    bool by_use = chb_by_use->isChecked() || !entry_search->text().isEmpty();
+    // A column chosen by the user, or rows moved by the user, win over the
+    // ranking of search results.
+    if(tview_model->sort_column() >= 0 && !chb_by_use->isChecked()) { return; }
+    if(tview_model->is_manual_order()  && !chb_by_use->isChecked()) { return; }
+    if(by_use == tview_model->is_ranked()) { return; }
+
+    tview_disp->horizontalHeader()->setSortIndicator(-1, Qt::AscendingOrder);
+    if(by_use)
+    {
+        auto log = usage_log;
+        tview_model->sort_by_rank([log](FileBookmarkItem const& item)
+                                  {
+                                      return log->rank(UsageLog::Kind::Bookmark, item.uri_path());
+                                  });
+    }
+    else
+    {
+        tview_model->sort(-1);
+    }
+}
+
+void Tab_DesktopBookmarks::load_search_index(QString file_name, QByteArray fingerprint)
+{
+    this->search->load(file_name, fingerprint);
+}
+
+void Tab_DesktopBookmarks::save_search_index(QString file_name, QByteArray fingerprint)
+{
+    if(!this->search->save(file_name, fingerprint))
+    {
+        std::cerr << " [ERROR] Unable to save search index "
+                  << file_name.toStdString() << std::endl;
+    }
+}
@@ -5,6 +5,10 @@
 #include <qxstl/serialization.hpp>
 
 #include "filebookmarkitemmodel.hpp"
+#include "bookmarksearch.hpp"
+#include "settingsjournal.hpp"
+#include "bookmarkstore.hpp"
+#include "usagelog.hpp"
 
 
 #include <QtCore>
@@ -12,25 +16,29 @@
 
 namespace qxstl::serialization
 {
-template<>
-inline QVariant value_writer(FileBookmarkItemModel& ref)
+/// Encode bookmarks in the format of the settings file
+template<typename Range>
+inline QByteArray write_bookmarks(int count, Range const& items)
 {
     QByteArray arr;
     QDataStream ss{&arr, QIODevice::WriteOnly};
 
-    ss << ref.count();
-
-    //QStringList list;
-    for(int i = 0; i < ref.count(); ++i)
+    ss << count;
+    for(auto const& item: items)
     {
-        //list << ref.at(i).uri_path;
-        auto& item = ref.at(i);
-        ss << item.uri_path << item.brief << item.description;
+        ss << item.uri_path() << item.brief << item.description;
     }
-    //return list;
     return arr;
 }
 
+template<>
+inline QVariant value_writer(FileBookmarkItemModel& ref)
+{
+    // Items are saved in insertion order, not in the order displayed by
+    // the view, which may be sorted or filtered.
+    return write_bookmarks(ref.item_count(), ref);
+}
+
 template<>
 inline void value_reader(FileBookmarkItemModel& ref, QVariant value)
 {
@@ -40,18 +48,44 @@ inline void value_reader(FileBookmarkItemModel& ref, QVariant value)
     int count;
     ss >> count;
 
+    std::vector<FileBookmarkItem> items;
+    items.reserve(static_cast<size_t>(std::max(count, 0)));
     for(int i = 0; i < count; i++)
     {
         QString uri_path, brief, description;
         ss >> uri_path >> brief >> description;
-        ref.add_item(FileBookmarkItem{uri_path, brief, description});
+        items.emplace_back(uri_path, brief, description);
     }
+    // Insert all items at once, firing a single model signal.
+    ref.assign(std::move(items));
 }
 
 }
 
 using qxstl::gui::FormLoader;
 
+/// Copy of the bookmarks, written to a BookmarkStore file.
+struct BookmarksSnapshot
+{
+    BookmarkOrder                        order;
+    std::vector<FileBookmarkItem>        items;
+    // Set instead of items when the model still displays this store
+    std::shared_ptr<BookmarkStore const> store;
+    // Set instead of items when the model displays a store with changes
+    std::shared_ptr<qxstl::model::RecordSource<FileBookmarkItem> const> source;
+
+    /// Write the store file, it runs on a worker thread.
+    void write_store(QString const& file_name, qint64 generation) const
+    {
+        if(store) { store->copy_to(file_name, generation); return; }
+        if(!source) { BookmarkStore::write(file_name, generation, items); return; }
+        std::vector<FileBookmarkItem> decoded;
+        decoded.reserve(static_cast<size_t>(source->size()));
+        for(int s = 0; s < source->size(); s++){ decoded.push_back(source->item(s)); }
+        BookmarkStore::write(file_name, generation, decoded);
+    }
+};
+
 class Tab_DesktopBookmarks
 {
     QWidget*               parent;
@@ -59,9 +93,31 @@ class Tab_DesktopBookmarks
     QWidget*               tab_file_bookmarks;
     QTableView*            tview_disp;
     FileBookmarkItemModel* tview_model;
+    QLineEdit*             entry_search;
+    QCheckBox*             chb_by_use;
+    std::unique_ptr<BookmarkSearch> search;
+
+    std::function<void ()> save_settings_callback;
+    // Records changes of the model, see set_journal()
+    std::function<void (JournalRecord const&)> journal_callback;
+    std::unique_ptr<qxstl::model::RecordObserver<FileBookmarkItem>> recorder;
+    // Store displayed by the model until its items are decoded
+    std::shared_ptr<BookmarkStore const> store;
+    // Counts openings for ranking, see set_usage_log()
+    UsageLog*              usage_log = nullptr;
+
+    /// Persist a change, through the journal if there is one.
+    void record(JournalRecord const& change);
+
+    /// Show the most used bookmarks first while searching, or always if
+    /// the check box is checked, unless a column header was clicked.
+    void update_order();
 public:
 
-    Tab_DesktopBookmarks(QWidget* parent, FormLoader* loader);
+    Tab_DesktopBookmarks(QWidget* parent, FormLoader* loader,
+                         std::function<void ()> save_settings_callback);
+
+    ~Tab_DesktopBookmarks();
 
     // Disable copy-constructor and copy assignment operator
     Tab_DesktopBookmarks(Tab_DesktopBookmarks const& rhs) = delete;
@@ -69,11 +125,16 @@ public:
 
     void add_model_entry(QString uri_path, QString brief, QString description);
 
+    /** Append the bookmarks whose path is not bookmarked yet, with a single
+     *  model insertion. Return the number of bookmarks added.
+     */
+    int add_model_entries(std::vector<FileBookmarkItem> items);
+
     // Returns true if this table is visible to the user
     bool is_visible();
 
     // Return item at Nth row of model
-    FileBookmarkItem& at(int row);
+    FileBookmarkItem at(int row);
 
     int count() const;
 
@@ -84,6 +145,33 @@ public:
 
     void add_bookmark_file();
 
+    /// Copy the state that is saved to the settings file
+    BookmarksSnapshot snapshot() const;
+
+    /** Display the bookmarks of a store file, replacing the current ones.
+     *  Return false if the file is missing or invalid.
+     *  @param generation - Set to the journal generation of the store
+     */
+    bool load_store(QString const& file_name, qint64& generation);
+
+    /// Send changes to the journal instead of saving the whole state.
+    void set_journal(std::function<void (JournalRecord const&)> callback);
+
+    /// Record openings in the log, and rank the bookmarks by its scores.
+    void set_usage_log(UsageLog* log);
+
+    /// Apply a bookmark change replayed from the journal.
+    void apply(JournalRecord const& change);
+
+    /// Display the order saved in the settings file, over the bookmarks
+    /// it was saved with.
+    void restore_order(BookmarkOrder order);
+
+    /// Load the search index saved next to the settings file.
+    void load_search_index(QString file_name, QByteArray fingerprint);
+
+    void save_search_index(QString file_name, QByteArray fingerprint);
+
 
     template<typename Visitor>
     void accept(Visitor& visitor)
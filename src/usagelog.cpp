@@ -0,0 +1,229 @@
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+#include <qxstl/serialization.hpp>
+
+#include "usagelog.hpp"
+
+namespace
+{
+    constexpr quint32 log_magic   = 0x47535551; // "QUSG" in the file
+    constexpr quint32 log_version = 1;
+    constexpr qint64  header_size = 8;
+    constexpr qint64  record_size = 16;
+
+    // Uses of two weeks ago count half
+    constexpr double  half_life_seconds = 14 * 86400.0;
+
+    // Compact when there are more redundant records than this
+    constexpr qint64  compact_threshold = 4096;
+
+    // Appends hold the lock for a single write(), a longer wait means
+    // the owner is stuck.
+    constexpr int     lock_timeout_ms   = 2000;
+
+    double now_seconds()
+    {
+        return QDateTime::currentMSecsSinceEpoch() / 1000.0;
+    }
+
+    QByteArray header()
+    {
+        QByteArray data(header_size, '\0');
+        auto p = reinterpret_cast<uchar*>(data.data());
+        qToLittleEndian<quint32>(log_magic,   p);
+        qToLittleEndian<quint32>(log_version, p + 4);
+        return data;
+    }
+
+    QByteArray encode(quint64 key, double rank)
+    {
+        quint64 bits = 0;
+        std::memcpy(&bits, &rank, sizeof(bits));
+        QByteArray data(record_size, '\0');
+        auto p = reinterpret_cast<uchar*>(data.data());
+        qToLittleEndian<quint64>(key,  p);
+        qToLittleEndian<quint64>(bits, p + 8);
+        return data;
+    }
+
+    /// Take the lock shared by all processes writing the log, return null
+    /// if it cannot be taken.
+    std::unique_ptr<QLockFile> lock_log(QString const& file_name)
+    {
+        auto lock = std::make_unique<QLockFile>(file_name + ".lock");
+        if(!lock->tryLock(lock_timeout_ms))
+        {
+            std::cerr << " [ERROR] Usage log: cannot lock " << file_name.toStdString()
+                      << std::endl;
+            return nullptr;
+        }
+        return lock;
+    }
+
+    /// Write the header if the file is empty, then the record, in a
+    /// single write() call. The log must be locked.
+    bool write_record(QFile& file, quint64 key, double rank)
+    {
+        QByteArray data = file.size() == 0 ? header() : QByteArray{};
+        data += encode(key, rank);
+        return file.write(data) == data.size();
+    }
+}
+
+UsageLog::UsageLog(QString file_name)
+    : m_file_name{std::move(file_name)}
+    , m_commands{half_life_seconds}
+    , m_bookmarks{half_life_seconds}
+    , m_records{0}
+{
+}
+
+UsageLog::Key
+UsageLog::key_of(Kind kind, QString const& text)
+{
+    // FNV-1a of the UTF-8 text
+    quint64 hash = 0xcbf29ce484222325ull;
+    for(char ch: text.toUtf8())
+    {
+        hash ^= static_cast<quint8>(ch);
+        hash *= 0x100000001b3ull;
+    }
+    return (hash >> 2) | (static_cast<quint64>(kind) << 62);
+}
+
+UsageLog::FrecencyIndex&
+UsageLog::index_of(Key key)
+{
+    return (key >> 62) == static_cast<quint64>(Kind::Command) ? m_commands : m_bookmarks;
+}
+
+UsageLog::FrecencyIndex const&
+UsageLog::index(Kind kind) const
+{
+    return kind == Kind::Command ? m_commands : m_bookmarks;
+}
+
+int
+UsageLog::load()
+{
+    m_commands.clear();
+    m_bookmarks.clear();
+    m_records = 0;
+
+    // Held until the log is compacted and reopened, appends of other
+    // processes wait meanwhile.
+    auto lock = lock_log(m_file_name);
+    QFile file{m_file_name};
+    if(file.open(QIODevice::ReadOnly))
+    {
+        QByteArray data = file.readAll();
+        auto p = reinterpret_cast<const uchar*>(data.constData());
+        if(data.size() >= header_size && qFromLittleEndian<quint32>(p) == log_magic
+           && qFromLittleEndian<quint32>(p + 4) == log_version)
+        {
+            // A torn record at the end is ignored.
+            for(qint64 pos = header_size; pos + record_size <= data.size(); pos += record_size)
+            {
+                quint64 key  = qFromLittleEndian<quint64>(p + pos);
+                quint64 bits = qFromLittleEndian<quint64>(p + pos + 8);
+                double  rank = 0;
+                std::memcpy(&rank, &bits, sizeof(rank));
+                if(!std::isfinite(rank)) { continue; }
+                this->index_of(key).add_rank(key, rank);
+                m_records++;
+            }
+        }
+        else if(data.size() > 0)
+        {
+            std::cerr << " [ERROR] Usage log: ignoring invalid file "
+                      << m_file_name.toStdString() << std::endl;
+        }
+        file.close();
+    }
+
+    qint64 items = static_cast<qint64>(m_commands.size() + m_bookmarks.size());
+    bool   torn  = file.size() > 0 && (file.size() - header_size) % record_size != 0;
+    if(lock && (torn || m_records - items > compact_threshold || (file.size() > 0 && m_records == 0)))
+    {
+        this->compact();
+    }
+    this->open_for_append();
+    return static_cast<int>(m_records);
+}
+
+bool
+UsageLog::open_for_append()
+{
+    if(m_file.isOpen()) { return true; }
+    m_file.setFileName(m_file_name);
+    // Unbuffered: every record is a single write() to the end of the file.
+    if(!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered))
+    {
+        std::cerr << " [ERROR] Usage log: cannot open " << m_file_name.toStdString()
+                  << std::endl;
+        return false;
+    }
+    return true;
+}
+
+void
+UsageLog::compact()
+{
+    if(m_file.isOpen()) { m_file.close(); }
+    QByteArray data = header();
+    for(auto const* index: {&m_commands, &m_bookmarks})
+    {
+        for(auto const& entry: index->ranks()) { data += encode(entry.first, entry.second); }
+    }
+    QSaveFile file{m_file_name};
+    if(!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()
+       || !file.commit())
+    {
+        std::cerr << " [ERROR] Usage log: cannot compact " << m_file_name.toStdString()
+                  << std::endl;
+        return;
+    }
+    m_records = static_cast<qint64>(m_commands.size() + m_bookmarks.size());
+}
+
+void
+UsageLog::record(Kind kind, QString const& text)
+{
+    Key   key   = key_of(kind, text);
+    auto& index = this->index_of(key);
+    double rank = index.rank_of_use(now_seconds());
+    index.add_rank(key, rank);
+    m_records++;
+    auto lock = lock_log(m_file_name);
+    if(!lock || !this->open_for_append() || !write_record(m_file, key, rank))
+    {
+        std::cerr << " [ERROR] Usage log: cannot append to " << m_file_name.toStdString()
+                  << std::endl;
+    }
+}
+
+bool
+UsageLog::append(QString const& file_name, Kind kind, QString const& text)
+{
+    auto lock = lock_log(file_name);
+    if(!lock) { return false; }
+    QFile file{file_name};
+    if(!file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Unbuffered)) { return false; }
+    FrecencyIndex index{half_life_seconds};
+    return write_record(file, key_of(kind, text), index.rank_of_use(now_seconds()));
+}
+
+double
+UsageLog::rank(Kind kind, QString const& text) const
+{
+    return this->index(kind).rank(key_of(kind, text));
+}
+
+double
+UsageLog::score(Kind kind, QString const& text) const
+{
+    return this->index(kind).score(key_of(kind, text), now_seconds());
+}
@@ -0,0 +1,82 @@
+#ifndef USAGELOG_HPP
+#define USAGELOG_HPP
+
+#include <QtCore>
+
+#include <qxstl/FrecencyIndex.hpp>
+
+/** Class UsageLog records every launch of a command and every opening of
+ *  a bookmark, and ranks them by frecency, see FrecencyIndex.
+ *
+ *  + Items are identified by a 64-bit hash of their text (command line or
+ *    bookmark path), whose two high bits hold the kind of item.
+ *
+ *  + The log is an append-only file of fixed-size records. A record holds
+ *    the rank added by a use, replaying the log only sums them.
+ *
+ *  + When most records are redundant, the log is compacted to a single
+ *    record per item holding its total rank.
+ *
+ *  File layout, little-endian:
+ *
+ *    header (8 bytes):   u32 magic, u32 version
+ *    record (16 bytes):  u64 key, f64 rank
+ *
+ *  Records are written with a single write() in append mode, so that
+ *  HeadlessCli can append to the log of a running instance. Appends and
+ *  compaction hold the lock file <log>.lock, so that a record appended by
+ *  another process is neither written without the header nor dropped by
+ *  a compaction.
+ *************************************************************************/
+class UsageLog
+{
+public:
+    using FrecencyIndex = qxstl::ranking::FrecencyIndex;
+    using Key           = FrecencyIndex::Key;
+
+    enum class Kind: quint8 { Command = 1, Bookmark = 2 };
+
+    explicit UsageLog(QString file_name);
+
+    UsageLog(UsageLog const&) = delete;
+    UsageLog& operator=(UsageLog const&) = delete;
+
+    /// Read the log and open it for appending, return the number of
+    /// records read.
+    int load();
+
+    /// Record a use of the item now.
+    void record(Kind kind, QString const& text);
+
+    /// Append a use to a log file without reading it, for processes that
+    /// exit right after.
+    static bool append(QString const& file_name, Kind kind, QString const& text);
+
+    /// Rank of an item, higher is better, -infinity if never used. Ranks
+    /// of the same kind can be compared at any time.
+    double rank(Kind kind, QString const& text) const;
+
+    /// Decayed number of uses of the item now.
+    double score(Kind kind, QString const& text) const;
+
+    FrecencyIndex const& index(Kind kind) const;
+
+    static Key key_of(Kind kind, QString const& text);
+
+private:
+    QString       m_file_name;
+    QFile         m_file;
+    FrecencyIndex m_commands;
+    FrecencyIndex m_bookmarks;
+    // Records in the file, including the redundant ones
+    qint64        m_records;
+
+    FrecencyIndex& index_of(Key key);
+
+    /// Rewrite the log with one record per item, the log must be locked.
+    void compact();
+
+    bool open_for_append();
+};
+
+#endif // USAGELOG_HPP